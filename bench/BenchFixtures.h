@@ -0,0 +1,42 @@
+#ifndef BENCH_FIXTURES_H
+#define BENCH_FIXTURES_H
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#ifndef CODE_ATLAS_BENCH_FIXTURES_DIR
+#define CODE_ATLAS_BENCH_FIXTURES_DIR "bench/fixtures"
+#endif
+
+/**
+ * @brief 读取 bench/fixtures 下的录制数据。
+ * @param name 文件名。
+ * @return 文件的完整内容。
+ * @throw std::runtime_error 如果文件无法打开。
+ */
+inline std::string load_fixture(const std::string& name) {
+    std::string path = std::string(CODE_ATLAS_BENCH_FIXTURES_DIR) + "/" + name;
+    std::ifstream f(path, std::ios::binary);
+    if (!f.is_open()) {
+        throw std::runtime_error("Benchmark fixture not found: " + path);
+    }
+    std::ostringstream ss;
+    ss << f.rdbuf();
+    return ss.str();
+}
+
+/**
+ * @brief 将录制的 SSE 流重复拼接到至少 min_bytes 字节，模拟长时间的生成。
+ */
+inline std::string replay_stream(const std::string& recorded, size_t min_bytes) {
+    std::string stream;
+    stream.reserve(min_bytes + recorded.size());
+    while (stream.size() < min_bytes) {
+        stream += recorded;
+    }
+    return stream;
+}
+
+#endif // BENCH_FIXTURES_H
@@ -0,0 +1,93 @@
+#include <benchmark/benchmark.h>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+#include "ChunkDecoder.h"
+#include "SseParser.h"
+#include "BenchFixtures.h"
+
+namespace {
+
+// 录制流中每个事件的 data 字段
+const std::vector<std::string>& recorded_events() {
+    static const std::vector<std::string> events = []() {
+        std::vector<std::string> result;
+        std::string stream = load_fixture("llama_cpp_stream.sse");
+        SseParser parser;
+        parser.feed(stream);
+        SseEvent event;
+        while (parser.next_event(event)) {
+            if (event.data != "[DONE]") {
+                result.emplace_back(event.data);
+            }
+        }
+        return result;
+    }();
+    return events;
+}
+
+// 把录制的事件循环重复到 count 个，模拟不同长度的生成
+std::vector<std::string> replay_events(size_t count) {
+    const auto& recorded = recorded_events();
+    std::vector<std::string> events;
+    events.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        events.push_back(recorded[i % recorded.size()]);
+    }
+    return events;
+}
+
+int64_t total_bytes(const std::vector<std::string>& events) {
+    int64_t bytes = 0;
+    for (const auto& e : events) {
+        bytes += static_cast<int64_t>(e.size());
+    }
+    return bytes;
+}
+
+// 旧实现：每个数据块构建完整的DOM，按值复制 delta，并重复读取 finish_reason 路径
+void BM_ChunkDomParse(benchmark::State& state) {
+    const auto events = replay_events(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        size_t content_bytes = 0;
+        for (const auto& data : events) {
+            nlohmann::json chunk = nlohmann::json::parse(data.begin(), data.end());
+            auto delta = chunk["choices"][0]["delta"];
+            if (delta.contains("content") && !delta["content"].is_null()) {
+                std::string text_chunk = delta["content"];
+                content_bytes += text_chunk.size();
+            }
+            if (delta.contains("tool_calls")) {
+                auto tool_chunk = delta["tool_calls"][0];
+                content_bytes += tool_chunk.size();
+            }
+            if (chunk["choices"][0].contains("finish_reason") && !chunk["choices"][0]["finish_reason"].is_null()) {
+                std::string finish_reason = chunk["choices"][0]["finish_reason"];
+                content_bytes += finish_reason.size();
+            }
+        }
+        benchmark::DoNotOptimize(content_bytes);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * total_bytes(events));
+}
+
+void BM_ChunkDecoder(benchmark::State& state) {
+    const auto events = replay_events(static_cast<size_t>(state.range(0)));
+    ChunkDecoder decoder;
+    DecodedChunk chunk;
+    for (auto _ : state) {
+        size_t content_bytes = 0;
+        for (const auto& data : events) {
+            decoder.decode(data, chunk);
+            content_bytes += chunk.content.size() + chunk.tool_call_count + chunk.finish_reason.size();
+        }
+        benchmark::DoNotOptimize(content_bytes);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * total_bytes(events));
+}
+
+} // namespace
+
+// 参数为事件数：278 是录制的流本身，另外两档对应较短和很长的回复
+BENCHMARK(BM_ChunkDomParse)->Arg(64)->Arg(278)->Arg(8192)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_ChunkDecoder)->Arg(64)->Arg(278)->Arg(8192)->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,86 @@
+#include <benchmark/benchmark.h>
+#include <nlohmann/json.hpp>
+#include <string>
+#include "ConversationHistory.h"
+#include "Utils.h"
+
+namespace {
+
+const char* kSystemPrompt = "**Identity**: You are Code Atlas, a cross-platform intelligent agent that operates natively on the user's system.";
+
+// 典型的一轮：用户提问、带工具调用的助手消息、约 1 KB 的工具输出
+nlohmann::json make_message(size_t i) {
+    switch (i % 3) {
+        case 0:
+            return {{"role", "user"}, {"content", "Please list the ten largest files under ./data and summarise them, step " + std::to_string(i)}};
+        case 1: {
+            nlohmann::json call = {{"id", "call_" + std::to_string(i)}, {"type", "function"},
+                                   {"function", {{"name", "python"}, {"arguments", nlohmann::json{{"code", std::string(400, 'x') + "\nprint('done')"}}.dump()}}}};
+            return {{"role", "assistant"}, {"content", "Let me check."}, {"tool_calls", nlohmann::json::array({call})}};
+        }
+        default:
+            return {{"role", "tool"}, {"tool_call_id", "call_" + std::to_string(i - 1)},
+                    {"content", nlohmann::json{{"status", "success"}, {"output", std::string(1000, 'o')}}.dump()}};
+    }
+}
+
+nlohmann::json make_base_payload() {
+    nlohmann::json payload = {{"stream", true}, {"temperature", 0.2}, {"top_p", 0.9}, {"max_tokens", 4096}};
+    payload["tools"] = nlohmann::json::array({{{"type", "function"}, {"function", {{"name", "python"}, {"description", "Runs Python code."}}}}});
+    return payload;
+}
+
+// 旧实现：每轮深拷贝整个历史、追加系统后缀、复制基础payload并整体序列化
+void BM_PayloadFullDump(benchmark::State& state) {
+    size_t count = static_cast<size_t>(state.range(0));
+    nlohmann::json base_payload = make_base_payload();
+    nlohmann::json messages = nlohmann::json::array({{{"role", "system"}, {"content", kSystemPrompt}}});
+    for (size_t i = 1; i < count; ++i) {
+        messages.push_back(make_message(i));
+    }
+    std::string suffix = os_prompt_suffix(OperatingSystem::Linux);
+    size_t bytes = 0;
+    for (auto _ : state) {
+        nlohmann::json payload = base_payload;
+        nlohmann::json modified_messages = messages;
+        modified_messages[0]["content"] = modified_messages[0]["content"].get<std::string>() + suffix;
+        payload["messages"] = modified_messages;
+        std::string body = payload.dump();
+        bytes = body.size();
+        benchmark::DoNotOptimize(body);
+    }
+    state.counters["body_bytes"] = static_cast<double>(bytes);
+}
+
+// 新实现：只序列化新追加的一条消息，再拼接缓存的片段
+void BM_PayloadHistoryAppend(benchmark::State& state) {
+    size_t count = static_cast<size_t>(state.range(0));
+    std::string prefix = make_base_payload().dump();
+    prefix.pop_back();
+    prefix += ",\"messages\":[";
+    ConversationHistory history(os_prompt_suffix(OperatingSystem::Linux));
+    history.push_back({{"role", "system"}, {"content", kSystemPrompt}});
+    for (size_t i = 1; i + 1 < count; ++i) {
+        history.push_back(make_message(i));
+    }
+    nlohmann::json next_message = make_message(count - 1);
+    size_t bytes = 0;
+    ConversationHistory turn;
+    for (auto _ : state) {
+        // 复制和析构历史不属于每轮的开销，放在计时之外
+        state.PauseTiming();
+        turn = history;
+        nlohmann::json message = next_message;
+        state.ResumeTiming();
+        turn.push_back(std::move(message));
+        std::string body = turn.request_body(prefix);
+        bytes = body.size();
+        benchmark::DoNotOptimize(body);
+    }
+    state.counters["body_bytes"] = static_cast<double>(bytes);
+}
+
+} // namespace
+
+BENCHMARK(BM_PayloadFullDump)->Arg(10)->Arg(100)->Arg(1000)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_PayloadHistoryAppend)->Arg(10)->Arg(100)->Arg(1000)->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,42 @@
+// shell 工具单次调用的固定开销：启动 bash、传入脚本、收集 stdout/stderr、等待退出。
+#include <benchmark/benchmark.h>
+#include <string>
+#include "BashSessionPool.h"
+#include "CodeExecutor.h"
+
+namespace {
+
+// 最简单的脚本，测得的几乎全是每次调用的固定开销
+void BM_ShellEcho(benchmark::State& state) {
+    for (auto _ : state) {
+        std::string result = execute_shell_code("bash", "echo hi");
+        benchmark::DoNotOptimize(result);
+    }
+}
+
+// 同样的脚本在持久的 bash 会话中执行：不再启动进程，只有一次往返
+void BM_ShellSessionEcho(benchmark::State& state) {
+    BashSessionPool sessions(BashSessionPool::Options{});
+    for (auto _ : state) {
+        std::string result = execute_shell_session(sessions, "", "echo hi");
+        benchmark::DoNotOptimize(result);
+    }
+}
+
+// stdout 和 stderr 同时输出大量数据
+void BM_ShellOutput(benchmark::State& state) {
+    const std::string bytes = std::to_string(state.range(0));
+    const std::string script = "head -c " + bytes + " /dev/zero | tr '\\0' a\n"
+                               "head -c " + bytes + " /dev/zero | tr '\\0' b >&2\n";
+    for (auto _ : state) {
+        std::string result = execute_shell_code("bash", script);
+        benchmark::DoNotOptimize(result);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0) * 2);
+}
+
+} // namespace
+
+BENCHMARK(BM_ShellEcho)->Unit(benchmark::kMicrosecond)->UseRealTime();
+BENCHMARK(BM_ShellSessionEcho)->Unit(benchmark::kMicrosecond)->UseRealTime();
+BENCHMARK(BM_ShellOutput)->Arg(1 << 16)->Arg(1 << 22)->Unit(benchmark::kMicrosecond)->UseRealTime();
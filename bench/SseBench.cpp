@@ -0,0 +1,83 @@
+#include <benchmark/benchmark.h>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "SseParser.h"
+#include "BenchFixtures.h"
+
+namespace {
+
+// 按指定大小切分网络分块；chunk_size 为 0 时按事件边界切分，模拟逐 token 到达
+std::vector<std::string_view> split_chunks(const std::string& stream, size_t chunk_size) {
+    std::vector<std::string_view> chunks;
+    std::string_view view(stream);
+    if (chunk_size == 0) {
+        size_t pos = 0;
+        while (pos < view.size()) {
+            size_t end = view.find("\n\n", pos);
+            end = (end == std::string_view::npos) ? view.size() : end + 2;
+            chunks.push_back(view.substr(pos, end - pos));
+            pos = end;
+        }
+    } else {
+        for (size_t pos = 0; pos < view.size(); pos += chunk_size) {
+            chunks.push_back(view.substr(pos, chunk_size));
+        }
+    }
+    return chunks;
+}
+
+const std::string& recorded_stream() {
+    static const std::string stream = replay_stream(load_fixture("llama_cpp_stream.sse"), 4 * 1024 * 1024);
+    return stream;
+}
+
+// 旧实现：find + substr + erase 的逐行处理
+void BM_SseLegacyLineBuffer(benchmark::State& state) {
+    const std::string& stream = recorded_stream();
+    auto chunks = split_chunks(stream, static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        std::string line_buffer;
+        size_t payload_bytes = 0;
+        for (std::string_view data : chunks) {
+            line_buffer.append(data);
+            size_t pos;
+            while ((pos = line_buffer.find('\n')) != std::string::npos) {
+                std::string line = line_buffer.substr(0, pos);
+                line_buffer.erase(0, pos + 1);
+                if (line.rfind("data: ", 0) != 0) {
+                    continue;
+                }
+                std::string data_str = line.substr(6);
+                payload_bytes += data_str.size();
+            }
+        }
+        benchmark::DoNotOptimize(payload_bytes);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(stream.size()));
+}
+
+void BM_SseParser(benchmark::State& state) {
+    const std::string& stream = recorded_stream();
+    auto chunks = split_chunks(stream, static_cast<size_t>(state.range(0)));
+    SseParser parser;
+    for (auto _ : state) {
+        parser.reset();
+        size_t payload_bytes = 0;
+        SseEvent event;
+        for (std::string_view data : chunks) {
+            parser.feed(data);
+            while (parser.next_event(event)) {
+                payload_bytes += event.data.size();
+            }
+        }
+        benchmark::DoNotOptimize(payload_bytes);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(stream.size()));
+}
+
+} // namespace
+
+// 0 = 每个事件一个分块；1460 ≈ 一个 TCP 段；16384 = curl 默认写缓冲区
+BENCHMARK(BM_SseLegacyLineBuffer)->Arg(0)->Arg(1460)->Arg(16384)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_SseParser)->Arg(0)->Arg(1460)->Arg(16384)->Unit(benchmark::kMillisecond);
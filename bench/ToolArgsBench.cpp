@@ -0,0 +1,74 @@
+#include <benchmark/benchmark.h>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "ToolArgsDecoder.h"
+
+namespace {
+
+// 构造一个约 lines 行的 Python 工具调用参数，并按模型输出的粒度切成小片段
+std::vector<std::string> make_fragments(int lines) {
+    std::string code;
+    for (int i = 0; i < lines; ++i) {
+        code += "    result_" + std::to_string(i) + " = compute(\"row\\t" + std::to_string(i) + "\", scale=0.5)  # 注释 ✓\n";
+    }
+    // 模型服务器通常使用 ensure_ascii 风格的转义，这里同样输出 \uXXXX
+    std::string arguments = nlohmann::json{{"code", code}}.dump(-1, ' ', true);
+    std::vector<std::string> fragments;
+    for (size_t pos = 0; pos < arguments.size();) {
+        size_t n = 3 + (pos * 7) % 5;
+        fragments.push_back(arguments.substr(pos, n));
+        pos += n;
+    }
+    return fragments;
+}
+
+// 旧实现：每个片段都重新解析整个缓冲区，失败后补上 "\"}" 再解析一次
+void BM_ToolArgsReparse(benchmark::State& state) {
+    auto fragments = make_fragments(static_cast<int>(state.range(0)));
+    for (auto _ : state) {
+        nlohmann::json function = {{"arguments", ""}};
+        std::string code_buffer;
+        std::string last_printed_code;
+        size_t printed = 0;
+        for (const auto& args_chunk : fragments) {
+            function["arguments"] = function["arguments"].get<std::string>() + args_chunk;
+            code_buffer += args_chunk;
+            std::string current_code;
+            try {
+                nlohmann::json parsed_json = nlohmann::json::parse(code_buffer);
+                current_code = parsed_json["code"];
+            } catch (const nlohmann::json::parse_error&) {
+                try {
+                    nlohmann::json parsed_json = nlohmann::json::parse(code_buffer + "\"}");
+                    current_code = parsed_json["code"];
+                } catch (const nlohmann::json::parse_error&) {
+                }
+            }
+            if (current_code.length() > last_printed_code.length()) {
+                printed += current_code.length() - last_printed_code.length();
+                last_printed_code = current_code;
+            }
+        }
+        benchmark::DoNotOptimize(printed);
+    }
+}
+
+void BM_ToolArgsDecoder(benchmark::State& state) {
+    auto fragments = make_fragments(static_cast<int>(state.range(0)));
+    ToolArgsDecoder decoder;
+    for (auto _ : state) {
+        decoder.reset();
+        size_t printed = 0;
+        for (const auto& args_chunk : fragments) {
+            printed += decoder.feed(args_chunk).size();
+        }
+        benchmark::DoNotOptimize(printed);
+    }
+}
+
+} // namespace
+
+BENCHMARK(BM_ToolArgsReparse)->Arg(50)->Arg(500)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ToolArgsDecoder)->Arg(50)->Arg(500)->Arg(5000)->Unit(benchmark::kMicrosecond);
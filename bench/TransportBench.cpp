@@ -0,0 +1,240 @@
+// 回环TCP与Unix域套接字的流式请求延迟对比。
+// 进程内启动一个模拟的 OpenAI 兼容 SSE 服务器，客户端与 ApiClient 一样通过 libcurl
+// 复用连接发送请求；每个事件单独写入一次，模拟逐 token 输出。
+#include <benchmark/benchmark.h>
+#include <curl/curl.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+const char* kEvent =
+    "data: {\"choices\":[{\"finish_reason\":null,\"index\":0,\"delta\":{\"content\":\" token\"}}],"
+    "\"object\":\"chat.completion.chunk\"}\n\n";
+
+// 写完整个缓冲区，套接字可能只接受一部分
+bool write_all(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = write(fd, data, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+class StandInServer {
+public:
+    // 建立监听套接字失败时不启动服务线程，原因见 error()
+    StandInServer(bool use_unix, int events) : events(events) {
+        if (use_unix) {
+            socket_path = "/tmp/code-atlas-bench-" + std::to_string(getpid()) + ".sock";
+            unlink(socket_path.c_str());
+            listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+            if (listen_fd < 0) {
+                fail("socket");
+                return;
+            }
+            sockaddr_un addr{};
+            addr.sun_family = AF_UNIX;
+            std::strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+            if (bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+                fail("bind");
+                return;
+            }
+        } else {
+            listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+            if (listen_fd < 0) {
+                fail("socket");
+                return;
+            }
+            int one = 1;
+            setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            sockaddr_in addr{};
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            addr.sin_port = 0;
+            if (bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+                fail("bind");
+                return;
+            }
+            socklen_t len = sizeof(addr);
+            if (getsockname(listen_fd, reinterpret_cast<sockaddr*>(&addr), &len) != 0) {
+                fail("getsockname");
+                return;
+            }
+            port = ntohs(addr.sin_port);
+        }
+        if (listen(listen_fd, 8) != 0) {
+            fail("listen");
+            return;
+        }
+        worker = std::thread([this]() { serve(); });
+    }
+
+    ~StandInServer() {
+        stopping = true;
+        if (listen_fd >= 0) {
+            shutdown(listen_fd, SHUT_RDWR);
+            close(listen_fd);
+        }
+        if (worker.joinable()) {
+            worker.join();
+        }
+        if (!socket_path.empty()) {
+            unlink(socket_path.c_str());
+        }
+    }
+
+    std::string url() const {
+        return socket_path.empty() ? "http://127.0.0.1:" + std::to_string(port) + "/v1/chat/completions"
+                                   : "http://localhost/v1/chat/completions";
+    }
+
+    const std::string& unix_path() const { return socket_path; }
+
+    // 为空表示服务器已经在监听
+    const std::string& error() const { return setup_error; }
+
+private:
+    int listen_fd = -1;
+    int port = 0;
+    int events;
+    std::string socket_path;
+    std::thread worker;
+    std::atomic<bool> stopping{false};
+    std::string setup_error;
+
+    void fail(const char* step) {
+        setup_error = std::string(step) + ": " + std::strerror(errno);
+    }
+
+    void serve() {
+        while (!stopping) {
+            int fd = accept(listen_fd, nullptr, nullptr);
+            if (fd < 0) {
+                return;
+            }
+            if (socket_path.empty()) {
+                int one = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            }
+            handle_connection(fd);
+            close(fd);
+        }
+    }
+
+    // 处理一个保持活动的连接上的所有请求
+    void handle_connection(int fd) {
+        std::string request;
+        char buffer[8192];
+        while (!stopping) {
+            size_t header_end;
+            while ((header_end = request.find("\r\n\r\n")) == std::string::npos) {
+                ssize_t n = read(fd, buffer, sizeof(buffer));
+                if (n <= 0) {
+                    return;
+                }
+                request.append(buffer, static_cast<size_t>(n));
+            }
+            size_t content_length = 0;
+            size_t cl = request.find("Content-Length: ");
+            if (cl != std::string::npos && cl < header_end) {
+                content_length = std::stoul(request.substr(cl + 16));
+            }
+            while (request.size() < header_end + 4 + content_length) {
+                ssize_t n = read(fd, buffer, sizeof(buffer));
+                if (n <= 0) {
+                    return;
+                }
+                request.append(buffer, static_cast<size_t>(n));
+            }
+            request.erase(0, header_end + 4 + content_length);
+
+            const char* head = "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\nTransfer-Encoding: chunked\r\n\r\n";
+            if (!write_all(fd, head, std::strlen(head))) {
+                return;
+            }
+            char frame[512];
+            for (int i = 0; i < events; ++i) {
+                int len = std::snprintf(frame, sizeof(frame), "%zx\r\n%s\r\n", std::strlen(kEvent), kEvent);
+                if (!write_all(fd, frame, static_cast<size_t>(len))) {
+                    return;
+                }
+            }
+            if (!write_all(fd, "0\r\n\r\n", 5)) {
+                return;
+            }
+        }
+    }
+};
+
+size_t count_bytes(char*, size_t size, size_t nmemb, void* userdata) {
+    *static_cast<size_t*>(userdata) += size * nmemb;
+    return size * nmemb;
+}
+
+void run_transport(benchmark::State& state, bool use_unix) {
+    int events = static_cast<int>(state.range(0));
+    StandInServer server(use_unix, events);
+    if (!server.error().empty()) {
+        state.SkipWithError(server.error().c_str());
+        return;
+    }
+
+    CURL* curl = curl_easy_init();
+    if (!curl) {
+        state.SkipWithError("curl_easy_init failed");
+        return;
+    }
+    std::string url = server.url();
+    std::string body = "{\"stream\":true,\"messages\":[{\"role\":\"user\",\"content\":\"hi\"}]}";
+    size_t received = 0;
+    curl_slist* headers = curl_slist_append(nullptr, "Content-Type: application/json");
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body.c_str());
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, count_bytes);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &received);
+    if (use_unix) {
+        curl_easy_setopt(curl, CURLOPT_UNIX_SOCKET_PATH, server.unix_path().c_str());
+    }
+
+    for (auto _ : state) {
+        CURLcode rc = curl_easy_perform(curl);
+        if (rc != CURLE_OK) {
+            state.SkipWithError(curl_easy_strerror(rc));
+            break;
+        }
+    }
+    state.counters["events_per_second"] = benchmark::Counter(
+        static_cast<double>(state.iterations()) * events, benchmark::Counter::kIsRate);
+    benchmark::DoNotOptimize(received);
+
+    curl_slist_free_all(headers);
+    curl_easy_cleanup(curl);
+}
+
+void BM_StreamLoopbackTcp(benchmark::State& state) { run_transport(state, false); }
+void BM_StreamUnixSocket(benchmark::State& state) { run_transport(state, true); }
+
+} // namespace
+
+BENCHMARK(BM_StreamLoopbackTcp)->Arg(1)->Arg(256)->Arg(2048)->Unit(benchmark::kMicrosecond)->UseRealTime();
+BENCHMARK(BM_StreamUnixSocket)->Arg(1)->Arg(256)->Arg(2048)->Unit(benchmark::kMicrosecond)->UseRealTime();
@@ -0,0 +1,95 @@
+#include <benchmark/benchmark.h>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "SseParser.h"
+#include "Utils.h"
+#include "BenchFixtures.h"
+
+namespace {
+
+struct RecordedText {
+    std::string escaped; // 工具调用参数的原文（JSON 转义），即 unescape_string 的输入
+    std::string output;  // 解码后的代码和回复文本，多行，相当于一次工具输出
+};
+
+// 从录制流中取出工具参数和文本内容
+const RecordedText& recorded_text() {
+    static const RecordedText text = []() {
+        RecordedText result;
+        SseParser parser;
+        parser.feed(load_fixture("llama_cpp_stream.sse"));
+        SseEvent event;
+        while (parser.next_event(event)) {
+            if (event.data == "[DONE]") {
+                continue;
+            }
+            auto chunk = nlohmann::json::parse(event.data);
+            const auto& delta = chunk["choices"][0]["delta"];
+            if (delta.contains("content") && delta["content"].is_string()) {
+                result.output += delta["content"].get<std::string>();
+            }
+            if (delta.contains("tool_calls")) {
+                for (const auto& call : delta["tool_calls"]) {
+                    if (call.contains("function") && call["function"].contains("arguments")) {
+                        result.escaped += call["function"]["arguments"].get<std::string>();
+                    }
+                }
+            }
+        }
+        auto arguments = nlohmann::json::parse(result.escaped, nullptr, false);
+        if (arguments.is_object() && arguments.contains("code")) {
+            result.output += "\n" + arguments["code"].get<std::string>();
+        }
+        return result;
+    }();
+    return text;
+}
+
+// 把录制的文本重复到恰好 bytes 字节
+std::string sized(const std::string& recorded, size_t bytes) {
+    std::string text = replay_stream(recorded, bytes);
+    text.resize(bytes);
+    return text;
+}
+
+void BM_UnescapeString(benchmark::State& state) {
+    std::string input = sized(recorded_text().escaped, static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        std::string result = unescape_string(input);
+        benchmark::DoNotOptimize(result);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+
+void BM_FormatOutputForDisplay(benchmark::State& state) {
+    std::string input = sized(recorded_text().output, static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        std::string result = format_output_for_display(input);
+        benchmark::DoNotOptimize(result);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+
+// 按流式读取的方式把 64 KB 转义文本切成 range(0) 字节的片段，每片接上一片留下的部分
+void BM_SafePrintWithEscapes(benchmark::State& state) {
+    std::string input = sized(recorded_text().escaped, 1 << 16);
+    size_t fragment = static_cast<size_t>(state.range(0));
+    for (auto _ : state) {
+        std::string pending;
+        for (size_t pos = 0; pos < input.size(); pos += fragment) {
+            pending.append(input, pos, fragment);
+            auto [ready, rest] = safe_print_with_escapes(pending);
+            benchmark::DoNotOptimize(ready);
+            pending = std::move(rest);
+        }
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(input.size()));
+}
+
+} // namespace
+
+BENCHMARK(BM_UnescapeString)->Arg(1 << 10)->Arg(1 << 14)->Arg(1 << 18)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_FormatOutputForDisplay)->Arg(1 << 10)->Arg(1 << 14)->Arg(1 << 18)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_SafePrintWithEscapes)->Arg(8)->Arg(64)->Arg(1460)->Unit(benchmark::kMicrosecond);
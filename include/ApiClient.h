@@ -4,7 +4,19 @@
 #include <nlohmann/json.hpp>
 #include <string>
 #include <vector>
+#include <map>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <cpr/cpr.h>
+#include "ConversationHistory.h"
+#include "Metrics.h"
+#include "PythonSyntaxChecker.h"
+#include "TerminalRenderer.h"
 
 // 定义用于工具调用的结构体
 struct ToolCall {
@@ -23,8 +35,12 @@ struct ApiResponse {
     std::string content;
     std::vector<ToolCall> tool_calls;
     std::string error_message;
+    std::map<std::string, std::string> tool_results; // 已经有结果、不需要执行的工具调用（按 id），例如因语法错误被提前中止的调用
 };
 
+// 工具调用的参数JSON在流中闭合时触发的回调，调用发生在流式回调内部（即网络线程上）
+using ToolCallReadyCallback = std::function<void(const ToolCall& call)>;
+
 class ApiClient {
 public:
     /**
@@ -33,17 +49,80 @@ public:
      */
     explicit ApiClient(const nlohmann::json& config);
 
+    /**
+     * @brief 析构函数。停止后台预连接线程。
+     */
+    ~ApiClient();
+
+    ApiClient(const ApiClient&) = delete;
+    ApiClient& operator=(const ApiClient&) = delete;
+
     /**
      * @brief 发送消息到API，并处理流式响应。
-     * @param messages 当前的对话历史。这是一个引用，因为函数可能会在内部修改它（尽管当前实现没有）。
+     * @param messages 当前的对话历史，请求体由其缓存的序列化结果拼接而成。
+     * @param on_tool_call_ready 可选。每个工具调用的参数完整（且 id 和名称已知）时立即调用一次，
+     *        使调用方可以在剩余内容仍在生成时开始执行该调用。
      * @return ApiResponse 包含模型响应或工具调用请求。
      */
-    ApiResponse send_message(const nlohmann::json& messages);
+    ApiResponse send_message(const ConversationHistory& messages,
+                             const ToolCallReadyCallback& on_tool_call_ready = nullptr);
+
+    /**
+     * @brief 在用户输入期间于后台预热连接。
+     *
+     * 连接空闲达到 api.preconnect_interval_ms 时，后台线程发送一个不带 API 密钥的
+     * HEAD 请求重新建立 TCP/TLS 连接，使下一次 send_message() 可以直接复用它。
+     * 每次调用最多发送一次；下一次 send_message() 开始时中止尚未完成的 HEAD，不等待它结束。
+     */
+    void start_preconnect();
+
+    /**
+     * @brief 设置用于流式 python 工具代码的增量语法检查器。
+     *
+     * 发现无法由后续文本修复的语法错误时，立即中止当前的流，
+     * 并为该调用生成一个错误结果（见 ApiResponse::tool_results）。传入 nullptr 关闭检查。
+     */
+    void set_syntax_checker(PythonSyntaxChecker* checker) { syntax_checker = checker; }
+
+    /**
+     * @brief 设置中断检查：请求进行期间它返回 true 时中止请求，send_message() 返回 API_ERROR。
+     *
+     * 在 curl 的进度回调中调用（传输期间很频繁，空闲时约每秒一次），必须很快返回。
+     */
+    void set_interrupt_check(std::function<bool()> check) { interrupted = std::move(check); }
+
+    /**
+     * @brief 最近一次 send_message() 请求的耗时分解；每次请求也会记入 Metrics。
+     */
+    const RequestTimings& last_request_timings() const { return last_timings; }
 
 private:
     std::string url;
+    std::string unix_socket; // 非空时通过该Unix域套接字发送请求
     nlohmann::json base_payload;
+    std::string payload_prefix; // base_payload 序列化后以 "\"messages\":[" 结尾
     cpr::Header headers;
+
+    // 持久化的会话：复用同一个curl句柄及其连接缓存
+    cpr::Session session;
+    std::mutex session_mutex;
+    RequestTimings last_timings;
+    PythonSyntaxChecker* syntax_checker = nullptr;
+    std::function<bool()> interrupted;
+    std::unique_ptr<TerminalRenderer> renderer; // 流式输出的渲染线程
+
+    // 预连接状态
+    bool preconnect_enabled = true;
+    std::chrono::milliseconds preconnect_interval{4000};
+    std::chrono::steady_clock::time_point last_activity;
+    std::thread preconnect_thread;
+    std::mutex preconnect_mutex;
+    std::condition_variable preconnect_cv;
+    std::atomic<bool> preconnect_stop{false}; // 也由 HEAD 请求的进度回调读取
+
+    void stop_preconnect();
+    void warm_connection();
+    RequestTimings collect_timings();
 };
 
 #endif // API_CLIENT_H
@@ -0,0 +1,119 @@
+#ifndef BASH_SESSION_POOL_H
+#define BASH_SESSION_POOL_H
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "OutputCapture.h"
+#include "ResourceUsage.h"
+
+/**
+ * @class BashSessionPool
+ * @brief 长期运行的 bash 进程：同一会话的多次调用共享工作目录、环境变量和 shell 函数。
+ *
+ * 每个会话是一个在自己进程组中运行的 bash，从 Unix 套接字（标准输入）读取命令。
+ * 每条命令的代码用带随机标记的 here-document 传入，在当前 shell 中 eval 执行（标准输入为 /dev/null），
+ * 结束后 bash 把同样带标记的退出状态写到 fd 4；stdout 和 stderr 各自通过管道读取。
+ * 会话进程第一次使用时启动；它退出（exit、被结束）后下一次调用自动启动一个新的。
+ * 超时的命令连同整个会话进程组一起被结束（先 SIGTERM，2 秒后 SIGKILL）。
+ * 资源限制施加到 bash 进程上，由命令启动的每个进程继承；每条命令结束后 bash 用 times 报告累计的 CPU 时间。
+ *
+ * 仅支持 POSIX 系统；在其他系统上构造函数抛出 std::runtime_error。
+ */
+class BashSessionPool {
+public:
+    struct Options {
+        std::string executable = "bash"; // 会话使用的 bash
+        size_t max_sessions = 8;         // 最多同时存在的会话数
+        ResourceLimits limits;           // 施加到会话的 bash 进程上，由它启动的进程继承
+        OutputCapture::Options output;   // 每条命令的每个输出流最多保留的字节数和溢出文件
+    };
+
+    // 一条命令的结果
+    struct Run {
+        std::string output;     // stdout（超过上限时为开头、说明和结尾）
+        std::string errors;     // stderr
+        int exit_status = 0;    // 命令的退出状态；会话进程退出时为它的退出码
+        int term_signal = 0;    // 会话进程被信号结束时的信号
+        bool ended = false;     // 会话进程已经退出，工作目录、变量和函数都已丢失
+        bool timed_out = false; // 命令超过了时限，会话被结束
+        ResourceUsage usage;    // 这条命令的消耗：CPU 时间是 bash 和它已回收的子进程的增量（有 cgroup 时为整个会话）
+    };
+
+    /**
+     * @brief 构造函数。不启动任何进程。
+     * @throw std::runtime_error 当前系统不支持。
+     */
+    explicit BashSessionPool(Options options);
+
+    /**
+     * @brief 析构函数。结束所有会话。
+     */
+    ~BashSessionPool();
+
+    BashSessionPool(const BashSessionPool&) = delete;
+    BashSessionPool& operator=(const BashSessionPool&) = delete;
+
+    /**
+     * @brief 在会话中执行一条命令。
+     * @param session 会话名；第一次使用时启动 bash。
+     * @param code 要执行的代码。
+     * @param timeout 时限；零表示不限制。
+     * @throw std::runtime_error 无法启动 bash，或会话数超过上限。
+     * @note 线程安全；同一会话的命令依次执行。
+     */
+    Run run(const std::string& session, const std::string& code, std::chrono::milliseconds timeout);
+
+    /**
+     * @brief 向所有会话的进程组发送 SIGHUP（如同关闭终端）；正在执行的命令以 ended 返回。可以重复调用。
+     */
+    void shutdown();
+
+    /**
+     * @brief 会话使用的资源限制。
+     */
+    const ResourceLimits& limits() const { return options.limits; }
+
+private:
+    struct Session {
+        int pid = -1;
+        int control_fd = -1; // bash 的标准输入
+        int stdout_fd = -1;
+        int stderr_fd = -1;
+        int status_fd = -1;  // bash 的 fd 4：每条命令结束后的状态行
+        std::mutex mutex;    // 同一会话的命令依次执行
+        bool ended = false;  // 进程已经退出并被回收（持有 mutex 时访问）
+        double user_seconds = 0;   // 上一条命令结束时 times 报告的累计 CPU 时间
+        double system_seconds = 0;
+#ifndef _WIN32
+        std::unique_ptr<CgroupLeaf> cgroup; // 设置了 cgroup_root 时会话的所有进程都在其中
+#endif
+    };
+
+    Options options;
+    std::mutex mutex;
+    std::map<std::string, std::shared_ptr<Session>> sessions;
+    bool stopping = false;
+
+    /**
+     * @brief 启动一个新的 bash 会话进程。
+     * @throw std::runtime_error 无法启动。
+     */
+    std::shared_ptr<Session> start_session();
+
+    /**
+     * @brief 找到会话，没有时启动一个。
+     */
+    std::shared_ptr<Session> session_for(const std::string& name);
+
+    /**
+     * @brief 回收已经退出的会话进程，关闭它的描述符并解除绑定；下一次调用会启动新的。
+     * @param usage 不为空时写入 bash 和它已回收的子进程的累计资源消耗（wait4）。
+     * @return 进程的等待状态（waitpid 的 status）。
+     */
+    int end_session(const std::string& name, const std::shared_ptr<Session>& session, struct rusage* usage = nullptr);
+};
+
+#endif // BASH_SESSION_POOL_H
@@ -0,0 +1,84 @@
+#ifndef CAPABILITY_REGISTRY_H
+#define CAPABILITY_REGISTRY_H
+
+#include <cstdint>
+#include <future>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// 一个执行环境（python、bash、powershell、batch）的探测结果
+struct Capability {
+    std::string name;       // 工具名，与配置中 tools 的 function.name 一致
+    bool available = false;
+    std::string path;       // 在 PATH 中解析到的可执行文件；内置或未探测时为空
+    std::string version;    // 例如 "5.2.15"；未知时为空
+    int64_t mtime = 0;      // 可执行文件的修改时间，用作缓存键
+    uint64_t size = 0;      // 可执行文件的大小，用作缓存键
+};
+
+/**
+ * @class CapabilityRegistry
+ * @brief 只探测一次运行环境中可用的解释器，并缓存结果和版本号。
+ *
+ * start() 在后台线程上并行探测所有解释器（每个解释器启动一次 `--version`），
+ * 查询接口会等待探测完成，之后直接返回缓存的结果。
+ *
+ * 结果还会持久化到磁盘：缓存以 PATH 以及每个可执行文件的路径、修改时间和大小为键。
+ * 下次启动时只需在 PATH 中重新查找可执行文件（只有 stat，不启动任何进程）；
+ * 所有键都一致时直接使用缓存，否则重新探测并改写缓存。
+ *
+ * Windows 上 batch 和 powershell 总是视为可用，不启动任何进程，也不使用磁盘缓存。
+ */
+class CapabilityRegistry {
+public:
+    /**
+     * @brief 进程内唯一的实例。
+     */
+    static CapabilityRegistry& instance();
+
+    CapabilityRegistry(const CapabilityRegistry&) = delete;
+    CapabilityRegistry& operator=(const CapabilityRegistry&) = delete;
+
+    /**
+     * @brief 在后台开始探测。只有第一次调用生效。
+     * @param cache_path 磁盘缓存文件；为空时使用默认位置（$XDG_CACHE_HOME/code-atlas/capabilities.json）。
+     */
+    void start(const std::string& cache_path = "");
+
+    /**
+     * @brief 所有执行环境的探测结果，包括不可用的。
+     * @note 如果还没有调用 start()，会以默认缓存位置开始探测；阻塞直到探测完成。
+     */
+    std::vector<Capability> capabilities();
+
+    /**
+     * @brief 当前系统上可用的工具名列表。
+     */
+    std::vector<std::string> supported_shells();
+
+    /**
+     * @brief 某个工具在当前系统上是否可用。
+     */
+    bool is_available(const std::string& name);
+
+    /**
+     * @brief 本次的结果是否直接来自磁盘缓存。
+     */
+    bool loaded_from_cache();
+
+private:
+    CapabilityRegistry() = default;
+
+    struct ProbeResult {
+        std::vector<Capability> capabilities;
+        bool from_cache = false;
+    };
+
+    std::once_flag started;
+    std::shared_future<ProbeResult> result;
+
+    const ProbeResult& wait();
+};
+
+#endif // CAPABILITY_REGISTRY_H
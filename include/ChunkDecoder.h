@@ -0,0 +1,87 @@
+#ifndef CHUNK_DECODER_H
+#define CHUNK_DECODER_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 一个数据块中单个工具调用的增量
+struct ToolCallDelta {
+    int index = -1;
+    bool has_id = false;
+    bool has_name = false;
+    bool has_arguments = false;
+    std::string id;
+    std::string name;
+    std::string arguments;
+};
+
+/**
+ * @brief 从一个流式数据块中提取出的字段。
+ *
+ * 对象在数据块之间复用：clear() 只重置标志，字符串和工具调用槽位保留容量，
+ * 因此稳定状态下解码一个数据块不需要新的堆分配。
+ */
+struct DecodedChunk {
+    bool has_content = false;       // choices[0].delta.content 是字符串
+    std::string content;
+    bool has_tool_calls = false;    // choices[0].delta.tool_calls 是数组
+    std::vector<ToolCallDelta> tool_call_slots;
+    size_t tool_call_count = 0;     // tool_call_slots 中有效的前缀长度
+    bool has_finish_reason = false; // choices[0].finish_reason 是字符串
+    std::string finish_reason;
+
+    void clear();
+
+    /**
+     * @brief 追加一个工具调用增量，复用已有的槽位。
+     */
+    ToolCallDelta& add_tool_call();
+};
+
+/**
+ * @class ChunkDecoder
+ * @brief 一次遍历地从 OpenAI 兼容的流式数据块中提取
+ *        choices[0].delta.content、delta.tool_calls[*] 和 choices[0].finish_reason。
+ *
+ * 使用 nlohmann 的 SAX 接口，不构建完整的 JSON DOM；其他字段只被跳过。
+ * 遇到无法识别的结构（例如 content 是分段数组、工具调用缺少 index）或非法 JSON 时，
+ * 退回完整解析。非法 JSON 会像之前一样抛出 nlohmann::json::parse_error。
+ */
+class ChunkDecoder {
+public:
+    /**
+     * @brief 解码一个数据块。
+     * @param data 一个 SSE 事件的 data 字段。
+     * @param out 输出，会先被 clear()。
+     * @throw nlohmann::json::parse_error 如果数据不是合法的JSON。
+     */
+    void decode(std::string_view data, DecodedChunk& out);
+
+    /**
+     * @brief 因结构无法识别而退回完整解析的次数。
+     */
+    uint64_t fallback_count() const { return fallbacks; }
+
+private:
+    // 当前所在的、我们关心的位置
+    enum class Location : uint8_t { Root, Choices, FirstChoice, Delta, ToolCalls, ToolCall, Function, Ignored };
+    // 当前对象中最近读到的、我们关心的键
+    enum class Key : uint8_t { Other, Choices, Delta, FinishReason, Content, ToolCalls, Index, Id, Function, Name, Arguments };
+
+    struct Frame {
+        Location location;
+        Key key;
+        size_t elements; // 数组中已经出现的元素个数
+    };
+
+    std::vector<Frame> frames; // 跨数据块复用
+    uint64_t fallbacks = 0;
+
+    friend struct ChunkSaxHandler;
+
+    void decode_dom(std::string_view data, DecodedChunk& out);
+};
+
+#endif // CHUNK_DECODER_H
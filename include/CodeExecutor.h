@@ -3,9 +3,30 @@
 
 #include <string>
 #include <stdexcept>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "ImportProfile.h"
+#include "OutputCapture.h"
+#include "ResourceUsage.h"
 // Forward declare PyObject instead of including Python.h in the header
 struct _object;
 using PyObject = struct _object;
+struct _ts;
+using PyThreadState = struct _ts;
+
+class BashSessionPool;
+class LiveOutput;
+class PythonWorkerPool;
 
 
 /**
@@ -15,17 +36,46 @@ using PyObject = struct _object;
  * 这个类初始化一个Python解释器，并允许在同一个全局命名空间中
  * 重复执行代码，从而模拟了原始Python脚本中持久的IPython会话。
  *
- * 注意：这个类的实例不是线程安全的。
+ * 解释器的初始化、执行和关闭都在一个专用的Python线程上完成；
+ * execute() 可以从任意线程调用，调用会按提交顺序在该线程上串行执行。
+ *
+ * 执行包装函数在解释器启动时只编译一次；用户代码只解析、编译和执行一次，
+ * stdout/stderr 由一个原生写入对象直接追加到 C++ 缓冲区，不经过 io.StringIO 和全局变量；
+ * 设置了 LiveOutput 时，输出同时实时转发到终端。返回的结果中每个流最多保留
+ * execution.max_output_bytes 字节（开头和结尾各一半），完整的输出写入溢出文件（见 OutputCapture）。
+ *
+ * 设置了时限的执行由 Watchdog 监视：超时后向Python线程发送 SIGUSR1（Windows 上为 SIGBREAK），
+ * 由原生信号处理函数在用户代码中抛出 CellTimeout（BaseException 的子类），阻塞中的系统调用也会被打断；
+ * 用户代码吞掉这个异常时每秒再中断一次。解释器会话保持不变，超时只影响当前这次执行。
+ * 正在执行C扩展中的长时间计算时无法被打断，此时 execute() 在宽限期后先返回超时结果。
+ *
+ * 除默认会话外还可以使用命名会话，各自拥有独立的全局命名空间。在 Python 3.12+ 上，
+ * 每个命名会话是一个拥有独立GIL的子解释器（PEP 684），运行在自己的线程上，
+ * 不同会话中的代码可以在不同的CPU核心上真正并行执行；同一会话内的执行仍按提交顺序串行。
+ * 子解释器只能导入支持多解释器的扩展模块。在更早的版本上（或 python.subinterpreters 为 false 时），
+ * 命名会话只是主解释器中的独立命名空间，代码仍在同一个Python线程上依次执行。
+ * 子解释器中超时的代码通过异步异常打断，阻塞中的系统调用要等它返回后才会被打断。
+ *
+ * python.backend 为 "forkserver" 时（仅 POSIX），代码改在 PythonWorkerPool 的工作进程中执行，
+ * 每个会话（包括默认会话）绑定一个进程，返回结果的格式不变；用户代码崩溃不会影响本进程。
+ * 嵌入的解释器仍然启动，供语法检查使用，但不再预热模块。
+ *
+ * 构造函数不等待解释器初始化，提示符可以立即出现；第一次 execute() 会等待初始化完成。
+ * 每次执行后记录用户代码导入的顶层模块（ImportProfile）；下次启动时，
+ * 一个预热线程在后台导入最常用的那些模块。预热与执行并发进行：
+ * 工具调用只会在导入同一个模块时，由Python的模块导入锁等待该模块完成，不会等待整个预热。
  */
 class PythonExecutor {
 public:
     /**
-     * @brief 构造函数。初始化Python解释器并设置环境。
+     * @brief 构造函数。启动Python线程，在后台初始化解释器，不等待初始化完成。
+     * @param config 配置；读取 python.preload_modules、python.import_profile、
+     *               python.subinterpreters、python.max_sessions 和 python.backend 等。
      */
-    PythonExecutor();
+    explicit PythonExecutor(const nlohmann::json& config);
 
     /**
-     * @brief 析构函数。关闭Python解释器。
+     * @brief 析构函数。关闭Python解释器并结束Python线程。
      */
     ~PythonExecutor();
 
@@ -38,13 +88,193 @@ public:
     /**
      * @brief 在持久的Python会话中执行代码。
      * @param code 要执行的Python代码字符串。
-     * @return 捕获的stdout和stderr的组合输出。
+     * @param timeout 时限，从代码开始执行时算起；零表示不限制。
+     * @param session 会话名；为空表示默认会话。第一次使用某个名字时创建该会话。
+     * @return 捕获的stdout和stderr的组合输出；超时时 status 为 "timeout"，并带有 timeout_seconds。
+     *         "resources" 字段记录这次执行的资源消耗（见 ResourceUsage）。
+     * @throw std::runtime_error 解释器初始化失败、已关闭，或会话数超过 python.max_sessions。
+     * @note 线程安全；阻塞直到代码在会话的线程上执行完毕（或超时后的宽限期结束）。
+     */
+    std::string execute(const std::string& code, std::chrono::milliseconds timeout = std::chrono::milliseconds::zero(),
+                        const std::string& session = "");
+
+    /**
+     * @brief 不同的会话是否可以同时执行（各自的子解释器或工作进程，而不是共用主解释器）。
+     */
+    bool sessions_run_in_parallel() const { return use_subinterpreters || worker_pool != nullptr; }
+
+    /**
+     * @brief 设置实时输出：执行期间 stdout/stderr 的每次写入都会同时转发给它。传入 nullptr 关闭。
+     * @note 对之后开始的执行生效。
+     */
+    void set_live_output(LiveOutput* output) { live_output = output; }
+
+    /**
+     * @brief 阻塞直到解释器初始化完成（不等待模块预热）。
+     * @return 初始化成功返回 true。
      */
-    std::string execute(const std::string& code);
+    bool wait_until_ready();
+
+    /**
+     * @brief 关闭所有会话和解释器，并结束它们的线程。可以重复调用。
+     *
+     * 如果某个会话此刻正在执行用户代码，则不等待它结束，也不关闭解释器（用于进程退出前的清理）。
+     * 正在进行的预热导入会先完成，之后的模块不再导入。
+     */
+    void shutdown();
 
 private:
-    PyObject* main_module;
-    PyObject* main_dict;
+    /**
+     * @brief 一个拥有自己线程和任务队列的解释器：默认会话使用主解释器，命名会话各自使用一个子解释器。
+     *
+     * 除任务队列外的字段只在该会话的线程上、持有它的GIL时访问（中断相关的字段除外）。
+     */
+    struct Session {
+        std::string name;
+        PyObject* globals = nullptr;           // 用户代码的全局命名空间（解释器的 __main__）
+        PyObject* run_function = nullptr;      // 预编译的执行包装函数
+        PyObject* stdout_writer = nullptr;     // 把输出直接写进 C++ 缓冲区的 sys.stdout / sys.stderr 替身
+        PyObject* stderr_writer = nullptr;
+        PyObject* timeout_exception = nullptr; // code_atlas.CellTimeout
+        // 共用主解释器时，命名会话的全局命名空间（只在默认会话上使用）
+        std::map<std::string, PyObject*> namespaces;
+
+        std::thread thread;
+        std::mutex task_mutex;
+        std::condition_variable task_cv;
+        std::deque<std::function<void()>> tasks;
+        bool stopping = false;
+        std::atomic<bool> busy{false};
+        std::shared_future<std::string> ready; // 初始化的结果：空字符串表示成功，否则是错误信息
+
+        // 时限：只在当前执行超时后到执行结束之间 interrupt_requested 为 true
+        std::atomic<bool> interrupt_requested{false};
+        std::chrono::milliseconds cell_timeout{0};
+#ifndef _WIN32
+        std::thread::native_handle_type thread_handle{};
+#endif
+
+        // 子解释器：信号处理函数只在主解释器中运行，超时由中断线程用异步异常打断
+        PyThreadState* thread_state = nullptr;    // 会话线程在子解释器中的线程状态
+        PyThreadState* interrupt_state = nullptr; // 中断线程获取子解释器GIL时使用的线程状态（只在中断线程上使用）
+        unsigned long thread_id = 0;              // 会话线程的Python线程编号
+        std::thread interrupter;
+        std::mutex interrupt_mutex;
+        std::condition_variable interrupt_cv;
+        bool interrupt_pending = false;
+        bool interrupter_stopping = false;
+    };
+
+    std::unique_ptr<Session> main_session;
+    std::mutex sessions_mutex;
+    std::map<std::string, std::unique_ptr<Session>> sessions; // 子解释器中的命名会话
+    bool use_subinterpreters = false;
+    size_t max_sessions = 8;
+    std::unique_ptr<PythonWorkerPool> worker_pool; // 设置时代码在工作进程中执行
+
+    // 每次执行的状态：排队中、已开始执行、调用者已放弃（超时后仍未开始）
+    static constexpr int kCellQueued = 0;
+    static constexpr int kCellRunning = 1;
+    static constexpr int kCellAbandoned = 2;
+
+    std::atomic<LiveOutput*> live_output{nullptr};
+    OutputCapture::Options output_options; // 返回结果中每个流最多保留的字节数和溢出文件
+
+    // 导入记录和后台预热；所有会话共用一份导入记录
+    std::mutex import_profile_mutex;
+    ImportProfile import_profile;
+    size_t preload_modules = 8;
+    std::thread warmup_thread;
+    std::atomic<bool> warmup_stopping{false};
+
+    /**
+     * @brief 默认会话的线程：初始化主解释器，依次执行任务，最后关闭解释器。
+     */
+    void python_thread_main(std::promise<std::string>& report_ready);
+
+    /**
+     * @brief 命名会话的线程：等待主解释器就绪后创建子解释器，依次执行任务，最后结束子解释器。
+     */
+    void subinterpreter_thread_main(Session& session, std::promise<std::string>& report_ready);
+
+    /**
+     * @brief 在当前解释器中创建会话的命名空间、超时异常、执行包装函数和输出写入对象（持有GIL时调用）。
+     * @return 空字符串表示成功，否则是错误信息。
+     */
+    std::string setup_session(Session& session);
+
+    /**
+     * @brief 释放 setup_session() 创建的对象（持有GIL时调用）。
+     */
+    void clear_session(Session& session);
+
+    /**
+     * @brief 依次执行会话队列中的任务，直到会话停止。调用时不持有GIL。
+     * @param state 会话线程的线程状态，执行任务时用它重新获取GIL。
+     * @return 最后一个任务之后的线程状态。
+     */
+    PyThreadState* run_tasks(Session& session, PyThreadState* state);
+
+    /**
+     * @brief 找到或创建一个会话；共用主解释器时所有会话都由默认会话执行。
+     */
+    Session& session_for(const std::string& name);
+
+    /**
+     * @brief 停止一个会话的线程。
+     * @return 线程已结束返回 true；会话正在执行用户代码时放弃该线程并返回 false。
+     */
+    bool stop_session(Session& session);
+
+    /**
+     * @brief 预热线程：逐个导入记录中最常用的模块，每个模块之间释放GIL。
+     */
+    void warmup_main(std::vector<std::string> modules);
+
+    /**
+     * @brief 为中断信号注册原生的Python信号处理函数（在默认会话的线程上、持有GIL时调用）。
+     */
+    void install_interrupt_handler();
+
+    /**
+     * @brief 信号处理函数：当前执行已超时则抛出 CellTimeout，否则忽略。
+     */
+    static PyObject* interrupt_signal_handler(PyObject* self, PyObject* args);
+
+    /**
+     * @brief 由 Watchdog 调用：标记超时并中断会话的线程。不需要GIL。
+     */
+    void interrupt_cell(Session& session);
+
+    /**
+     * @brief 子解释器会话的中断线程：收到请求后获取子解释器的GIL，向会话线程发送异步的 CellTimeout。
+     */
+    void interrupter_main(Session& session);
+
+    /**
+     * @brief 把执行包装函数返回的新导入模块记入导入记录（调用时持有GIL）。
+     */
+    void record_imports(PyObject* modules);
+
+    /**
+     * @brief 把模块名记入导入记录。线程安全。
+     */
+    void record_import_names(const std::vector<std::string>& modules);
+
+    /**
+     * @brief 在会话的工作进程中执行代码，并按与嵌入解释器相同的格式返回结果。
+     * @param usage 写入工作进程报告的资源消耗。
+     */
+    std::string execute_in_worker(const std::string& code, std::chrono::milliseconds timeout, const std::string& session,
+                                  ResourceUsage& usage);
+
+    /**
+     * @brief 在会话的线程上实际执行代码（调用时持有GIL）。
+     * @param namespace_name 共用主解释器时命名会话的名字；为空表示使用会话自己的命名空间。
+     * @param usage 写入输出的字节数（时间由调用者测量）。
+     */
+    std::string execute_in_interpreter(Session& session, const std::string& namespace_name,
+                                       const std::string& code, std::chrono::milliseconds timeout, ResourceUsage& usage);
 
     /**
      * @brief 检查并处理Python C API调用期间发生的任何错误。
@@ -56,12 +286,37 @@ private:
 
 /**
  * @brief 执行一个shell命令（如PowerShell或Batch）并捕获其输出。
- * @param shell_name 用于日志记录的shell名称（例如 "powershell", "batch"）。
+ *
+ * 脚本在单独的进程组中运行（Windows 上为 Job 对象）；超时后整个进程组都会被结束，
+ * 包括脚本启动的子进程（POSIX 上先发 SIGTERM，2 秒后仍未退出再发 SIGKILL）。
+ * 限制在脚本开始执行之前施加（Linux 上为 rlimit 和可选的 cgroup v2，Windows 上为 Job 的限制），
+ * 结果中的 "resources" 字段记录墙钟时间、CPU 时间、最大内存和输出字节数。
+ * @param shell_name 用于日志记录的shell名称（例如 "powershell", "batch"）；也是 ResourceLedger 中的会话名。
  * @param code 要执行的脚本代码。
- * @return 捕获的stdout和stderr的组合输出。
+ * @param timeout 时限；零表示不限制。
+ * @param limits 资源限制。
+ * @param output 每个输出流在结果中最多保留的字节数和溢出文件。
+ * @return 捕获的stdout和stderr的组合输出；超时时 status 为 "timeout"，并带有 timeout_seconds。
  * @throw std::runtime_error 如果进程创建或执行失败。
  */
-std::string execute_shell_code(const std::string& shell_name, const std::string& code);
+std::string execute_shell_code(const std::string& shell_name, const std::string& code,
+                               std::chrono::milliseconds timeout = std::chrono::milliseconds::zero(),
+                               const ResourceLimits& limits = ResourceLimits(),
+                               const OutputCapture::Options& output = OutputCapture::Options());
+
+/**
+ * @brief 在持久的 bash 会话中执行命令：cd、export、source 和定义的函数在同一会话的后续调用中保留。
+ *
+ * 结果格式与 execute_shell_code 相同。命令让会话进程退出时（exit、崩溃）结果中会说明这一点，
+ * 下一次调用自动启动新的会话；超时的命令连同整个会话一起被结束。
+ * @param sessions 会话池。
+ * @param session 会话名；空字符串为默认会话。
+ * @param code 要执行的代码。
+ * @param timeout 时限；零表示不限制。
+ * @throw std::runtime_error 无法启动 bash，或会话数超过上限。
+ */
+std::string execute_shell_session(BashSessionPool& sessions, const std::string& session, const std::string& code,
+                                  std::chrono::milliseconds timeout = std::chrono::milliseconds::zero());
 
 
 #endif // CODE_EXECUTOR_H
@@ -0,0 +1,63 @@
+#ifndef CONTEXT_MANAGER_H
+#define CONTEXT_MANAGER_H
+
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+#include "ConversationHistory.h"
+#include "Tokenizer.h"
+
+// 一次预算检查的结果
+struct CompactionReport {
+    size_t tokens_before = 0;
+    size_t tokens_after = 0;
+    size_t compacted_outputs = 0; // 被截取为首尾摘录的工具输出数量
+    size_t dropped_messages = 0;  // 被整体删除的旧消息数量
+
+    size_t tokens_saved() const { return tokens_before - tokens_after; }
+};
+
+/**
+ * @class ContextManager
+ * @brief 按 token 预算控制发送给模型的对话历史。
+ *
+ * 使用本地分词器统计每条消息的 token 数（每条消息只统计一次）。超出
+ * context.max_prompt_tokens 时，先把较早的工具输出压缩为首尾摘录，仍然超出时
+ * 再从最早的轮次开始整轮删除。一轮从一条用户消息开始，包含随后的助手消息和
+ * 全部工具结果，因此 tool_calls 与 tool_call_id 的配对始终有效。
+ * 最近的 context.keep_recent_turns 轮和系统消息不会被修改。
+ */
+class ContextManager {
+public:
+    /**
+     * @brief 构造函数。
+     * @param config 从配置文件加载的JSON对象，读取其中的 context 部分。
+     */
+    explicit ContextManager(const nlohmann::json& config);
+
+    /**
+     * @brief 是否配置了 token 预算。
+     */
+    bool enabled() const { return max_prompt_tokens > 0; }
+
+    /**
+     * @brief 检查预算并在需要时压缩历史。
+     * @param history 对话历史，超出预算时会被原地修改。
+     * @return 本次检查的统计结果。
+     */
+    CompactionReport enforce(ConversationHistory& history);
+
+private:
+    Tokenizer tokenizer;
+    size_t max_prompt_tokens = 0;
+    size_t head_chars = 2000;
+    size_t tail_chars = 2000;
+    size_t keep_recent_turns = 2;
+    std::vector<size_t> token_counts; // 与 history 的下标一一对应
+
+    size_t message_tokens(const nlohmann::json& message) const;
+    std::string excerpt(const std::string& text) const;
+    nlohmann::json compact_tool_message(const nlohmann::json& message) const;
+};
+
+#endif // CONTEXT_MANAGER_H
@@ -0,0 +1,77 @@
+#ifndef CONVERSATION_HISTORY_H
+#define CONVERSATION_HISTORY_H
+
+#include <nlohmann/json.hpp>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @class ConversationHistory
+ * @brief 只追加的对话历史，缓存每条消息的序列化结果。
+ *
+ * 每条消息在追加时只序列化一次，并追加到一个已序列化的 messages 数组主体中。
+ * 发送请求时直接拼接预先序列化好的片段，不再深拷贝和重新序列化整个历史，
+ * 因此每轮的客户端开销只与新增的消息成正比。只有上下文压缩才会修改已有消息，
+ * 此时只重新拼接被修改位置之后的片段。
+ */
+class ConversationHistory {
+public:
+    /**
+     * @brief 构造函数。
+     * @param system_suffix 发送时追加到首条系统消息内容末尾的文本（例如操作系统提示）。
+     *                      它只出现在序列化结果中，不会修改保存的消息。
+     */
+    explicit ConversationHistory(std::string system_suffix = "");
+
+    /**
+     * @brief 追加一条消息并立即缓存它的序列化结果。
+     * @param message 符合 OpenAI Chat Completions 格式的消息对象。
+     */
+    void push_back(nlohmann::json message);
+
+    /**
+     * @brief 替换一条已有消息（用于上下文压缩），之后的序列化片段会被重新拼接。
+     * @param index 消息下标。
+     * @param message 新的消息对象。
+     */
+    void replace(size_t index, nlohmann::json message);
+
+    /**
+     * @brief 删除 [first, last) 范围内的消息（用于上下文压缩）。
+     */
+    void erase(size_t first, size_t last);
+
+    size_t size() const { return entries.size(); }
+    bool empty() const { return entries.empty(); }
+    const nlohmann::json& operator[](size_t index) const { return entries[index].message; }
+    const nlohmann::json& back() const { return entries.back().message; }
+
+    /**
+     * @brief messages 数组的序列化主体（不含方括号，消息之间以逗号分隔）。
+     */
+    const std::string& serialized_messages() const { return joined; }
+
+    /**
+     * @brief 组装完整的请求体。
+     * @param payload_prefix 以 "\"messages\":[" 结尾的请求体前缀，由调用者预先序列化。
+     * @return 可直接发送的JSON请求体。
+     */
+    std::string request_body(std::string_view payload_prefix) const;
+
+private:
+    struct Entry {
+        nlohmann::json message;
+        std::string serialized;
+        size_t offset; // 在 joined 中的起始位置
+    };
+
+    std::string system_suffix;
+    std::vector<Entry> entries;
+    std::string joined;
+
+    std::string serialize(size_t index, const nlohmann::json& message) const;
+    void rejoin_from(size_t index);
+};
+
+#endif // CONVERSATION_HISTORY_H
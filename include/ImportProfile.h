@@ -0,0 +1,52 @@
+#ifndef IMPORT_PROFILE_H
+#define IMPORT_PROFILE_H
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+/**
+ * @class ImportProfile
+ * @brief 记录各次会话实际导入的顶层模块，保存在一个小的本地JSON文件中。
+ *
+ * 每个模块在一次会话中最多计数一次，因此计数表示“有多少次会话用到了它”。
+ * PythonExecutor 在启动后于后台预先导入最常用的那些模块。
+ * 文件缺失或损坏时等同于空的记录；写入失败会被忽略。
+ */
+class ImportProfile {
+public:
+    /**
+     * @brief 构造函数。读取已有的记录。
+     * @param path 记录文件；为空时不读写文件，只在内存中计数。
+     */
+    explicit ImportProfile(std::string path);
+
+    /**
+     * @brief 出现在至少 min_sessions 次会话中的模块，按会话数从多到少排列。
+     * @param max_modules 最多返回的模块数。
+     * @param min_sessions 最少的会话数；只出现过一次的导入通常不值得预加载。
+     */
+    std::vector<std::string> most_frequent(size_t max_modules, size_t min_sessions = 2) const;
+
+    /**
+     * @brief 记录本次会话导入了一个模块。
+     * @return 如果这是本次会话第一次记录该模块（计数发生了变化）返回 true。
+     */
+    bool record(const std::string& module);
+
+    /**
+     * @brief 把记录写回文件。
+     */
+    void save() const;
+
+private:
+    // 文件中最多保留的模块数；超出时丢弃会话数最少的
+    static constexpr size_t kMaxEntries = 64;
+
+    std::string path;
+    std::map<std::string, size_t> sessions_by_module;
+    std::set<std::string> recorded_this_session;
+};
+
+#endif // IMPORT_PROFILE_H
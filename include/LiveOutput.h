@@ -0,0 +1,89 @@
+#ifndef LIVE_OUTPUT_H
+#define LIVE_OUTPUT_H
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+/**
+ * @class LiveOutput
+ * @brief 在工具运行期间把它的输出实时写到终端。
+ *
+ * 写入方（例如 Python 线程上的 sys.stdout）只在锁内把文本追加到待写缓冲区；
+ * 一个刷新线程每隔 flush_interval 最多写一次终端，因此大量的小写入不会变成大量的系统调用。
+ * stdout 和 stderr 写入同一个缓冲区，保持它们被写入的先后顺序；stderr 部分显示为红色。
+ *
+ * hold() 期间（例如模型回复仍在流式输出）只缓存不写出，避免与回复交错；
+ * 缓存超过 max_pending_bytes 后丢弃新的文本并在 release() 时注明。这只影响终端显示，
+ * 返回给模型的结果由执行器单独收集。
+ */
+class LiveOutput {
+public:
+    /**
+     * @brief 构造函数。启动刷新线程。
+     * @param flush_interval 两次写终端之间的最小间隔。
+     * @param max_pending_bytes 尚未写出的文本的上限。
+     */
+    explicit LiveOutput(std::chrono::milliseconds flush_interval = std::chrono::milliseconds(100),
+                        size_t max_pending_bytes = 1024 * 1024);
+
+    /**
+     * @brief 析构函数。写出剩余内容并停止刷新线程。
+     */
+    ~LiveOutput();
+
+    LiveOutput(const LiveOutput&) = delete;
+    LiveOutput& operator=(const LiveOutput&) = delete;
+
+    /**
+     * @brief 追加一段输出。线程安全。
+     * @param text 文本。
+     * @param is_stderr 是否来自 stderr。
+     */
+    void write(std::string_view text, bool is_stderr);
+
+    /**
+     * @brief 暂停写终端，之后的输出只缓存。
+     */
+    void hold();
+
+    /**
+     * @brief 恢复写终端。
+     */
+    void release();
+
+    /**
+     * @brief 立即写出所有缓存的输出，并结束当前这一段（下一次输出前会重新打印标题）。
+     *
+     * 在打印工具结果之前调用，保证实时输出出现在结果之前。
+     */
+    void flush();
+
+private:
+    std::chrono::milliseconds flush_interval;
+    size_t max_pending_bytes;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::string pending;           // 待写出的文本，已包含颜色控制序列
+    bool pending_is_stderr = false; // pending 末尾当前处于 stderr 颜色中
+    size_t dropped_bytes = 0;      // 因缓存已满丢弃的字节数
+    bool section_open = false;     // 当前段已经打印过标题
+    bool last_was_newline = true;  // 最后追加的文本以换行结尾
+    bool held = false;
+    bool stopping = false;
+    std::mutex write_mutex;        // 保证取出的各段按顺序写到终端；只在持有 mutex 时获取
+    std::thread flusher;
+
+    void flusher_loop();
+
+    /**
+     * @brief 写出 pending（调用时持有锁）。
+     */
+    void write_pending(std::unique_lock<std::mutex>& lock);
+};
+
+#endif // LIVE_OUTPUT_H
@@ -0,0 +1,211 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+// 单次HTTP请求的耗时分解，除特别说明外时间均从请求开始计算（毫秒）
+struct RequestTimings {
+    double serialize_ms = 0.0;      // 拼接请求体的耗时（在请求开始之前）
+    double connect_ms = 0.0;        // TCP连接建立完成；复用连接时为0
+    double tls_ms = 0.0;            // TLS握手完成；明文或复用连接时为0
+    double ttfb_ms = 0.0;           // 收到响应的第一个字节
+    double ttft_ms = 0.0;           // 收到第一段文本或工具调用；没有收到时为0
+    double stream_ms = 0.0;         // 从第一段文本到请求结束
+    double total_ms = 0.0;          // 整个请求（包括流式传输）结束
+    size_t output_tokens = 0;       // 流中带有文本或工具参数的增量个数（服务器通常每个 token 发送一个）
+    double tokens_per_second = 0.0; // 第一段文本之后的生成速度；无法计算时为0
+    size_t request_bytes = 0;       // 请求体大小
+    size_t response_bytes = 0;      // 响应体大小
+    bool reused_connection = false; // 是否复用了保持活动的连接
+    long http_version = 0;          // 实际使用的HTTP版本 (CURL_HTTP_VERSION_*)
+};
+
+/**
+ * @class Histogram
+ * @brief HDR 风格的对数线性直方图，记录非负整数。
+ *
+ * 每个 2 的幂区间分成 128 个等宽的桶，任何值的相对误差都不超过 1/128；
+ * 内存大小固定（约 35KB），与记录的数量无关。超过 2^40 的值按 2^40 记录。
+ */
+class Histogram {
+public:
+    void record(uint64_t value);
+
+    uint64_t count() const { return total; }
+    double sum() const { return total_sum; }
+    uint64_t min() const { return total == 0 ? 0 : min_value; }
+    uint64_t max() const { return max_value; }
+
+    /**
+     * @brief 分位数（0 到 1）对应的值：所在桶的中点，并限制在 [min, max] 之内。没有记录时为 0。
+     */
+    uint64_t value_at(double quantile) const;
+
+private:
+    static constexpr int kSubBucketBits = 7;
+    static constexpr int kMaxValueBits = 40;
+
+    std::vector<uint64_t> counts; // 第一次记录时分配
+    uint64_t total = 0;
+    double total_sum = 0;
+    uint64_t min_value = UINT64_MAX;
+    uint64_t max_value = 0;
+
+    static size_t index_of(uint64_t value);
+    static uint64_t lowest_of(size_t index);
+    static uint64_t highest_of(size_t index);
+};
+
+// 指标的单位，决定直方图中的精度和显示方式
+enum class MetricUnit {
+    Seconds,  // 以微秒记录
+    Bytes,
+    Count,
+    PerSecond // 以千分之一记录
+};
+
+/**
+ * @class Metrics
+ * @brief 按名称（和可选的工具名标签）累计延迟和吞吐量直方图，供 /stats 命令和导出文件使用。
+ */
+class Metrics {
+public:
+    static Metrics& instance();
+
+    Metrics(const Metrics&) = delete;
+    Metrics& operator=(const Metrics&) = delete;
+
+    /**
+     * @brief 记录一个值。
+     * @param name 指标名，例如 "request_ttft_seconds"；导出时加上 "code_atlas_" 前缀。
+     * @param tool 工具名标签（导出为 tool="..."）；为空表示没有标签。
+     */
+    void record(const std::string& name, MetricUnit unit, double value, const std::string& tool = "");
+
+    /**
+     * @brief 记录一次请求的各项耗时、速度和大小。
+     */
+    void record_request(const RequestTimings& timings);
+
+    /**
+     * @brief 保存最近一轮对话的耗时分解（TurnBreakdown::finish() 调用）。
+     */
+    void set_last_turn(nlohmann::json breakdown);
+
+    /**
+     * @brief 每个指标一行的分位数表，以及最近一轮的分解；还没有记录时返回一行说明。
+     */
+    std::string summary() const;
+
+    /**
+     * @brief Prometheus 文本格式（每个指标是一个 summary）。
+     */
+    std::string prometheus() const;
+
+    /**
+     * @brief JSON 快照：每个指标的数量、总和、最小/最大值和分位数，以及最近一轮的分解。
+     */
+    nlohmann::json snapshot() const;
+
+    /**
+     * @brief 每次记录都会加一，用于判断自上次导出以来是否有新数据。
+     */
+    uint64_t generation() const;
+
+private:
+    struct Series {
+        MetricUnit unit;
+        Histogram histogram;
+    };
+
+    Metrics();
+
+    mutable std::mutex mutex;
+    std::map<std::pair<std::string, std::string>, Series> series; // (名称, 工具名)
+    nlohmann::json last_turn;
+    uint64_t records = 0;
+    std::chrono::system_clock::time_point started;
+};
+
+/**
+ * @class TurnBreakdown
+ * @brief 一轮对话（从用户输入到最终回复）的耗时分解：各次请求的各阶段、每个工具的执行时间。
+ *
+ * add_tool() 可以在执行工具的线程上调用。
+ */
+class TurnBreakdown {
+public:
+    TurnBreakdown();
+
+    void add_request(const RequestTimings& timings);
+    void add_tool(const std::string& tool, double seconds);
+
+    /**
+     * @brief 记录回复结束之后等待工具结果的时间（提前开始的调用与流式传输重叠的部分不计入）。
+     */
+    void add_tool_wait(double seconds);
+
+    /**
+     * @brief 结束这一轮：记录 turn_* 指标并保存为 Metrics 中的最近一轮。
+     */
+    void finish();
+
+private:
+    std::mutex mutex;
+    std::chrono::steady_clock::time_point start;
+    size_t requests = 0;
+    double serialize_ms = 0;
+    double connect_ms = 0;
+    double ttfb_ms = 0;
+    double ttft_ms = 0; // 第一个请求的
+    double stream_ms = 0;
+    double api_ms = 0;
+    size_t output_tokens = 0;
+    size_t request_bytes = 0;
+    double tool_wait_seconds = 0;
+    std::map<std::string, std::pair<size_t, double>> tools; // 工具名 -> (调用次数, 总秒数)
+};
+
+/**
+ * @class MetricsExporter
+ * @brief 定期把 Metrics 写成 Prometheus 文本文件（可供 node_exporter 的 textfile collector 读取）和 JSON 快照。
+ *
+ * 配置：metrics.prometheus_file、metrics.json_file、metrics.export_interval_seconds。
+ * 两个文件都没有配置时不启动线程。文件先写到临时文件再重命名，读取方不会看到写了一半的内容。
+ */
+class MetricsExporter {
+public:
+    explicit MetricsExporter(const nlohmann::json& config);
+    ~MetricsExporter();
+
+    MetricsExporter(const MetricsExporter&) = delete;
+    MetricsExporter& operator=(const MetricsExporter&) = delete;
+
+    /**
+     * @brief 立即写出（有新数据时）；退出前调用以保留最后的数据。
+     */
+    void export_now();
+
+private:
+    std::string prometheus_file;
+    std::string json_file;
+    std::chrono::seconds interval{15};
+    std::mutex export_mutex; // 导出线程和 export_now() 的调用方不会同时写文件
+    uint64_t exported_generation = UINT64_MAX;
+
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool stopping = false;
+};
+
+#endif // METRICS_H
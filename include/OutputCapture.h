@@ -0,0 +1,105 @@
+#ifndef OUTPUT_CAPTURE_H
+#define OUTPUT_CAPTURE_H
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <nlohmann/json.hpp>
+
+/**
+ * @class OutputCapture
+ * @brief 有上限的工具输出缓冲区。
+ *
+ * 超过上限时内存中只保留开头和结尾各一半，中间的部分只计数；
+ * str() 在两段之间插入一行说明被省略了多少字节和行。截断位置会避开 UTF-8 多字节字符的中间。
+ * 结尾部分按块丢弃旧数据，每个追加的字节摊还只复制常数次。
+ *
+ * 用 Options 构造时，超过上限的那一刻起整个流（包括已经保留的开头）都写入溢出目录下的一个文件，
+ * 说明中给出文件路径和完整输出的字节数、行数，模型可以用工具分段读取。
+ */
+class OutputCapture {
+public:
+    /**
+     * @struct Options
+     * @brief 工具输出的上限和溢出文件（配置中的 execution.max_output_bytes、execution.spill_output
+     *        和 execution.output_spill_dir）。
+     */
+    struct Options {
+        size_t max_bytes = 1024 * 1024; // 内存中每个流最多保留的字节数；0 表示不限制
+        std::string spill_directory;    // 超出上限的完整输出写到这里；为空时使用临时目录下的 code-atlas-<pid>
+        bool spill_to_disk = true;      // 超过上限时是否把完整输出写入文件
+
+        Options() = default;
+        explicit Options(const nlohmann::json& config);
+    };
+
+    /**
+     * @brief 构造函数。不写文件。
+     * @param max_bytes 内存中最多保留的字节数；0 表示不限制。
+     */
+    explicit OutputCapture(size_t max_bytes = 0);
+
+    /**
+     * @brief 构造函数。超过上限时把完整的流写入溢出目录。
+     * @param stream 流的名字（"stdout"、"stderr"），用于文件名。
+     */
+    OutputCapture(const Options& options, const char* stream);
+
+    ~OutputCapture();
+
+    OutputCapture(const OutputCapture&) = delete;
+    OutputCapture& operator=(const OutputCapture&) = delete;
+
+    void append(std::string_view data);
+
+    bool empty() const { return total == 0; }
+
+    /**
+     * @brief 目前为止追加的总字节数（包括被省略的）。
+     */
+    size_t total_bytes() const { return total; }
+
+    /**
+     * @brief 目前为止追加的总行数（最后一行没有换行符时也算一行）。
+     */
+    size_t total_lines() const { return newlines + (ends_with_newline ? 0 : 1) - (total == 0 ? 1 : 0); }
+
+    /**
+     * @brief 被省略的字节数。
+     */
+    size_t omitted_bytes() const;
+
+    /**
+     * @brief 保存完整输出的文件；没有溢出（或无法写入）时为空。
+     */
+    const std::string& spill_path() const { return spill_file; }
+
+    /**
+     * @brief 保留下来的内容；有省略时为 开头 + 说明 + 结尾。
+     */
+    std::string str() const;
+
+private:
+    size_t head_limit;  // 0 表示不限制
+    size_t tail_limit;
+    std::string head;
+    std::string tail;   // 可能暂时比 tail_limit 长，最多两倍
+    size_t total = 0;
+    size_t newlines = 0;
+    bool ends_with_newline = false;
+
+    // 溢出文件：超过上限时打开，此后每次追加都写入
+    std::string spill_directory;
+    const char* stream = "";
+    bool spill_enabled = false;
+    std::string spill_file;
+    std::unique_ptr<std::ofstream> spill;
+
+    /**
+     * @brief 第一次超过上限时创建溢出文件并写入已经保留的开头；失败时不再尝试。
+     */
+    void start_spill();
+};
+
+#endif // OUTPUT_CAPTURE_H
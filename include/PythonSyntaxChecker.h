@@ -0,0 +1,120 @@
+#ifndef PYTHON_SYNTAX_CHECKER_H
+#define PYTHON_SYNTAX_CHECKER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+// Forward declare PyObject instead of including Python.h in the header
+struct _object;
+using PyObject = struct _object;
+
+class PythonExecutor;
+
+// 一次检查发现的无法由后续文本修复的语法错误
+struct SyntaxCheckResult {
+    std::string message; // SyntaxError 的 msg，例如 "invalid syntax"
+    int line = 0;        // 出错的行号（从1开始）
+    std::string text;    // 出错的那一行源码
+};
+
+// 提前中止的统计
+struct SyntaxCheckStats {
+    size_t aborted_streams = 0; // 因语法错误提前中止的流
+    size_t tokens_saved = 0;    // 估算的节省的生成 token 数
+};
+
+/**
+ * @class PythonSyntaxChecker
+ * @brief 在后台线程上对流式生成中的 python 工具代码做增量语法检查。
+ *
+ * ApiClient 每收到新的完整行就提交一次快照（只保留最新的一份），
+ * 后台线程通过 PyGILState_Ensure 获取GIL后编译这段前缀。
+ * 只有在后续文本无法修复时才判定为致命错误：错误所在行之后已经有完整的行，
+ * 并且不是 "'(' was never closed" 或未闭合的三引号字符串这类由开头位置报告的错误。
+ * 文件末尾处的错误（缺少缩进块、缺少 except 等）会报告在最后一行，因此不会误判。
+ *
+ * 后台线程先等待 PythonExecutor 完成解释器初始化，再创建编译辅助函数；
+ * 在此之前提交的快照会保留到那时再编译。本对象必须先于 PythonExecutor 析构。
+ */
+class PythonSyntaxChecker {
+public:
+    /**
+     * @brief 构造函数。启动后台线程，不等待解释器初始化。
+     * @param executor 提供解释器的执行器。
+     */
+    explicit PythonSyntaxChecker(PythonExecutor& executor);
+
+    /**
+     * @brief 析构函数。停止后台线程并释放编译辅助函数。
+     */
+    ~PythonSyntaxChecker();
+
+    PythonSyntaxChecker(const PythonSyntaxChecker&) = delete;
+    PythonSyntaxChecker& operator=(const PythonSyntaxChecker&) = delete;
+
+    /**
+     * @brief 开始检查一个新的工具调用，丢弃之前的快照和结果。
+     */
+    void begin();
+
+    /**
+     * @brief 提交当前调用目前为止的代码。只有最后一个换行符之前的完整行会被编译。
+     * @param code 已解码的部分代码。
+     */
+    void submit(std::string_view code);
+
+    /**
+     * @brief 非阻塞地查询当前调用是否已经发现致命语法错误。
+     * @param result 发现错误时写入错误信息。
+     * @return 是否发现了致命错误。
+     */
+    bool fatal_error(SyntaxCheckResult& result);
+
+    /**
+     * @brief 记录一次提前中止。
+     * @param generated_bytes 被中止的调用已经生成的代码字节数。
+     *
+     * 节省的 token 按"剩余部分与已生成部分一样长"估算，并按约 4 字节一个 token 换算。
+     */
+    void record_abort(size_t generated_bytes);
+
+    /**
+     * @brief 目前为止的中止统计。
+     */
+    SyntaxCheckStats stats() const;
+
+private:
+    PythonExecutor& executor;
+    PyObject* check_function = nullptr; // 在捕获警告的情况下编译源码的辅助函数；只由后台线程访问
+    std::atomic<bool> disabled{false};  // 解释器或辅助函数不可用时不再接受快照
+
+    std::thread worker;
+    mutable std::mutex mutex;
+    std::condition_variable cv;
+    std::string pending;       // 等待编译的最新快照
+    bool has_pending = false;
+    unsigned long generation = 0; // 每次 begin() 加一，丢弃过期的结果
+    bool has_fatal = false;
+    SyntaxCheckResult fatal;
+    SyntaxCheckStats counters;
+    bool stopping = false;
+
+    void worker_loop();
+
+    /**
+     * @brief 创建编译辅助函数（调用时持有GIL）。
+     */
+    bool create_check_function();
+
+    /**
+     * @brief 编译一段完整行组成的源码（调用时持有GIL）。
+     * @return 是否发现了致命错误。
+     */
+    bool compile_prefix(const std::string& source, SyntaxCheckResult& result);
+};
+
+#endif // PYTHON_SYNTAX_CHECKER_H
@@ -0,0 +1,161 @@
+#ifndef PYTHON_WORKER_POOL_H
+#define PYTHON_WORKER_POOL_H
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ResourceUsage.h"
+
+class LiveOutput;
+class OutputCapture;
+
+/**
+ * @class PythonWorkerPool
+ * @brief 在独立进程中执行Python代码：工作进程从一个预热好的模板进程 fork 出来。
+ *
+ * 模板进程启动时编译执行包装函数并导入常用模块，之后只等待 fork 请求；
+ * 每个工作进程通过一对 Unix 套接字与本进程通信（套接字的一端经 SCM_RIGHTS 传给模板进程），
+ * 因此新的工作进程只需要一次 fork 就能就绪。后台线程始终保持若干个空闲的工作进程。
+ *
+ * 每个会话第一次使用时绑定一个空闲的工作进程，之后的执行都在这个进程中进行，变量得以保留；
+ * 不同会话在不同的进程中并行执行。工作进程崩溃（例如C扩展中的段错误）只会丢失该会话的状态，
+ * 下一次执行会换一个新的工作进程。超时的执行先收到 SIGUSR1（在用户代码中抛出 CellTimeout），
+ * 仍不结束时工作进程被强制结束。工作进程是模板进程的子进程，退出后由模板保留到本进程释放它为止，
+ * 信号也经由模板发送，因此不会因为 pid 被重用而发给无关的进程。设置了资源限制时，每次执行期间工作进程的 CPU 时间和地址空间受限，
+ * 超出 CPU 限额同样抛出 CellTimeout，超出内存限额时分配失败（MemoryError）。
+ *
+ * 仅支持 POSIX 系统；在其他系统上构造函数抛出 std::runtime_error。
+ */
+class PythonWorkerPool {
+public:
+    struct Options {
+        std::string executable = "python3";   // 模板进程使用的Python解释器
+        std::string wrapper_source;           // 定义 _run(source, namespace, stdout, stderr) 的执行包装代码
+        std::vector<std::string> preload;     // 模板进程预先导入的模块
+        size_t idle_workers = 2;              // 保持空闲的工作进程数
+        size_t max_sessions = 8;              // 最多同时存在的会话数
+        ResourceLimits limits;                // 每次执行的 CPU 时间和地址空间限制（cpu_seconds、memory_bytes）
+    };
+
+    // 一次执行的结果；输出已经写入调用者提供的缓冲区
+    struct Run {
+        enum class Outcome {
+            Completed, // 包装函数正常返回
+            Failed,    // SystemExit、KeyboardInterrupt 这类异常逃出了包装函数
+            Lost       // 工作进程退出或被结束，会话状态已丢失
+        };
+        Outcome outcome = Outcome::Completed;
+        bool timed_out = false;            // 执行超过了时限（无论之后是否被成功打断）
+        std::vector<std::string> imports;  // 代码导入的新模块
+        std::string failure;               // Failed 时逃出的异常的 traceback
+        ResourceUsage usage;               // 工作进程报告的 CPU 时间和最大内存（Lost 时只有墙钟时间）
+    };
+
+    /**
+     * @brief 构造函数。启动模板进程和补充空闲工作进程的后台线程，不等待它们就绪。
+     * @throw std::runtime_error 当前系统不支持。
+     */
+    explicit PythonWorkerPool(Options options);
+
+    /**
+     * @brief 析构函数。结束模板进程和所有工作进程。
+     */
+    ~PythonWorkerPool();
+
+    PythonWorkerPool(const PythonWorkerPool&) = delete;
+    PythonWorkerPool& operator=(const PythonWorkerPool&) = delete;
+
+    /**
+     * @brief 在会话的工作进程中执行代码。
+     * @param session 会话名；第一次使用时绑定一个工作进程。
+     * @param code 要执行的代码（已去掉首尾空白）。
+     * @param timeout 时限；零表示不限制。
+     * @param interrupt_message 超时时 CellTimeout 的消息。
+     * @param stdout_capture,stderr_capture 接收输出的缓冲区。
+     * @param live 同时接收实时输出；可以为空。
+     * @throw std::runtime_error 无法启动工作进程，或会话数超过上限。
+     * @note 线程安全；同一会话的执行依次进行。
+     */
+    Run run(const std::string& session, const std::string& code, std::chrono::milliseconds timeout,
+            const std::string& interrupt_message, OutputCapture& stdout_capture, OutputCapture& stderr_capture,
+            LiveOutput* live);
+
+    /**
+     * @brief 结束模板进程和所有工作进程；正在进行的执行以 Lost 返回。可以重复调用。
+     */
+    void shutdown();
+
+private:
+    struct Worker {
+        int pid = -1;       // 模板进程的子进程；release_worker() 之前不会被回收
+        int fd = -1;        // 与工作进程通信的套接字
+        std::mutex mutex;   // 同一会话的执行依次进行
+        bool lost = false;  // 进程已经退出或被结束（持有 mutex 时访问）
+    };
+
+    Options options;
+
+    std::mutex template_mutex;  // 保护与模板进程的请求/应答
+    int template_pid = -1;
+    int template_fd = -1;
+    std::string template_error; // 模板进程无法启动或已退出时的错误信息
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::shared_ptr<Worker>> idle;
+    std::map<std::string, std::shared_ptr<Worker>> sessions;
+    std::vector<std::shared_ptr<Worker>> retired; // 已经丢失的工作进程，析构时关闭它们的套接字
+    bool stopping = false;
+    std::thread spawner;
+
+    /**
+     * @brief 启动模板进程（构造时调用）。
+     */
+    void start_template();
+
+    /**
+     * @brief 让模板进程 fork 一个新的工作进程。
+     * @throw std::runtime_error 模板进程不可用。
+     */
+    std::shared_ptr<Worker> spawn_worker();
+
+    /**
+     * @brief 向模板进程发送一个请求（持有 template_mutex 时调用）。
+     * @param fd 随请求传给模板进程的描述符（'w' 请求）；-1 表示没有。
+     * @return 请求已经完整写出。
+     */
+    bool send_template_request(char command, int pid, int signum, int fd = -1);
+
+    /**
+     * @brief 经由模板进程向工作进程发送信号；模板只向还没有释放的子进程发送。模板进程不可用时什么也不做。
+     */
+    void signal_worker(int pid, int signum);
+
+    /**
+     * @brief 让模板进程结束并回收工作进程；之后不能再向这个 pid 发送信号。
+     */
+    void release_worker(int pid);
+
+    /**
+     * @brief 后台线程：保持 options.idle_workers 个空闲的工作进程。
+     */
+    void spawner_main();
+
+    /**
+     * @brief 找到会话的工作进程，没有时取一个空闲的（或立即 fork 一个）。
+     */
+    std::shared_ptr<Worker> worker_for(const std::string& session);
+
+    /**
+     * @brief 把会话的工作进程标记为丢失并结束它；下一次执行会换一个新的。
+     */
+    void retire(const std::string& session, const std::shared_ptr<Worker>& worker);
+};
+
+#endif // PYTHON_WORKER_POOL_H
@@ -0,0 +1,170 @@
+#ifndef RESOURCE_USAGE_H
+#define RESOURCE_USAGE_H
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <nlohmann/json.hpp>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+/**
+ * @struct ResourceUsage
+ * @brief 一次工具调用消耗的资源；附加在结果 JSON 的 "resources" 字段中。
+ */
+struct ResourceUsage {
+    double wall_seconds = 0;
+    double user_seconds = 0;    // 用户态 CPU 时间（包括已回收的子进程）
+    double system_seconds = 0;  // 内核态 CPU 时间
+    long max_rss_kb = -1;       // 最大常驻内存；-1 表示未知
+    size_t output_bytes = 0;    // stdout 和 stderr 的总字节数（截断之前）
+    long processes = -1;        // 启动的进程数（cgroup 中的峰值）；-1 表示未知
+    std::string limit_exceeded; // 超出的限制："cpu"、"memory" 或 "processes"；没有为空
+
+    nlohmann::json to_json() const;
+};
+
+/**
+ * @struct ResourceLimits
+ * @brief 工具调用的资源限制（配置中的 execution.limits 和 execution.cgroup_root）；0 表示不限制。
+ */
+struct ResourceLimits {
+    double cpu_seconds = 0;     // 每个进程的 CPU 时间（RLIMIT_CPU）
+    size_t memory_bytes = 0;    // 有 cgroup 时为 memory.max，否则为每个进程的地址空间（RLIMIT_AS）
+    long max_processes = 0;     // pids.max；只在有 cgroup 时生效
+    std::string cgroup_root;    // 委派给本进程的 cgroup v2 目录；为空时不使用 cgroup
+
+    ResourceLimits() = default;
+    explicit ResourceLimits(const nlohmann::json& config);
+
+    /**
+     * @brief 是否有需要在用户代码运行之前施加到进程上的限制（rlimit 或 cgroup）。
+     */
+    bool applies_to_processes() const { return cpu_seconds > 0 || memory_bytes > 0 || !cgroup_root.empty(); }
+};
+
+/**
+ * @class ResourceMeter
+ * @brief 测量当前线程上一段执行的墙钟时间和 CPU 时间（用于内嵌解释器）。
+ *
+ * Linux 上 CPU 时间只计算当前线程；其他 POSIX 系统上为整个进程。max_rss_kb 总是整个进程的峰值。
+ */
+class ResourceMeter {
+public:
+    ResourceMeter();
+
+    /**
+     * @brief 把从构造到现在的消耗写入 usage（不改动 output_bytes 等其他字段）。
+     */
+    void finish(ResourceUsage& usage) const;
+
+private:
+    std::chrono::steady_clock::time_point start;
+    double start_user = 0;
+    double start_system = 0;
+};
+
+/**
+ * @class ResourceLedger
+ * @brief 按会话（"python"、"python:<name>"、"bash:<name>" 等）累计资源消耗，供 /resources 命令显示。
+ */
+class ResourceLedger {
+public:
+    static ResourceLedger& instance();
+
+    ResourceLedger(const ResourceLedger&) = delete;
+    ResourceLedger& operator=(const ResourceLedger&) = delete;
+
+    void record(const std::string& key, const ResourceUsage& usage);
+
+    /**
+     * @brief 每个会话一行的汇总表；还没有记录时返回一行说明。
+     */
+    std::string summary() const;
+
+private:
+    struct Totals {
+        size_t calls = 0;
+        double wall_seconds = 0;
+        double cpu_seconds = 0;
+        double max_call_wall_seconds = 0; // 最慢的一次调用
+        double max_call_cpu_seconds = 0;  // CPU 最多的一次调用
+        long peak_rss_kb = -1;
+        size_t output_bytes = 0;
+        size_t limits_exceeded = 0;
+    };
+
+    ResourceLedger() = default;
+
+    mutable std::mutex mutex;
+    std::map<std::string, Totals> totals;
+};
+
+/**
+ * @brief 把资源消耗加入工具结果 JSON 对象（"resources" 字段）并记入 ResourceLedger。
+ * @param result 执行器返回的结果；不是 JSON 对象时原样返回。
+ * @param key ResourceLedger 中的会话名。
+ */
+std::string attach_resources(const std::string& result, const std::string& key, const ResourceUsage& usage);
+
+#ifndef _WIN32
+/**
+ * @brief 用 wait4()/getrusage() 的结果填写 CPU 时间和最大常驻内存。
+ */
+void fill_from_rusage(ResourceUsage& usage, const struct rusage& rusage);
+
+/**
+ * @brief 把 CPU 时间和地址空间限制施加到一个还没有开始执行用户代码的进程上（Linux 的 prlimit）。
+ * @param in_cgroup 进程已经在 CgroupLeaf 中：内存由 memory.max 限制，不再设置 RLIMIT_AS。
+ * @return 在其他系统上，或限制无法设置时返回 false。
+ */
+bool apply_rlimits(int pid, const ResourceLimits& limits, bool in_cgroup);
+
+/**
+ * @class CgroupLeaf
+ * @brief limits.cgroup_root 下的一个叶子 cgroup v2：施加 memory.max/pids.max，并读取其中所有进程的消耗。
+ *
+ * 析构时删除目录；仍有进程（例如留在后台的进程）时留到之后再删。
+ */
+class CgroupLeaf {
+public:
+    /**
+     * @brief 创建叶子 cgroup 并写入限制。
+     * @return 没有配置 cgroup_root、不是 Linux 或无法创建时返回空指针。
+     */
+    static std::unique_ptr<CgroupLeaf> create(const ResourceLimits& limits);
+
+    ~CgroupLeaf();
+
+    CgroupLeaf(const CgroupLeaf&) = delete;
+    CgroupLeaf& operator=(const CgroupLeaf&) = delete;
+
+    /**
+     * @brief 把进程移入这个 cgroup；应在它启动子进程之前调用。
+     */
+    bool add(int pid) const;
+
+    /**
+     * @brief 用 cpu.stat、memory.peak、pids.peak 和 *.events 更新 usage 中对应的字段。
+     *
+     * CPU 时间和超出的限制只计算上一次调用以来的部分（同一个叶子可以被一个会话的多条命令共用）；
+     * 内存和进程数是整个叶子生命期内的峰值。
+     */
+    void read_usage(ResourceUsage& usage);
+
+private:
+    explicit CgroupLeaf(std::string path) : path(std::move(path)) {}
+
+    std::string path;
+    long long user_usec = 0;   // 上一次 read_usage() 时的累计值
+    long long system_usec = 0;
+    long long oom_kills = 0;
+    long long pids_max_events = 0;
+};
+#endif
+
+#endif // RESOURCE_USAGE_H
@@ -0,0 +1,40 @@
+#ifndef SPAWN_UTILS_H
+#define SPAWN_UTILS_H
+
+// 启动子进程（bash 会话、一次性脚本、Python 工作进程）时共用的描述符工具，仅用于 POSIX 系统
+#ifndef _WIN32
+
+#include <chrono>
+#include <sys/socket.h>
+
+// 超时后先 SIGTERM，过这么久仍有进程存活就 SIGKILL
+constexpr auto kKillGrace = std::chrono::seconds(2);
+
+// 向子进程的套接字写入时对方可能已经退出：send() 用这些标志，不产生 SIGPIPE
+#ifdef MSG_NOSIGNAL
+constexpr int kSendFlags = MSG_NOSIGNAL;
+#else
+constexpr int kSendFlags = 0; // macOS: 用 SO_NOSIGPIPE 代替（见 disable_sigpipe）
+#endif
+
+/**
+ * @brief 设置 FD_CLOEXEC，同时启动的其他子进程不会继承这个描述符。
+ */
+void set_cloexec(int fd);
+
+/**
+ * @brief 在没有 MSG_NOSIGNAL 的系统上（macOS）为套接字设置 SO_NOSIGPIPE；其他系统上什么也不做。
+ */
+void disable_sigpipe(int fd);
+
+/**
+ * @brief 把描述符移到 slot 之上（关闭原来的，新的带 FD_CLOEXEC），已经在 slot 之上时原样返回。
+ *
+ * 子进程一端要在 spawn 时 dup2 到 0..slot 中的固定编号；dup2 到同一个编号时 FD_CLOEXEC 不会被清除。
+ * @return 新的描述符；失败时为 -1。
+ */
+int move_fd_above(int fd, int slot);
+
+#endif // _WIN32
+
+#endif // SPAWN_UTILS_H
@@ -0,0 +1,84 @@
+#ifndef SSE_PARSER_H
+#define SSE_PARSER_H
+
+#include <string>
+#include <string_view>
+#include <cstddef>
+
+/**
+ * @brief 一个完整的 Server-Sent-Events 事件。
+ *
+ * 所有字段都是指向 SseParser 内部缓冲区的视图，只在下一次调用
+ * SseParser::feed() 或 SseParser::next_event() 之前有效。
+ */
+struct SseEvent {
+    std::string_view event; // 事件类型，未指定时为 "message"
+    std::string_view data;  // 事件数据，多行 data 字段以 '\n' 连接
+    std::string_view id;    // 最近一次收到的事件ID（按规范在事件之间保持）
+};
+
+/**
+ * @class SseParser
+ * @brief 增量式 Server-Sent-Events 解析器。
+ *
+ * 网络数据通过 feed() 追加到一个可复用的缓冲区中，解析器只维护读游标，
+ * 不会为每一行创建新的字符串。已消费的数据按摊还方式一次性压缩，
+ * 因此每个分块的处理成本只与分块本身的大小成正比。
+ *
+ * 支持 LF 与 CRLF 行结束符、注释行、多行 data 字段以及 event/id/retry 字段。
+ */
+class SseParser {
+public:
+    /**
+     * @brief 追加一段从网络收到的原始数据。
+     * @param chunk 任意长度的数据分块，可以在行或事件的中间断开。
+     */
+    void feed(std::string_view chunk);
+
+    /**
+     * @brief 取出下一个已完整接收（以空行结束）的事件。
+     * @param event 输出参数，成功时被填充。
+     * @return 如果取出了事件返回 true；如果需要更多数据返回 false。
+     */
+    bool next_event(SseEvent& event);
+
+    /**
+     * @brief 在流结束时取出尚未以空行结束的最后一个事件（如果有）。
+     * @param event 输出参数，成功时被填充。
+     * @return 如果存在未分派的 data 字段返回 true。
+     */
+    bool finish(SseEvent& event);
+
+    /**
+     * @brief 清空所有状态，保留已分配的缓冲区容量以便复用。
+     */
+    void reset();
+
+    /**
+     * @brief 服务器通过 retry 字段建议的重连间隔（毫秒），未收到时为 -1。
+     */
+    long retry_ms() const { return retry; }
+
+private:
+    std::string buffer;
+    size_t read_pos = 0;    // 下一行的起始位置
+    size_t event_start = 0; // 当前未完成事件的起点，压缩缓冲区时不能越过它
+
+    // 当前事件的字段，以缓冲区偏移量保存，这样追加数据导致重新分配时仍然有效
+    size_t data_begin = 0;
+    size_t data_end = 0;
+    size_t data_lines = 0;
+    std::string joined_data; // 仅在出现多行 data 时使用
+    size_t type_begin = 0;
+    size_t type_end = 0;
+    bool has_type = false;
+
+    std::string last_event_id;
+    long retry = -1;
+
+    void process_line(size_t begin, size_t end);
+    void dispatch(SseEvent& event);
+    void clear_event_fields();
+};
+
+#endif // SSE_PARSER_H
@@ -0,0 +1,130 @@
+#ifndef TERMINAL_RENDERER_H
+#define TERMINAL_RENDERER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+/**
+ * @class TerminalRenderer
+ * @brief 在独立线程上把流式输出写到终端。
+ *
+ * 生产者（curl 的写回调）只把文本事件放进一个无锁的单生产者/单消费者环形队列，
+ * 不会因为终端或 SSH 会话写得慢而阻塞网络读取（除非队列被写满）。
+ * 渲染线程按帧合并输出：每帧最多一次 fwrite + fflush，帧间隔由 flush_interval 控制。
+ *
+ * Markdown 代码块（```）的识别和着色由一个不分配内存的逐字节状态机完成：
+ * 围栏和语言行不输出，代码块内容显示为黄色；跨片段的半个围栏会被暂存到下一个片段。
+ *
+ * 生产者接口必须只在同一个线程上调用。
+ */
+class TerminalRenderer {
+public:
+    /**
+     * @brief 构造函数。启动渲染线程。
+     * @param flush_interval 两次写终端之间的最小间隔；0 表示有数据就立即写。
+     */
+    explicit TerminalRenderer(std::chrono::milliseconds flush_interval = std::chrono::milliseconds(16));
+
+    /**
+     * @brief 析构函数。写出剩余内容并停止渲染线程。
+     */
+    ~TerminalRenderer();
+
+    TerminalRenderer(const TerminalRenderer&) = delete;
+    TerminalRenderer& operator=(const TerminalRenderer&) = delete;
+
+    /**
+     * @brief 开始一次新的流式输出。先刷新 std::cout，保证之前的输出排在前面。
+     */
+    void begin_stream();
+
+    /**
+     * @brief 助手回复的文本，经过 Markdown 代码块状态机渲染。
+     */
+    void markdown(std::string_view text);
+
+    /**
+     * @brief 原样输出的文本（标题、工具代码、错误信息等）。
+     */
+    void plain(std::string_view text);
+
+    /**
+     * @brief 开始工具代码：切换到工具代码颜色并换行。
+     */
+    void tool_code_begin();
+
+    /**
+     * @brief 结束工具代码：恢复默认颜色。
+     */
+    void tool_code_end();
+
+    /**
+     * @brief 结束本次流式输出：输出暂存的半个围栏、关闭未闭合的代码块颜色，
+     *        并阻塞直到所有内容都已写到终端。之后可以安全地使用 std::cout。
+     */
+    void end_stream();
+
+    /**
+     * @brief 阻塞直到目前为止提交的内容都已写到终端。
+     */
+    void flush();
+
+private:
+    enum class EventKind : uint8_t { Markdown, Plain, ToolCodeBegin, ToolCodeEnd, EndStream, Barrier };
+
+    static constexpr size_t kSlotBytes = 240;
+    static constexpr size_t kSlotCount = 1024; // 必须是2的幂
+    static constexpr size_t kFrameBytes = 64 * 1024;
+
+    struct Slot {
+        EventKind kind;
+        uint16_t length;
+        char data[kSlotBytes];
+    };
+
+    // 单生产者/单消费者环形队列：head 只由渲染线程写，tail 只由生产者写
+    std::unique_ptr<Slot[]> slots;
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+
+    // 渲染线程空闲时在条件变量上等待；生产者只在它睡眠时才去加锁唤醒
+    std::mutex wake_mutex;
+    std::condition_variable wake_cv;
+    std::atomic<bool> sleeping{false};
+    std::atomic<bool> stopping{false};
+    std::atomic<bool> barrier_pending{false};
+
+    // flush() 的完成通知
+    std::mutex barrier_mutex;
+    std::condition_variable barrier_cv;
+    uint64_t barriers_requested = 0;  // 只由生产者访问
+    uint64_t barriers_completed = 0;  // 受 barrier_mutex 保护
+
+    std::chrono::milliseconds flush_interval;
+    std::thread render_thread;
+
+    // 以下状态只由渲染线程访问
+    enum class FenceState : uint8_t { Text, Language, Code };
+    FenceState fence_state = FenceState::Text;
+    int pending_backticks = 0;
+    std::string frame; // 预留 kFrameBytes，稳定状态下不再分配
+    std::chrono::steady_clock::time_point last_write;
+
+    void push(EventKind kind, std::string_view text = std::string_view());
+    void wake();
+    void render_loop();
+    bool drain(); // 处理队列中的所有事件；遇到屏障时返回 true
+    void render_markdown(const char* data, size_t length);
+    void finish_markdown();
+    void append(const char* data, size_t length);
+    void write_frame();
+};
+
+#endif // TERMINAL_RENDERER_H
@@ -0,0 +1,47 @@
+#ifndef TOKENIZER_H
+#define TOKENIZER_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @class Tokenizer
+ * @brief 本地的字节级 BPE 分词器，只用于统计 token 数量。
+ *
+ * 词表文件使用 tiktoken 格式（每行 "<base64编码的token> <rank>"，例如 cl100k_base.tiktoken）。
+ * 预分词是对 cl100k 正则的手写近似，对预算控制来说已经足够准确。
+ * 没有加载词表时退化为按字节数估算（约 4 字节一个 token）。
+ */
+class Tokenizer {
+public:
+    /**
+     * @brief 加载 tiktoken 格式的词表文件。
+     * @param path 词表文件路径。
+     * @throw std::runtime_error 如果文件无法打开或格式错误。
+     */
+    void load(const std::string& path);
+
+    /**
+     * @brief 是否已经加载了词表。
+     */
+    bool loaded() const { return !ranks.empty(); }
+
+    /**
+     * @brief 统计文本的 token 数量。
+     * @param text UTF-8 文本。
+     * @return token 数量。
+     */
+    size_t count(std::string_view text) const;
+
+private:
+    std::string vocab_storage; // 所有 token 字节的连续存储，ranks 的键指向这里
+    std::unordered_map<std::string_view, uint32_t> ranks;
+    mutable std::unordered_map<std::string, uint32_t> piece_cache;
+
+    size_t count_piece(std::string_view piece) const;
+};
+
+#endif // TOKENIZER_H
@@ -0,0 +1,93 @@
+#ifndef TOOL_ARGS_DECODER_H
+#define TOOL_ARGS_DECODER_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/**
+ * @class ToolArgsDecoder
+ * @brief 可恢复的工具调用参数解码器。
+ *
+ * 模型以任意切分的片段流式输出工具调用的 arguments（一个JSON对象的文本）。
+ * 这个类在片段之间保存词法状态，只扫描新到达的字节：
+ * - 原始参数文本累积在一个持续增长的缓冲区中；
+ * - 顶层对象中指定字段（默认 "code"）的字符串值被增量反转义，
+ *   包括跨片段断开的 \\uXXXX 序列和 UTF-16 代理对；
+ * - 顶层对象闭合时可以立即得知参数已经完整。
+ */
+class ToolArgsDecoder {
+public:
+    /**
+     * @brief 构造函数。
+     * @param field 需要增量解码的顶层字符串字段名。
+     */
+    explicit ToolArgsDecoder(std::string field = "code");
+
+    /**
+     * @brief 追加一个参数片段。
+     * @param fragment 从流中收到的 arguments 片段。
+     * @return 本次新解码出的字段内容；视图在下一次调用 feed() 之前有效。
+     */
+    std::string_view feed(std::string_view fragment);
+
+    /**
+     * @brief 是否已经进入目标字段的字符串值。
+     */
+    bool in_field() const { return field_started; }
+
+    /**
+     * @brief 目标字段的结束引号是否已经出现。
+     */
+    bool field_complete() const { return field_finished; }
+
+    /**
+     * @brief 顶层JSON对象是否已经闭合。
+     */
+    bool complete() const { return object_closed; }
+
+    /**
+     * @brief 目前为止解码出的目标字段内容。
+     */
+    const std::string& value() const { return decoded; }
+
+    /**
+     * @brief 目前为止收到的完整原始参数文本。
+     */
+    const std::string& raw() const { return arguments; }
+
+    /**
+     * @brief 清空状态，保留缓冲区容量。
+     */
+    void reset();
+
+private:
+    enum class StringTarget { None, Key, Field, Skip };
+    enum class Escape { None, Backslash, Unicode, HighSurrogate, HighSurrogateBackslash };
+
+    std::string field_name;
+    std::string arguments;
+    std::string decoded;
+    std::string key;
+
+    int depth = 0;
+    bool in_string = false;
+    bool expect_key = false;
+    bool key_matches = false;
+    bool field_started = false;
+    bool field_finished = false;
+    bool object_closed = false;
+
+    StringTarget target = StringTarget::None;
+    Escape escape = Escape::None;
+    uint32_t code_unit = 0;
+    uint32_t high_surrogate = 0;
+    int hex_digits = 0;
+
+    void consume_string_byte(char c);
+    void finish_code_unit();
+    void append_output(char c);
+    void append_code_point(uint32_t code_point);
+};
+
+#endif // TOOL_ARGS_DECODER_H
@@ -0,0 +1,67 @@
+#ifndef TOOL_SCHEDULER_H
+#define TOOL_SCHEDULER_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @class ToolScheduler
+ * @brief 在固定大小的线程池上并发执行工具调用。
+ *
+ * 每个任务可以指定一个串行通道（lane）：同一通道内的任务按提交顺序逐个执行，
+ * 不同通道以及没有通道的任务之间并发执行，总并发数不超过 max_parallel。
+ * 例如所有 python 调用共享同一个解释器，因此放在同一个通道里；shell 调用互不依赖，可以并行。
+ */
+class ToolScheduler {
+public:
+    /**
+     * @brief 构造函数。
+     * @param max_parallel 最大并发任务数，小于 1 时按 1 处理。
+     */
+    explicit ToolScheduler(size_t max_parallel);
+
+    /**
+     * @brief 析构函数。等待所有已提交的任务完成后再退出工作线程。
+     */
+    ~ToolScheduler();
+
+    ToolScheduler(const ToolScheduler&) = delete;
+    ToolScheduler& operator=(const ToolScheduler&) = delete;
+
+    /**
+     * @brief 提交一个任务。
+     * @param task 要执行的任务，返回工具结果字符串。
+     * @param lane 串行通道名；为空表示可以与其他任务并行。
+     * @return 任务结果的 future；任务抛出的异常会在 get() 时重新抛出。
+     */
+    std::future<std::string> submit(std::function<std::string()> task, const std::string& lane = "");
+
+    /**
+     * @brief 最大并发任务数。
+     */
+    size_t max_parallel() const { return workers.size(); }
+
+private:
+    struct Job {
+        std::packaged_task<std::string()> task;
+        std::string lane;
+    };
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<Job> ready;                                  // 可以立即执行的任务
+    std::unordered_map<std::string, std::deque<Job>> lanes; // 正在忙碌的通道及其排队的任务
+    bool stopping = false;
+
+    void worker_loop();
+};
+
+#endif // TOOL_SCHEDULER_H
@@ -0,0 +1,76 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+/**
+ * @class Trace
+ * @brief 记录程序各阶段的时间线，退出时写成 Chrome / Perfetto 的 trace-event JSON（--trace out.json）。
+ *
+ * 每个线程把事件追加到自己的缓冲区（按块分配、只有本线程写入），记录时不加锁，
+ * 也不会与其他线程竞争；只有线程第一次记录时需要加锁登记缓冲区。
+ * 没有开启时 TraceSpan 只读取一次原子变量。
+ */
+class Trace {
+public:
+    /**
+     * @brief 开始记录；finish() 时写入 path。
+     * @return 文件无法创建时返回 false，不开始记录。
+     */
+    static bool start(const std::string& path);
+
+    /**
+     * @brief 停止记录并写出文件；没有开始记录或已经写出时什么也不做。
+     */
+    static void finish();
+
+    static bool enabled() { return active.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 设置当前线程在时间线中显示的名字；没有开启时什么也不做。
+     * @param name 必须是静态存储期的字符串（字符串字面量）。
+     */
+    static void set_thread_name(const char* name);
+
+    /**
+     * @brief 当前时间（纳秒），供 TraceSpan 使用；永远不为 0。
+     */
+    static uint64_t now();
+
+    /**
+     * @brief 追加一个完整的区间事件到当前线程的缓冲区。
+     * @param name 和 category 必须是字符串字面量：只保存指针。
+     */
+    static void record(const char* name, const char* category, uint64_t begin, uint64_t end);
+
+private:
+    static std::atomic<bool> active;
+};
+
+/**
+ * @class TraceSpan
+ * @brief 作用域内的一个区间：构造时开始，析构时记录。构造时没有开启记录则什么也不做。
+ */
+class TraceSpan {
+public:
+    TraceSpan(const char* name, const char* category)
+        : name(name), category(category), begin(Trace::enabled() ? Trace::now() : 0) {}
+
+    ~TraceSpan() {
+        if (begin != 0) {
+            Trace::record(name, category, begin, Trace::now());
+        }
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* name;
+    const char* category;
+    uint64_t begin;
+};
+
+#endif // TRACE_H
@@ -36,16 +36,25 @@ OperatingSystem detect_operating_system();
 std::string os_to_string(OperatingSystem os);
 
 /**
- * @brief Check if PowerShell is available on the current system
- * @return true if PowerShell is available, false otherwise
+ * @brief Get the text appended to the system prompt to tell the model which OS it runs on
+ * @param os The operating system enum value
+ * @return The suffix, starting with a blank line
+ */
+std::string os_prompt_suffix(OperatingSystem os);
+
+/**
+ * @brief 本程序的缓存目录：$XDG_CACHE_HOME/code-atlas、~/.cache/code-atlas 或 %LOCALAPPDATA%\code-atlas。
+ * @return 目录路径（不保证已存在）；无法确定时返回空字符串。
  */
-bool is_powershell_available();
+std::string cache_directory();
 
 /**
- * @brief Get the list of supported shell types for the current OS
- * @return Vector of supported shell names
+ * @brief 先写临时文件再改名，其他进程不会读到写了一半的文件。会创建缺少的上级目录。
+ * @param path 目标文件。
+ * @param content 文件内容。
+ * @return 是否写入成功。
  */
-std::vector<std::string> get_supported_shells();
+bool write_file_atomically(const std::string& path, const std::string& content);
 
 /**
  * @brief 安全地处理包含转义字符的缓冲区，防止截断不完整的转义序列。
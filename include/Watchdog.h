@@ -0,0 +1,72 @@
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+
+/**
+ * @class Watchdog
+ * @brief 在截止时间到达时调用回调，用于给工具调用设置时限。
+ *
+ * 所有截止时间由同一个后台线程等待（第一次 arm() 时启动）；回调在该线程上、不持有内部锁时调用，
+ * 因此回调里可以再次 arm()，但应当很快返回（发送信号、结束进程之类）。
+ */
+class Watchdog {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @brief 进程内唯一的实例。
+     */
+    static Watchdog& instance();
+
+    Watchdog(const Watchdog&) = delete;
+    Watchdog& operator=(const Watchdog&) = delete;
+
+    /**
+     * @brief 设置一个截止时间。
+     * @param delay 从现在起多久之后调用回调。
+     * @param on_expire 回调。
+     * @param repeat 大于零时，回调之后每隔这么久再调用一次，直到 disarm()。
+     * @return 用于 disarm() 的编号。
+     */
+    uint64_t arm(Clock::duration delay, std::function<void()> on_expire, Clock::duration repeat = Clock::duration::zero());
+
+    /**
+     * @brief 取消一个截止时间。回调正在执行时等待它结束；返回后回调不会再被调用。
+     * @note 不能在该截止时间自己的回调里调用。
+     */
+    void disarm(uint64_t id);
+
+    /**
+     * @brief 让所有截止时间立即到期（退出前用来结束仍在运行的工具调用）；重复的截止时间之后照常重复。
+     */
+    void expire_all();
+
+private:
+    Watchdog() = default;
+    ~Watchdog();
+
+    struct Entry {
+        Clock::time_point when;
+        Clock::duration repeat;
+        std::function<void()> on_expire;
+    };
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::map<uint64_t, Entry> entries;
+    uint64_t next_id = 1;
+    uint64_t running_id = 0;   // 正在执行回调的截止时间，0 表示没有
+    bool stopping = false;
+    std::thread thread;
+
+    void run();
+};
+
+#endif // WATCHDOG_H
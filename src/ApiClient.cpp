@@ -1,15 +1,33 @@
 #include "ApiClient.h"
+#include "SseParser.h"
+#include "ChunkDecoder.h"
+#include "ToolArgsDecoder.h"
+#include "CapabilityRegistry.h"
 #include "Utils.h"
+#include "Trace.h"
 #include <cpr/cpr.h>
 #include <iostream>
 #include <map>
+#include <set>
 #include <algorithm>
+#include <chrono>
 #include <curl/curl.h>
 #include <stdexcept>
 #include <vector>
 #include "nlohmann/json.hpp"
 #include "Color.h"
 
+namespace {
+    // curl 在连接和传输期间反复调用进度回调，返回 false 时中止请求
+    cpr::ProgressCallback abort_when(std::function<bool()> should_abort) {
+        return cpr::ProgressCallback{[should_abort = std::move(should_abort)](cpr::cpr_pf_arg_t, cpr::cpr_pf_arg_t,
+                                                                             cpr::cpr_pf_arg_t, cpr::cpr_pf_arg_t,
+                                                                             intptr_t) {
+            return !should_abort();
+        }};
+    }
+}
+
 ApiClient::ApiClient(const nlohmann::json& config) {
     // 从配置中获取URL
     if (config.contains("api") && config["api"].contains("base_url")) {
@@ -31,7 +49,7 @@ ApiClient::ApiClient(const nlohmann::json& config) {
     if (config.contains("tools") && !config["tools"].empty()) {
         // Filter tools based on current operating system
         nlohmann::json filtered_tools = nlohmann::json::array();
-        auto supported_shells = get_supported_shells();
+        auto supported_shells = CapabilityRegistry::instance().supported_shells();
 
         for (const auto& tool : config["tools"]) {
             if (tool.contains("function") && tool["function"].contains("name")) {
@@ -61,256 +79,404 @@ ApiClient::ApiClient(const nlohmann::json& config) {
             }
         }
     }
+
+    // 配置持久会话：所有请求共享同一个curl句柄，从而复用保持活动的连接
+    session.SetUrl(cpr::Url{url});
+    session.SetHeader(headers);
+    session.SetConnectTimeout(cpr::ConnectTimeout{10000});
+
+    // 本机后端可以通过Unix域套接字访问，绕过回环TCP协议栈；URL仍用于Host头和请求路径
+    if (config.contains("api") && config["api"].contains("unix_socket") &&
+        config["api"]["unix_socket"].is_string() && !config["api"]["unix_socket"].get<std::string>().empty()) {
+        unix_socket = config["api"]["unix_socket"].get<std::string>();
+        session.SetUnixSocket(cpr::UnixSocket{unix_socket});
+    }
+
+    bool use_http2 = unix_socket.empty();
+    if (config.contains("api") && config["api"].contains("http2")) {
+        use_http2 = use_http2 && config["api"]["http2"].get<bool>();
+    }
+    if (use_http2) {
+        // 对 https 端点通过ALPN协商HTTP/2，明文端点保持HTTP/1.1
+        session.SetHttpVersion(cpr::HttpVersion{cpr::HttpVersionCode::VERSION_2_0_TLS});
+    }
+    curl_easy_setopt(session.GetCurlHolder()->handle, CURLOPT_TCP_KEEPALIVE, 1L);
+
+    // 预先序列化请求体中不随对话变化的部分：去掉结尾的 '}' 后接上 messages 数组
+    payload_prefix = base_payload.dump();
+    payload_prefix.pop_back();
+    payload_prefix += ",\"messages\":[";
+
+    if (config.contains("api") && config["api"].contains("preconnect")) {
+        preconnect_enabled = config["api"]["preconnect"].get<bool>();
+    }
+    if (config.contains("api") && config["api"].contains("preconnect_interval_ms")) {
+        preconnect_interval = std::chrono::milliseconds(config["api"]["preconnect_interval_ms"].get<long>());
+    }
+    last_activity = std::chrono::steady_clock::now() - preconnect_interval;
+
+    long render_flush_ms = 16;
+    if (config.contains("ui") && config["ui"].contains("render_flush_ms")) {
+        render_flush_ms = config["ui"]["render_flush_ms"].get<long>();
+    }
+    renderer = std::make_unique<TerminalRenderer>(std::chrono::milliseconds(render_flush_ms));
 }
 
-ApiResponse ApiClient::send_message(const nlohmann::json& messages) {
-    nlohmann::json payload = base_payload;
-    nlohmann::json modified_messages = messages;
-    
-    // 检查是否有系统消息，如果有，根据操作系统添加特定文本
-    if (!modified_messages.empty() && modified_messages[0].contains("role") && 
-        modified_messages[0]["role"] == "system" && modified_messages[0].contains("content")) {
-        
-        OperatingSystem current_os = detect_operating_system();
-        std::string os_info;
-        
-        switch (current_os) {
-            case OperatingSystem::Windows:
-                os_info = "\n\n**You are currently working on Windows.**";
-                break;
-            case OperatingSystem::Linux:
-                os_info = "\n\n**You are currently working on Linux.**";
-                break;
-            case OperatingSystem::MacOS:
-                os_info = "\n\n**You are currently working on macOS.**";
-                break;
-            default:
-                os_info = "\n\n**You are currently working on an unknown operating system.**";
-                break;
+ApiClient::~ApiClient() {
+    stop_preconnect();
+}
+
+void ApiClient::start_preconnect() {
+    if (!preconnect_enabled) {
+        return;
+    }
+    stop_preconnect();
+    preconnect_stop = false;
+
+    // 每次回到提示符最多预热一次：连接空闲达到 preconnect_interval 时发送一个 HEAD，之后不再重复
+    const auto warm_at = last_activity + preconnect_interval;
+    preconnect_thread = std::thread([this, warm_at]() {
+        Trace::set_thread_name("preconnect");
+        {
+            std::unique_lock<std::mutex> lock(preconnect_mutex);
+            if (preconnect_cv.wait_until(lock, warm_at, [this]() { return preconnect_stop.load(); })) {
+                return;
+            }
         }
-        
-        // 在系统提示词末尾添加操作系统信息
-        modified_messages[0]["content"] = modified_messages[0]["content"].get<std::string>() + os_info;
+        warm_connection();
+    });
+}
+
+void ApiClient::stop_preconnect() {
+    {
+        std::lock_guard<std::mutex> lock(preconnect_mutex);
+        preconnect_stop = true;
     }
-    
-    payload["messages"] = modified_messages;
+    // 正在进行的 HEAD 会在下一次进度回调时中止，不必等它超时
+    preconnect_cv.notify_all();
+    if (preconnect_thread.joinable()) {
+        preconnect_thread.join();
+    }
+}
+
+void ApiClient::warm_connection() {
+    TraceSpan span("api.preconnect", "network");
+    std::lock_guard<std::mutex> lock(session_mutex);
+    // HEAD 只用来建立连接，不需要携带 API 密钥
+    cpr::Header warm_headers = headers;
+    warm_headers.erase("Authorization");
+    session.SetHeader(warm_headers);
+    // HEAD 请求没有响应体，但仍然替换掉上一次请求留下的写回调
+    session.SetWriteCallback(cpr::WriteCallback{[](const std::string_view&, intptr_t) { return true; }});
+    session.SetProgressCallback(abort_when([this]() { return preconnect_stop.load(); }));
+    session.SetTimeout(cpr::Timeout{3000});
+    cpr::Response response = session.Head();
+    session.SetHeader(headers);
+    if (response.status_code != 0) {
+        last_activity = std::chrono::steady_clock::now();
+    }
+}
+
+RequestTimings ApiClient::collect_timings() {
+    RequestTimings timings;
+    CURL* handle = session.GetCurlHolder()->handle;
+    curl_off_t value = 0;
+
+    if (curl_easy_getinfo(handle, CURLINFO_CONNECT_TIME_T, &value) == CURLE_OK) {
+        timings.connect_ms = value / 1000.0;
+    }
+    if (curl_easy_getinfo(handle, CURLINFO_APPCONNECT_TIME_T, &value) == CURLE_OK) {
+        timings.tls_ms = value / 1000.0;
+    }
+    if (curl_easy_getinfo(handle, CURLINFO_STARTTRANSFER_TIME_T, &value) == CURLE_OK) {
+        timings.ttfb_ms = value / 1000.0;
+    }
+    if (curl_easy_getinfo(handle, CURLINFO_TOTAL_TIME_T, &value) == CURLE_OK) {
+        timings.total_ms = value / 1000.0;
+    }
+    long num_connects = 0;
+    if (curl_easy_getinfo(handle, CURLINFO_NUM_CONNECTS, &num_connects) == CURLE_OK) {
+        timings.reused_connection = (num_connects == 0);
+    }
+    curl_easy_getinfo(handle, CURLINFO_HTTP_VERSION, &timings.http_version);
+    return timings;
+}
+
+namespace {
+    // 因致命语法错误中止流之后构造响应：保留之前已经完整的调用，
+    // 被中止的调用带上部分代码作为参数，并直接给出错误结果，不再执行
+    ApiResponse syntax_abort_response(std::map<int, ToolCall>& tool_calls_data,
+                                      const std::map<int, ToolArgsDecoder>& tool_calls_arguments,
+                                      int aborted_call, const SyntaxCheckResult& error,
+                                      const std::string& content, PythonSyntaxChecker& checker) {
+        const std::string& partial_code = tool_calls_arguments.at(aborted_call).value();
+        checker.record_abort(partial_code.size());
+        SyntaxCheckStats stats = checker.stats();
+
+        std::cout << Color::RESET << Color::RED << "\n\n[Syntax Check] Stopped generation early: SyntaxError at line "
+                  << error.line << ": " << error.message << " (" << stats.aborted_streams << " aborted so far, ~"
+                  << stats.tokens_saved << " tokens saved)" << Color::RESET << std::endl;
+
+        ApiResponse response;
+        response.type = ApiResponse::Type::TOOL_CALL;
+        response.content = content;
+        for (auto& [idx, call] : tool_calls_data) {
+            const auto& decoder = tool_calls_arguments.at(idx);
+            if (idx == aborted_call) {
+                if (call.id.empty()) {
+                    call.id = "call_aborted_" + std::to_string(idx);
+                }
+                call.function["arguments"] = nlohmann::json{{"code", partial_code}}.dump(
+                    -1, ' ', false, nlohmann::json::error_handler_t::replace);
+
+                nlohmann::json result;
+                result["status"] = "error";
+                result["output"] = "SyntaxError: " + error.message + " (line " + std::to_string(error.line) + ")\n    " +
+                                   error.text + "\nGeneration was stopped early because this code cannot compile. "
+                                   "Send the complete, corrected code in a new tool call.";
+                response.tool_results[call.id] = result.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+                response.tool_calls.push_back(call);
+                break; // 之后的调用还没有生成
+            }
+            if (decoder.complete()) {
+                call.function["arguments"] = decoder.raw();
+                response.tool_calls.push_back(call);
+            }
+        }
+        return response;
+    }
+}
+
+ApiResponse ApiClient::send_message(const ConversationHistory& messages,
+                                    const ToolCallReadyCallback& on_tool_call_ready) {
+    stop_preconnect();
+
+    // 请求体由缓存的前缀和已序列化的历史拼接而成，不再复制和重新序列化整个对话
+    auto serialize_start = std::chrono::steady_clock::now();
+    std::string request_body;
+    {
+        TraceSpan span("api.serialize", "network");
+        request_body = messages.request_body(payload_prefix);
+    }
+    double serialize_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - serialize_start).count();
+    size_t request_bytes = request_body.size();
 
     // --- 流式处理的状态变量 ---
-    std::string line_buffer;
+    SseParser sse_parser;
+    ChunkDecoder chunk_decoder;
+    DecodedChunk chunk; // 在数据块之间复用，保留字符串容量
     std::string assistant_response_content;
     std::string finish_reason;
     bool has_tools = base_payload.contains("tools");
 
     // 用于累积完整工具调用数据的状态
     std::map<int, ToolCall> tool_calls_data;
-    // 用于实时打印工具代码的状态
-    struct PrintingState {
-        std::string code_buffer;
-        std::string last_printed_code;
-        std::string language; // For markdown code blocks
-        bool in_code_block = false;
-        bool found_final_brace = false;
-    };
-    std::map<int, PrintingState> tool_calls_printing_state;
-    PrintingState printing_state;
-    std::string saved_buffer;
+    // 用于实时打印工具代码的状态：参数原文累积在解码器中，代码字段被增量解码
+    std::map<int, ToolArgsDecoder> tool_calls_arguments;
+    // 已经通过 on_tool_call_ready 交出去的工具调用
+    std::set<int> dispatched_tool_calls;
+    // 增量语法检查：正在检查的 python 调用，以及因致命语法错误被中止的调用
+    int checked_call = -1;
+    int aborted_call = -1;
+    SyntaxCheckResult syntax_error;
     bool is_first_chunk = true;
+    // 吞吐量统计：第一段文本到达的时间、带有文本或工具参数的增量个数、响应体大小
+    std::chrono::steady_clock::time_point request_start;
+    std::chrono::steady_clock::time_point first_token;
+    size_t output_tokens = 0;
+    size_t response_bytes = 0;
     
     ApiResponse final_response;
 
-    auto write_callback = [&](const std::string_view& data, intptr_t userdata) -> bool {
-        line_buffer.append(data);
-        size_t pos;
-        while ((pos = line_buffer.find('\n')) != std::string::npos) {
-            std::string line = line_buffer.substr(0, pos);
-            line_buffer.erase(0, pos + 1);
-
-            if (line.rfind("data: ", 0) != 0) {
-                continue;
-            }
-            std::string data_str = line.substr(6);
-            if (data_str.find("[DONE]") != std::string::npos) {
-                return true;
-            }
+    // 处理一个完整的 SSE 事件；遇到 [DONE] 时返回 false
+    auto handle_event = [&](const SseEvent& event) -> bool {
+        std::string_view data_str = event.data;
+        if (data_str == "[DONE]") {
+            return false;
+        }
 
-            try {
-                nlohmann::json chunk = nlohmann::json::parse(data_str);
-                auto delta = chunk["choices"][0]["delta"];
+        try {
+            // 一次遍历只提取需要的字段，不构建完整的DOM
+            {
+                TraceSpan decode_span("chunk.decode", "parse");
+                chunk_decoder.decode(data_str, chunk);
+            }
 
-                if (is_first_chunk) {
-                    bool has_content = delta.contains("content") && delta["content"].is_string() && !delta["content"].get<std::string>().empty();
-                    bool has_tools = delta.contains("tool_calls") && !delta["tool_calls"].is_null();
-                    if (has_content || has_tools) {
-                        std::cout << std::endl;
-                        is_first_chunk = false;
-                    }
+            if (is_first_chunk) {
+                bool has_content = chunk.has_content && !chunk.content.empty();
+                if (has_content || chunk.has_tool_calls) {
+                    renderer->plain("\n");
+                    is_first_chunk = false;
+                    first_token = std::chrono::steady_clock::now();
                 }
+            }
+            if (chunk.has_content && !chunk.content.empty()) {
+                output_tokens++;
+            }
 
-                if (delta.contains("content") && !delta["content"].is_null()) {
-                    std::string text_chunk = delta["content"];
-                    assistant_response_content += text_chunk;
-
-                    std::string current_buffer = saved_buffer + text_chunk;
-                    saved_buffer.clear();
-
-                    size_t start_pos = 0;
-                    while(start_pos < current_buffer.length()) {
-                        if (!printing_state.in_code_block) {
-                            size_t block_start = current_buffer.find("```", start_pos);
-                            if (block_start != std::string::npos) {
-                                // Print text before the code block
-                                std::cout << current_buffer.substr(start_pos, block_start - start_pos) << std::flush;
-                                
-                                size_t lang_end = current_buffer.find('\n', block_start + 3);
-                                if (lang_end != std::string::npos) {
-                                    printing_state.language = current_buffer.substr(block_start + 3, lang_end - (block_start + 3));
-                                    std::cout << Color::YELLOW << std::flush; // Start yellow color for code block
-                                    start_pos = lang_end + 1;
-                                    printing_state.in_code_block = true;
-                                } else {
-                                    // Incomplete ``` tag, save for next chunk
-                                    saved_buffer = current_buffer.substr(block_start);
-                                    start_pos = current_buffer.length(); // Exit loop
-                                }
-                            } else {
-                                // No code block start found, print most of it but check for partial ``` at the end.
-                                std::string part_to_process = current_buffer.substr(start_pos);
-                                if (part_to_process.length() >= 2 && part_to_process.substr(part_to_process.length() - 2) == "``") {
-                                    saved_buffer = "``";
-                                    part_to_process = part_to_process.substr(0, part_to_process.length() - 2);
-                                } else if (part_to_process.length() >= 1 && part_to_process.substr(part_to_process.length() - 1) == "`") {
-                                    saved_buffer = "`";
-                                    part_to_process = part_to_process.substr(0, part_to_process.length() - 1);
-                                }
-                                std::cout << part_to_process << std::flush;
-                                start_pos = current_buffer.length();
-                            }
-                        } else { // We are in a code block
-                            size_t block_end = current_buffer.find("```", start_pos);
-                            if (block_end != std::string::npos) {
-                                // Print text inside code block
-                                std::cout << current_buffer.substr(start_pos, block_end - start_pos) << std::flush;
-                                std::cout << Color::RESET << std::flush; // End yellow color, no extra newline
-                                start_pos = block_end + 3;
-                                printing_state.in_code_block = false;
-                                printing_state.language.clear();
-                            } else {
-                                // No end of block, print most of it but check for partial ``` at the end.
-                                std::string part_to_process = current_buffer.substr(start_pos);
-                                if (part_to_process.length() >= 2 && part_to_process.substr(part_to_process.length() - 2) == "``") {
-                                     saved_buffer = "``";
-                                     part_to_process = part_to_process.substr(0, part_to_process.length() - 2);
-                                } else if (part_to_process.length() >= 1 && part_to_process.substr(part_to_process.length() - 1) == "`") {
-                                     saved_buffer = "`";
-                                     part_to_process = part_to_process.substr(0, part_to_process.length() - 1);
-                                }
-                                std::cout << part_to_process << std::flush;
-                                start_pos = current_buffer.length();
-                            }
-                        }
-                    }
-                }
+            if (chunk.has_content) {
+                assistant_response_content += chunk.content;
+
+                // Markdown 围栏的识别和着色在渲染线程上完成
+                renderer->markdown(chunk.content);
+            }
+            
+            if (has_tools && chunk.has_tool_calls) {
+                // 一个数据块中可能包含多个工具调用的增量
+                for (size_t i = 0; i < chunk.tool_call_count; ++i) {
+                    const ToolCallDelta& tool_chunk = chunk.tool_call_slots[i];
+                    int idx = tool_chunk.index;
                 
-                if (has_tools && delta.contains("tool_calls")) {
-                    auto tool_chunk = delta["tool_calls"][0];
-                    int idx = tool_chunk["index"];
-                    
                     if (tool_calls_data.find(idx) == tool_calls_data.end()) {
                          tool_calls_data[idx] = {"", "function", {{"name", ""}, {"arguments", ""}}};
-                         tool_calls_printing_state[idx] = PrintingState{}; // Initialize state
-                         if(tool_chunk.contains("function") && tool_chunk["function"].contains("name")){
-                            std::cout << "\n--- Tool Call: " << tool_chunk["function"]["name"].get<std::string>() << " ---\n" << std::flush;
+                         tool_calls_arguments.emplace(idx, ToolArgsDecoder("code")); // Initialize state
+                         if(tool_chunk.has_name){
+                            renderer->plain("\n--- Tool Call: " + tool_chunk.name + " ---\n");
                          }
                     }
 
-                    if(tool_chunk.contains("id") && !tool_chunk["id"].is_null()){
-                        tool_calls_data[idx].id = tool_chunk["id"];
+                    if(tool_chunk.has_id){
+                        tool_calls_data[idx].id = tool_chunk.id;
+                    }
+                    if(tool_chunk.has_name){
+                         tool_calls_data[idx].function["name"] = tool_chunk.name;
                     }
-                    if(tool_chunk.contains("function")){
-                        auto func_chunk = tool_chunk["function"];
-                        if(func_chunk.contains("name") && !func_chunk["name"].is_null()){
-                             tool_calls_data[idx].function["name"] = func_chunk["name"];
+                    if(tool_chunk.has_arguments){
+                        const std::string& args_chunk = tool_chunk.arguments;
+                        output_tokens++;
+
+                        // 实时打印代码逻辑：只解码并打印本次新到达的部分
+                        auto& decoder = tool_calls_arguments.at(idx);
+                        bool was_in_code = decoder.in_field();
+                        bool was_finished = decoder.field_complete();
+                        std::string_view new_code = decoder.feed(args_chunk);
+
+                        if (!was_in_code && decoder.in_field()) {
+                            renderer->tool_code_begin();
                         }
-                        if(func_chunk.contains("arguments") && !func_chunk["arguments"].is_null()){
-                            std::string args_chunk = func_chunk["arguments"];
-                            tool_calls_data[idx].function["arguments"] = tool_calls_data[idx].function["arguments"].get<std::string>() + args_chunk;
-                            
-                            // 实时打印代码逻辑
-                            auto& state = tool_calls_printing_state[idx];
-                            state.code_buffer += args_chunk;
-
-                            if (!state.in_code_block) {
-                                // A simple heuristic to detect the start of the code within the JSON argument string.
-                                if (state.code_buffer.find("{\"code\":\"") != std::string::npos) {
-                                    state.in_code_block = true;
-                                    std::cout << Color::LIGHT_PINK;
-                                    std::cout << "\n"; // Add an extra newline for tool code
-                                }
-                            }
-                            
-                            if (state.in_code_block && !state.found_final_brace) {
-                                std::string current_code;
-                                
-                                try {
-                                    nlohmann::json parsed_json = nlohmann::json::parse(state.code_buffer);
-                                    if (parsed_json.contains("code") && parsed_json["code"].is_string()) {
-                                        current_code = parsed_json["code"];
-                                        state.found_final_brace = true;
-                                    }
-                                } catch (const nlohmann::json::parse_error& e) {
-                                    // JSON parsing failed, it's likely incomplete. Try parsing with a temporary closing bracket.
-                                    try {
-                                        std::string temp_json_str = state.code_buffer + "\"}";
-                                        nlohmann::json parsed_json = nlohmann::json::parse(temp_json_str);
-                                        if (parsed_json.contains("code") && parsed_json["code"].is_string()) {
-                                            current_code = parsed_json["code"];
-                                        }
-                                    } catch (const nlohmann::json::parse_error& e2) {
-                                        current_code = ""; // Still fails, wait for more data.
-                                    }
+                        renderer->plain(new_code);
+                        if (!was_finished && decoder.field_complete()) {
+                            renderer->tool_code_end();
+                        }
+
+                        // 每出现新的完整行，就把 python 代码交给后台检查；代码字段结束后不再需要
+                        if (syntax_checker && tool_calls_data[idx].function["name"] == "python") {
+                            if (decoder.field_complete()) {
+                                if (checked_call == idx) {
+                                    checked_call = -1;
                                 }
-                                
-                                // Print the newly added part of the code
-                                if (!current_code.empty() && current_code.length() > state.last_printed_code.length()) {
-                                    std::string new_part = current_code.substr(state.last_printed_code.length());
-                                    std::cout << new_part << std::flush;
-                                    state.last_printed_code = current_code;
+                            } else if (decoder.in_field()) {
+                                if (checked_call != idx) {
+                                    syntax_checker->begin();
+                                    checked_call = idx;
                                 }
-                                
-                                if (state.found_final_brace) {
-                                    std::cout << Color::RESET;
+                                if (new_code.find('\n') != std::string_view::npos) {
+                                    syntax_checker->submit(decoder.value());
                                 }
                             }
                         }
                     }
-                }
 
-                if (chunk["choices"][0].contains("finish_reason") && !chunk["choices"][0]["finish_reason"].is_null()){
-                    finish_reason = chunk["choices"][0]["finish_reason"];
+                    // 参数对象已经闭合：不等流结束，立即把这个调用交给调用方执行
+                    const ToolCall& call = tool_calls_data[idx];
+                    if (on_tool_call_ready && !dispatched_tool_calls.count(idx) &&
+                        tool_calls_arguments.at(idx).complete() && !call.id.empty() &&
+                        call.function["name"].is_string() && !call.function["name"].get_ref<const std::string&>().empty()) {
+                        ToolCall ready_call = call;
+                        ready_call.function["arguments"] = tool_calls_arguments.at(idx).raw();
+                        dispatched_tool_calls.insert(idx);
+                        on_tool_call_ready(ready_call);
+                    }
                 }
+            }
+
+            if (chunk.has_finish_reason) {
+                finish_reason = chunk.finish_reason;
+            }
 
-            } catch (nlohmann::json::parse_error& e) {
-                std::cerr << "\n[JSON Parse Error] " << e.what() << std::endl;
-                std::cerr << "Raw data: " << data_str << std::endl;
-                std::cerr << "This may indicate that the API server returned an invalid response format" << std::endl;
-            } catch (const std::exception& e) {
-                std::cerr << "\n[Error processing stream data] " << e.what() << std::endl;
-                std::cerr << "Data: " << data_str << std::endl;
+        } catch (nlohmann::json::parse_error& e) {
+            // 经由渲染线程输出，保证与流式文本的顺序一致
+            renderer->plain("\n[JSON Parse Error] " + std::string(e.what()) + "\nRaw data: " + std::string(data_str) +
+                            "\nThis may indicate that the API server returned an invalid response format\n");
+        } catch (const std::exception& e) {
+            renderer->plain("\n[Error processing stream data] " + std::string(e.what()) +
+                            "\nData: " + std::string(data_str) + "\n");
+        }
+        return true;
+    };
+
+    auto write_callback = [&](const std::string_view& data, intptr_t userdata) -> bool {
+        TraceSpan span("sse.callback", "network");
+        response_bytes += data.size();
+        sse_parser.feed(data);
+        SseEvent event;
+        while (sse_parser.next_event(event)) {
+            if (!handle_event(event)) {
+                return true;
             }
         }
+
+        // 返回 false 让 curl 中止传输，不再为注定无法运行的代码继续生成
+        if (checked_call >= 0 && !dispatched_tool_calls.count(checked_call) &&
+            syntax_checker->fatal_error(syntax_error)) {
+            aborted_call = checked_call;
+            return false;
+        }
         return true;
     };
     
-    cpr::Response response = cpr::Post(cpr::Url{url},
-                                     cpr::Body{payload.dump()},
-                                     headers,
-                                     cpr::Timeout{120000},
-                                     cpr::WriteCallback{write_callback});
+    cpr::Response response;
+    renderer->begin_stream();
+    {
+        std::lock_guard<std::mutex> lock(session_mutex);
+        session.SetBody(cpr::Body{std::move(request_body)});
+        session.SetTimeout(cpr::Timeout{120000});
+        session.SetWriteCallback(cpr::WriteCallback{write_callback});
+        session.SetProgressCallback(abort_when([this]() { return interrupted && interrupted(); }));
+        request_start = std::chrono::steady_clock::now();
+        {
+            TraceSpan span("api.request", "network");
+            response = session.Post();
+        }
+        // 流关闭时最后一个事件可能没有以空行结束（常常正是带 finish_reason 的那个），同样处理掉
+        if (response.status_code != 0 && aborted_call < 0) {
+            SseEvent event;
+            if (sse_parser.finish(event)) {
+                handle_event(event);
+            }
+        }
+        // 先把渲染线程中剩余的内容写完，之后的输出才能直接使用 std::cout
+        renderer->end_stream();
+        last_timings = collect_timings();
+        last_timings.serialize_ms = serialize_ms;
+        last_timings.request_bytes = request_bytes;
+        last_timings.response_bytes = response_bytes;
+        last_timings.output_tokens = output_tokens;
+        if (!is_first_chunk) {
+            last_timings.ttft_ms = std::chrono::duration<double, std::milli>(first_token - request_start).count();
+            last_timings.stream_ms = std::max(0.0, last_timings.total_ms - last_timings.ttft_ms);
+            if (output_tokens > 1 && last_timings.stream_ms > 0) {
+                last_timings.tokens_per_second = (output_tokens - 1) / (last_timings.stream_ms / 1000.0);
+            }
+        }
+        // 回调引用了本函数的局部变量，请求结束后立即替换掉
+        session.SetWriteCallback(cpr::WriteCallback{[](const std::string_view&, intptr_t) { return true; }});
+        last_activity = std::chrono::steady_clock::now();
+    }
+    if (response.status_code != 0) {
+        Metrics::instance().record_request(last_timings);
+    }
+
+    if (aborted_call >= 0) {
+        return syntax_abort_response(tool_calls_data, tool_calls_arguments, aborted_call, syntax_error,
+                                     assistant_response_content, *syntax_checker);
+    }
 
     // 检查网络连接错误
     if (response.status_code == 0) {
         final_response.type = ApiResponse::Type::API_ERROR;
-        final_response.error_message = "[Network Error] Unable to connect to API server: " + url + 
+        final_response.error_message = "[Network Error] Unable to connect to API server: " + url +
+                                     (unix_socket.empty() ? "" : " (via unix socket " + unix_socket + ")") +
                                      "\nError details: " + response.error.message;
         return final_response;
     }
@@ -334,15 +500,11 @@ ApiResponse ApiClient::send_message(const nlohmann::json& messages) {
         return final_response;
     }
     
-    // Ensure color is reset if a markdown code block was left open
-    if (printing_state.in_code_block) {
-        std::cout << Color::RESET;
-    }
-
     final_response.content = assistant_response_content;
     if (finish_reason == "tool_calls" && has_tools) {
         final_response.type = ApiResponse::Type::TOOL_CALL;
-        for (const auto& [idx, call] : tool_calls_data) {
+        for (auto& [idx, call] : tool_calls_data) {
+            call.function["arguments"] = tool_calls_arguments.at(idx).raw();
             final_response.tool_calls.push_back(call);
         }
     } else {
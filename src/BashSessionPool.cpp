@@ -0,0 +1,413 @@
+#include "BashSessionPool.h"
+
+#ifndef _WIN32
+
+#include "OutputCapture.h"
+#include "SpawnUtils.h"
+#include "Watchdog.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+namespace {
+    // bash 写入命令状态行的描述符
+    constexpr int kStatusFd = 4;
+
+    // 状态描述符关闭后，最多等 bash 退出这么久（kExitPolls * kExitPollInterval）
+    constexpr int kExitPolls = 50;
+    constexpr auto kExitPollInterval = std::chrono::milliseconds(2);
+
+    void set_nonblocking(int fd) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    }
+
+    // 每条命令一个随机标记，既作 here-document 的结束行，也作状态行的前缀
+    std::string make_marker() {
+        std::random_device random;
+        char hex[17];
+        std::snprintf(hex, sizeof(hex), "%08x%08x", static_cast<unsigned>(random()), static_cast<unsigned>(random()));
+        return std::string("__CODE_ATLAS_") + hex;
+    }
+
+    // times 的输出（shell 本身、已回收的子进程各一行 "用户 系统"，如 0m1.250s）中四个时间之和；
+    // 小数点随区域设置可能是逗号
+    bool parse_times(const std::string& text, double& user, double& system) {
+        double values[4];
+        int found = 0;
+        const char* p = text.c_str();
+        while (*p && found < 4) {
+            unsigned minutes = 0;
+            unsigned whole = 0;
+            unsigned fraction = 0;
+            int length = 0;
+            char separator = 0;
+            if (std::sscanf(p, "%um%u%c%u%n", &minutes, &whole, &separator, &fraction, &length) == 4 &&
+                (separator == '.' || separator == ',') && p[length] == 's') {
+                const char* digits = std::strchr(p, separator) + 1;
+                double scale = 1;
+                for (const char* d = digits; d < p + length; ++d) scale *= 10;
+                values[found++] = minutes * 60.0 + whole + fraction / scale;
+                p += length + 1;
+            } else {
+                ++p;
+            }
+        }
+        if (found < 4) {
+            return false;
+        }
+        user = values[0] + values[2];
+        system = values[1] + values[3];
+        return true;
+    }
+
+    // 读出当前可读的全部数据（描述符是非阻塞的）；返回 false 表示已经读到 EOF 或出错
+    template <typename Target>
+    bool drain(int fd, Target& target) {
+        std::array<char, 65536> buffer;
+        while (true) {
+            ssize_t n = read(fd, buffer.data(), buffer.size());
+            if (n > 0) {
+                target.append(std::string_view(buffer.data(), static_cast<size_t>(n)));
+                continue;
+            }
+            if (n < 0 && errno == EINTR) continue;
+            return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+        }
+    }
+}
+
+BashSessionPool::BashSessionPool(Options options) : options(std::move(options)) {
+}
+
+BashSessionPool::~BashSessionPool() {
+    shutdown();
+    for (auto& entry : sessions) {
+        for (int fd : {entry.second->control_fd, entry.second->stdout_fd, entry.second->stderr_fd, entry.second->status_fd}) {
+            close(fd);
+        }
+    }
+}
+
+void BashSessionPool::shutdown() {
+    // 不关闭描述符：其他线程可能正在读写它们，读到 EOF 后自行返回
+    std::lock_guard<std::mutex> lock(mutex);
+    if (stopping) {
+        return;
+    }
+    stopping = true;
+    for (auto& entry : sessions) {
+        killpg(entry.second->pid, SIGHUP);
+    }
+}
+
+std::shared_ptr<BashSessionPool::Session> BashSessionPool::start_session() {
+    int control[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, control) != 0) {
+        throw std::runtime_error(std::string("Could not create the bash session socket: ") + std::strerror(errno));
+    }
+    int pipes[3][2]; // stdout, stderr, 状态
+    int created = 0;
+    for (; created < 3; ++created) {
+        if (pipe(pipes[created]) != 0) {
+            break;
+        }
+    }
+    if (created < 3) {
+        int error = errno;
+        close(control[0]);
+        close(control[1]);
+        for (int i = 0; i < created; ++i) {
+            close(pipes[i][0]);
+            close(pipes[i][1]);
+        }
+        throw std::runtime_error(std::string("Could not create pipes for the bash session: ") + std::strerror(error));
+    }
+
+    // 本进程一端：关闭继承、非阻塞；子进程一端在 spawn 时 dup2 到固定编号
+    int child_fds[4] = {control[1], pipes[0][1], pipes[1][1], pipes[2][1]};
+    for (int& fd : child_fds) {
+        set_cloexec(fd);
+        fd = move_fd_above(fd, kStatusFd);
+    }
+    for (int fd : {control[0], pipes[0][0], pipes[1][0], pipes[2][0]}) {
+        set_cloexec(fd);
+        set_nonblocking(fd);
+    }
+    disable_sigpipe(control[0]);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, child_fds[0], STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, child_fds[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, child_fds[2], STDERR_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, child_fds[3], kStatusFd);
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETPGROUP);
+    posix_spawnattr_setpgroup(&attributes, 0);
+
+    // --norc：标准输入是套接字时，bash 会以为自己由 sshd 启动而读取 ~/.bashrc
+    std::vector<std::string> args = {options.executable, "--noprofile", "--norc"};
+    std::vector<char*> argv;
+    for (auto& arg : args) {
+        argv.push_back(arg.data());
+    }
+    argv.push_back(nullptr);
+
+    pid_t pid = 0;
+    int spawn_error = posix_spawnp(&pid, options.executable.c_str(), &actions, &attributes, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attributes);
+    for (int fd : child_fds) {
+        close(fd);
+    }
+    if (spawn_error != 0) {
+        for (int fd : {control[0], pipes[0][0], pipes[1][0], pipes[2][0]}) {
+            close(fd);
+        }
+        throw std::runtime_error("Could not start the bash session '" + options.executable + "': " + std::strerror(spawn_error));
+    }
+
+    auto session = std::make_shared<Session>();
+    // bash 还在等第一条命令，之后启动的进程都继承这些限制
+    session->cgroup = CgroupLeaf::create(options.limits);
+    if (session->cgroup && !session->cgroup->add(pid)) {
+        session->cgroup.reset();
+    }
+    apply_rlimits(pid, options.limits, session->cgroup != nullptr);
+    session->pid = pid;
+    session->control_fd = control[0];
+    session->stdout_fd = pipes[0][0];
+    session->stderr_fd = pipes[1][0];
+    session->status_fd = pipes[2][0];
+    return session;
+}
+
+std::shared_ptr<BashSessionPool::Session> BashSessionPool::session_for(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (stopping) {
+        throw std::runtime_error("Bash sessions have been shut down.");
+    }
+    auto it = sessions.find(name);
+    if (it != sessions.end()) {
+        return it->second;
+    }
+    if (sessions.size() >= options.max_sessions) {
+        throw std::runtime_error("Too many bash sessions (bash.max_sessions is " +
+                                 std::to_string(options.max_sessions) + "); reuse one of the existing sessions.");
+    }
+    auto session = start_session();
+    sessions[name] = session;
+    return session;
+}
+
+int BashSessionPool::end_session(const std::string& name, const std::shared_ptr<Session>& session,
+                                 struct rusage* usage) {
+    // 持有 mutex 直到回收完成，shutdown() 不会向一个已被回收（编号可能被重用）的进程组发信号
+    std::lock_guard<std::mutex> lock(mutex);
+    int status = 0;
+    pid_t reaped = 0;
+    struct rusage ignored {};
+    if (!usage) {
+        usage = &ignored;
+    }
+    // bash 在退出过程中先关闭描述符，稍等它成为僵尸进程
+    for (int attempt = 0; attempt < kExitPolls && reaped == 0; ++attempt) {
+        if (attempt > 0) {
+            std::this_thread::sleep_for(kExitPollInterval);
+        }
+        while ((reaped = wait4(session->pid, &status, WNOHANG, usage)) < 0 && errno == EINTR) {
+        }
+    }
+    if (reaped == 0) {
+        // bash 关闭了状态描述符但仍在运行（例如 exec 了另一个程序），这个会话已经不能再用
+        kill(session->pid, SIGKILL);
+        while (wait4(session->pid, &status, 0, usage) < 0 && errno == EINTR) {
+        }
+    }
+    for (int fd : {session->control_fd, session->stdout_fd, session->stderr_fd, session->status_fd}) {
+        close(fd);
+    }
+    session->ended = true;
+    auto it = sessions.find(name);
+    if (it != sessions.end() && it->second == session) {
+        sessions.erase(it);
+    }
+    return status;
+}
+
+BashSessionPool::Run BashSessionPool::run(const std::string& name, const std::string& code,
+                                          std::chrono::milliseconds timeout) {
+    Run result;
+    std::shared_ptr<Session> session = session_for(name);
+    std::lock_guard<std::mutex> session_lock(session->mutex);
+    if (session->ended) {
+        // 等待期间上一条命令结束了这个会话；它已经解绑，换一个新的
+        return run(name, code, timeout);
+    }
+    siginfo_t info{};
+    if (waitid(P_PID, static_cast<id_t>(session->pid), &info, WEXITED | WNOHANG | WNOWAIT) == 0 && info.si_pid == session->pid) {
+        // 两次调用之间 bash 已经退出（例如被外部结束）：不把代码交给它，直接换一个新的
+        end_session(name, session);
+        return run(name, code, timeout);
+    }
+
+    // 代码原样放进 here-document，由 read 读入变量后在当前 shell 中 eval；
+    // 子进程看不到 fd 4，所以状态描述符上的 EOF 只可能表示 bash 本身退出了。
+    // 状态行之前先写出 times，用来计算这条命令的 CPU 时间
+    std::string marker = make_marker();
+    std::string command = "IFS= read -r -d '' __code_atlas_code <<'" + marker + "' || :\n" + code;
+    if (!code.empty() && code.back() != '\n') {
+        command += '\n';
+    }
+    std::string status_fd = std::to_string(kStatusFd);
+    command += marker + "\n"
+               "eval \"$__code_atlas_code\" </dev/null 4>&-\n"
+               "__code_atlas_status=$?; times >&" + status_fd + "; "
+               "printf '%s %d\\n' " + marker + " \"$__code_atlas_status\" >&" + status_fd + "\n";
+    auto started = std::chrono::steady_clock::now();
+
+    // 超时：先向整个进程组发 SIGTERM，仍有进程存活再发 SIGKILL
+    std::atomic<int> kill_attempts{0};
+    uint64_t deadline = 0;
+    if (timeout > std::chrono::milliseconds::zero()) {
+        int pid = session->pid;
+        deadline = Watchdog::instance().arm(timeout, [pid, &kill_attempts]() {
+            killpg(pid, kill_attempts++ == 0 ? SIGTERM : SIGKILL);
+        }, kKillGrace);
+    }
+
+    // 同时写命令、读 stdout/stderr 和状态行，直到读到本条命令的状态行或 bash 退出；
+    // 内存中每个流只保留开头和结尾，其余写入溢出文件
+    OutputCapture stdout_capture(options.output, "stdout");
+    OutputCapture stderr_capture(options.output, "stderr");
+    std::string status_line;
+    std::string status_prefix = marker + " ";
+    size_t written = 0;
+    bool stdout_open = true;
+    bool stderr_open = true;
+    bool finished = false;
+    bool status_open = true;
+    while (status_open && !finished) {
+        pollfd fds[4];
+        nfds_t count = 0;
+        fds[count++] = {session->status_fd, POLLIN, 0};
+        if (stdout_open) fds[count++] = {session->stdout_fd, POLLIN, 0};
+        if (stderr_open) fds[count++] = {session->stderr_fd, POLLIN, 0};
+        if (written < command.size()) fds[count++] = {session->control_fd, POLLOUT, 0};
+        if (poll(fds, count, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        for (nfds_t i = 0; i < count; ++i) {
+            if (fds[i].revents == 0) continue;
+            int fd = fds[i].fd;
+            if (fd == session->control_fd) {
+                ssize_t n = send(fd, command.data() + written, command.size() - written, kSendFlags);
+                if (n > 0) {
+                    written += static_cast<size_t>(n);
+                } else if (n < 0 && errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK) {
+                    written = command.size(); // bash 已经退出，状态描述符上会读到 EOF
+                }
+            } else if (fd == session->stdout_fd) {
+                stdout_open = drain(fd, stdout_capture);
+            } else if (fd == session->stderr_fd) {
+                stderr_open = drain(fd, stderr_capture);
+            } else {
+                status_open = drain(fd, status_line);
+                size_t start = status_line.find(status_prefix);
+                size_t end = start == std::string::npos ? start : status_line.find('\n', start);
+                if (end != std::string::npos) {
+                    result.exit_status = std::atoi(status_line.c_str() + start + status_prefix.size());
+                    double user = 0;
+                    double system = 0;
+                    if (parse_times(status_line.substr(0, start), user, system)) {
+                        result.usage.user_seconds = std::max(0.0, user - session->user_seconds);
+                        result.usage.system_seconds = std::max(0.0, system - session->system_seconds);
+                        session->user_seconds = user;
+                        session->system_seconds = system;
+                    }
+                    finished = true;
+                }
+            }
+        }
+    }
+
+    if (deadline) {
+        Watchdog::instance().disarm(deadline);
+    }
+    result.timed_out = kill_attempts > 0;
+    // 命令结束前写入的输出都已经在管道里了
+    if (stdout_open) drain(session->stdout_fd, stdout_capture);
+    if (stderr_open) drain(session->stderr_fd, stderr_capture);
+    result.output = stdout_capture.str();
+    result.errors = stderr_capture.str();
+    result.usage.wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    result.usage.output_bytes = stdout_capture.total_bytes() + stderr_capture.total_bytes();
+
+    if (finished && !result.timed_out) {
+        if (session->cgroup) {
+            session->cgroup->read_usage(result.usage);
+        }
+        return result;
+    }
+    if (result.timed_out) {
+        // 进程组长还没有被回收，组号不会被重用
+        killpg(session->pid, SIGKILL);
+    }
+    struct rusage usage {};
+    int status = end_session(name, session, &usage);
+    if (!finished) {
+        // 没有读到 times 的输出：用回收 bash 时得到的累计值
+        ResourceUsage total;
+        fill_from_rusage(total, usage);
+        result.usage.user_seconds = std::max(0.0, total.user_seconds - session->user_seconds);
+        result.usage.system_seconds = std::max(0.0, total.system_seconds - session->system_seconds);
+    }
+    if (session->cgroup) {
+        session->cgroup->read_usage(result.usage);
+    }
+    result.ended = true;
+    if (!finished) {
+        result.exit_status = WIFEXITED(status) ? WEXITSTATUS(status) : 0;
+        result.term_signal = WIFSIGNALED(status) ? WTERMSIG(status) : 0;
+    }
+    return result;
+}
+
+#else
+
+#include <stdexcept>
+
+BashSessionPool::BashSessionPool(Options options) : options(std::move(options)) {
+    throw std::runtime_error("Persistent bash sessions require a POSIX system.");
+}
+
+BashSessionPool::~BashSessionPool() = default;
+
+BashSessionPool::Run BashSessionPool::run(const std::string&, const std::string&, std::chrono::milliseconds) {
+    throw std::runtime_error("Persistent bash sessions require a POSIX system.");
+}
+
+void BashSessionPool::shutdown() {
+}
+
+#endif // _WIN32
@@ -0,0 +1,285 @@
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include "CapabilityRegistry.h"
+#include "Trace.h"
+#include "Utils.h"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <nlohmann/json.hpp>
+
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+    // 缓存格式变化时递增，旧缓存会被忽略
+    constexpr int kCacheFormat = 1;
+
+    std::string env_or_empty(const char* name) {
+        const char* value = std::getenv(name);
+        return value ? value : "";
+    }
+
+    std::string default_cache_path() {
+        std::string directory = cache_directory();
+        return directory.empty() ? "" : directory + "/capabilities.json";
+    }
+
+    // 嵌入的解释器总是可用，版本在编译时确定
+    Capability python_capability() {
+        Capability python;
+        python.name = "python";
+        python.available = true;
+        python.version = PY_VERSION;
+        return python;
+    }
+
+#ifndef _WIN32
+    // 在 PATH 中查找可执行文件并记录缓存键；只调用 stat/access，不启动进程
+    Capability resolve(const std::string& name, const std::string& executable, const std::string& path_env) {
+        Capability capability;
+        capability.name = name;
+        size_t begin = 0;
+        while (begin <= path_env.size()) {
+            size_t end = path_env.find(':', begin);
+            if (end == std::string::npos) {
+                end = path_env.size();
+            }
+            // PATH 中的空项表示当前目录
+            std::string dir = end > begin ? path_env.substr(begin, end - begin) : ".";
+            fs::path candidate = fs::path(dir) / executable;
+            std::error_code ec;
+            if (fs::is_regular_file(candidate, ec) && access(candidate.c_str(), X_OK) == 0) {
+                capability.path = candidate.string();
+                capability.size = fs::file_size(candidate, ec);
+                auto mtime = fs::last_write_time(candidate, ec);
+                capability.mtime = ec ? 0 : static_cast<int64_t>(mtime.time_since_epoch().count());
+                return capability;
+            }
+            begin = end + 1;
+        }
+        return capability;
+    }
+
+    std::string shell_quote(const std::string& s) {
+        std::string quoted = "'";
+        for (char c : s) {
+            if (c == '\'') {
+                quoted += "'\\''";
+            } else {
+                quoted += c;
+            }
+        }
+        return quoted + "'";
+    }
+
+    // 运行 `<path> <flag>`，返回第一行输出；退出码非0时返回 false
+    bool first_output_line(const std::string& path, const char* flag, std::string& line) {
+        std::string command = shell_quote(path) + " " + flag + " 2>/dev/null";
+        FILE* pipe = popen(command.c_str(), "r");
+        if (!pipe) {
+            return false;
+        }
+        std::array<char, 256> buffer;
+        bool have_line = false;
+        while (fgets(buffer.data(), buffer.size(), pipe) != nullptr) {
+            if (!have_line) {
+                line = buffer.data();
+                have_line = true;
+            }
+        }
+        int status = pclose(pipe);
+        while (!line.empty() && (line.back() == '\n' || line.back() == '\r')) {
+            line.pop_back();
+        }
+        return status != -1 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    }
+
+    // "GNU bash, version 5.2.15(1)-release (...)" -> "5.2.15"
+    std::string parse_bash_version(const std::string& line) {
+        size_t pos = line.find("version ");
+        if (pos == std::string::npos) {
+            return "";
+        }
+        pos += 8;
+        size_t end = pos;
+        while (end < line.size() && (std::isdigit(static_cast<unsigned char>(line[end])) || line[end] == '.')) {
+            ++end;
+        }
+        return line.substr(pos, end - pos);
+    }
+
+    // "PowerShell 7.4.1" -> "7.4.1"
+    std::string parse_pwsh_version(const std::string& line) {
+        size_t pos = line.rfind(' ');
+        return pos == std::string::npos ? line : line.substr(pos + 1);
+    }
+
+    void probe_bash(Capability& bash) {
+        std::string line;
+        bash.available = !bash.path.empty() && first_output_line(bash.path, "--version", line);
+        bash.version = bash.available ? parse_bash_version(line) : "";
+    }
+
+    void probe_pwsh(Capability& pwsh) {
+        std::string line;
+        pwsh.available = !pwsh.path.empty() && first_output_line(pwsh.path, "-v", line);
+        pwsh.version = pwsh.available ? parse_pwsh_version(line) : "";
+    }
+
+    nlohmann::json to_json(const Capability& capability) {
+        return {
+            {"name", capability.name},
+            {"available", capability.available},
+            {"path", capability.path},
+            {"version", capability.version},
+            {"mtime", capability.mtime},
+            {"size", capability.size}
+        };
+    }
+
+    // 缓存仍然有效时用它填充 resolved 中的可用性和版本
+    bool load_cache(const std::string& cache_path, const std::string& path_env, std::vector<Capability>& resolved) {
+        std::ifstream file(cache_path);
+        if (!file) {
+            return false;
+        }
+        try {
+            nlohmann::json cache = nlohmann::json::parse(file);
+            if (cache.value("format", 0) != kCacheFormat || cache.value("path_env", "") != path_env ||
+                !cache.contains("capabilities") || cache["capabilities"].size() != resolved.size()) {
+                return false;
+            }
+            const auto& cached = cache["capabilities"];
+            for (size_t i = 0; i < resolved.size(); ++i) {
+                Capability& capability = resolved[i];
+                if (cached[i]["name"] != capability.name || cached[i]["path"] != capability.path ||
+                    cached[i]["mtime"].get<int64_t>() != capability.mtime ||
+                    cached[i]["size"].get<uint64_t>() != capability.size) {
+                    return false;
+                }
+            }
+            for (size_t i = 0; i < resolved.size(); ++i) {
+                resolved[i].available = cached[i]["available"].get<bool>();
+                resolved[i].version = cached[i]["version"].get<std::string>();
+            }
+            return true;
+        } catch (const std::exception&) {
+            return false; // 损坏的缓存等同于没有缓存
+        }
+    }
+
+    // 尽力而为：写入失败只是意味着下次还要重新探测
+    void save_cache(const std::string& cache_path, const std::string& path_env, const std::vector<Capability>& probed) {
+        nlohmann::json cache;
+        cache["format"] = kCacheFormat;
+        cache["path_env"] = path_env;
+        cache["capabilities"] = nlohmann::json::array();
+        for (const auto& capability : probed) {
+            cache["capabilities"].push_back(to_json(capability));
+        }
+        write_file_atomically(cache_path, cache.dump(2));
+    }
+#endif
+}
+
+CapabilityRegistry& CapabilityRegistry::instance() {
+    static CapabilityRegistry registry;
+    return registry;
+}
+
+void CapabilityRegistry::start(const std::string& cache_path) {
+    std::call_once(started, [this, cache_path]() {
+        std::string cache_file = cache_path.empty() ? default_cache_path() : cache_path;
+        result = std::async(std::launch::async, [cache_file]() {
+            Trace::set_thread_name("capability probe");
+            TraceSpan span("capabilities.probe", "startup");
+            ProbeResult probe;
+            probe.capabilities.push_back(python_capability());
+            OperatingSystem os = detect_operating_system();
+
+            if (os == OperatingSystem::Windows) {
+                // batch 由 cmd.exe 执行，Windows PowerShell 随系统提供
+                for (const char* name : {"batch", "powershell"}) {
+                    Capability capability;
+                    capability.name = name;
+                    capability.available = true;
+                    probe.capabilities.push_back(capability);
+                }
+                return probe;
+            }
+
+#ifndef _WIN32
+            std::string path_env = env_or_empty("PATH");
+            std::vector<Capability> resolved = {
+                resolve("bash", "bash", path_env),
+                resolve("powershell", "pwsh", path_env)
+            };
+
+            if (!cache_file.empty() && load_cache(cache_file, path_env, resolved)) {
+                probe.from_cache = true;
+            } else {
+                // 各个解释器互不依赖，同时启动；pwsh 需要加载 .NET 运行时，是最慢的一个
+                auto pwsh = std::async(std::launch::async, [&resolved]() {
+                    Trace::set_thread_name("pwsh probe");
+                    TraceSpan pwsh_span("capabilities.probe_pwsh", "startup");
+                    probe_pwsh(resolved[1]);
+                });
+                {
+                    TraceSpan bash_span("capabilities.probe_bash", "startup");
+                    probe_bash(resolved[0]);
+                }
+                pwsh.get();
+                if (!cache_file.empty()) {
+                    save_cache(cache_file, path_env, resolved);
+                }
+            }
+
+            if (os == OperatingSystem::Unknown) {
+                // For unknown OS, try bash as a fallback
+                resolved[0].available = true;
+            }
+            probe.capabilities.insert(probe.capabilities.end(), resolved.begin(), resolved.end());
+#endif
+            return probe;
+        }).share();
+    });
+}
+
+const CapabilityRegistry::ProbeResult& CapabilityRegistry::wait() {
+    start();
+    return result.get();
+}
+
+std::vector<Capability> CapabilityRegistry::capabilities() {
+    return wait().capabilities;
+}
+
+std::vector<std::string> CapabilityRegistry::supported_shells() {
+    std::vector<std::string> shells;
+    for (const auto& capability : wait().capabilities) {
+        if (capability.available) {
+            shells.push_back(capability.name);
+        }
+    }
+    return shells;
+}
+
+bool CapabilityRegistry::is_available(const std::string& name) {
+    const auto& capabilities = wait().capabilities;
+    return std::any_of(capabilities.begin(), capabilities.end(), [&name](const Capability& capability) {
+        return capability.available && capability.name == name;
+    });
+}
+
+bool CapabilityRegistry::loaded_from_cache() {
+    return wait().from_cache;
+}
@@ -0,0 +1,304 @@
+#include "ChunkDecoder.h"
+#include <nlohmann/json.hpp>
+
+void DecodedChunk::clear() {
+    has_content = false;
+    content.clear();
+    has_tool_calls = false;
+    tool_call_count = 0;
+    has_finish_reason = false;
+    finish_reason.clear();
+}
+
+ToolCallDelta& DecodedChunk::add_tool_call() {
+    if (tool_call_count == tool_call_slots.size()) {
+        tool_call_slots.emplace_back();
+    }
+    ToolCallDelta& call = tool_call_slots[tool_call_count++];
+    call.index = -1;
+    call.has_id = false;
+    call.has_name = false;
+    call.has_arguments = false;
+    call.id.clear();
+    call.name.clear();
+    call.arguments.clear();
+    return call;
+}
+
+// SAX 回调：沿着 choices[0].delta 路径记录位置，只复制关心的字符串
+struct ChunkSaxHandler {
+    using Location = ChunkDecoder::Location;
+    using Key = ChunkDecoder::Key;
+
+    std::vector<ChunkDecoder::Frame>& frames;
+    DecodedChunk& out;
+    ToolCallDelta* current_call = nullptr;
+    bool unknown_shape = false;
+
+    // 新的对象或数组所在的位置；同时把它计为父数组的一个元素
+    Location child_location(bool is_array) {
+        if (frames.empty()) {
+            return is_array ? Location::Ignored : Location::Root;
+        }
+        ChunkDecoder::Frame& parent = frames.back();
+        size_t element = parent.elements++;
+        switch (parent.location) {
+            case Location::Root:
+                if (parent.key == Key::Choices) {
+                    return is_array ? Location::Choices : mark_unknown();
+                }
+                return Location::Ignored;
+            case Location::Choices:
+                return (!is_array && element == 0) ? Location::FirstChoice : Location::Ignored;
+            case Location::FirstChoice:
+                if (parent.key == Key::Delta) {
+                    return is_array ? mark_unknown() : Location::Delta;
+                }
+                return Location::Ignored;
+            case Location::Delta:
+                if (parent.key == Key::ToolCalls) {
+                    return is_array ? Location::ToolCalls : mark_unknown();
+                }
+                if (parent.key == Key::Content) {
+                    return mark_unknown(); // 例如分段的 content 数组
+                }
+                return Location::Ignored;
+            case Location::ToolCalls:
+                return is_array ? mark_unknown() : Location::ToolCall;
+            case Location::ToolCall:
+                if (parent.key == Key::Function) {
+                    return is_array ? mark_unknown() : Location::Function;
+                }
+                return Location::Ignored;
+            case Location::Function:
+                if (parent.key == Key::Arguments) {
+                    return mark_unknown(); // 以对象形式给出的参数
+                }
+                return Location::Ignored;
+            default:
+                return Location::Ignored;
+        }
+    }
+
+    Location mark_unknown() {
+        unknown_shape = true;
+        return Location::Ignored;
+    }
+
+    // 处理一个标量值；string 为 nullptr 时，is_null 区分 null 与数字、布尔值
+    bool scalar(std::string* string, bool is_null) {
+        if (frames.empty()) {
+            return true;
+        }
+        ChunkDecoder::Frame& top = frames.back();
+        top.elements++;
+        if (top.location == Location::Root || top.location == Location::Choices ||
+            top.location == Location::ToolCalls || top.location == Location::Ignored) {
+            return true;
+        }
+
+        std::string* target = nullptr;
+        bool* flag = nullptr;
+        switch (top.location) {
+            case Location::FirstChoice:
+                if (top.key == Key::FinishReason) { target = &out.finish_reason; flag = &out.has_finish_reason; }
+                break;
+            case Location::Delta:
+                if (top.key == Key::Content) { target = &out.content; flag = &out.has_content; }
+                break;
+            case Location::ToolCall:
+                if (top.key == Key::Id) { target = &current_call->id; flag = &current_call->has_id; }
+                break;
+            case Location::Function:
+                if (top.key == Key::Name) { target = &current_call->name; flag = &current_call->has_name; }
+                if (top.key == Key::Arguments) { target = &current_call->arguments; flag = &current_call->has_arguments; }
+                break;
+            default:
+                break;
+        }
+        if (!target || is_null) {
+            return true;
+        }
+        if (!string) {
+            mark_unknown();
+            return false;
+        }
+        target->assign(*string);
+        *flag = true;
+        return true;
+    }
+
+    bool null() { return scalar(nullptr, true); }
+    bool boolean(bool) { return scalar(nullptr, false) && check_index(); }
+    bool number_float(double, const std::string&) { return scalar(nullptr, false) && check_index(); }
+    bool string(std::string& val) { return scalar(&val, false) && check_index(); }
+    bool binary(nlohmann::json::binary_t&) { return scalar(nullptr, false); }
+
+    bool number_integer(int64_t val) { return integer(val); }
+    bool number_unsigned(uint64_t val) { return integer(static_cast<int64_t>(val)); }
+
+    bool integer(int64_t val) {
+        if (!frames.empty() && frames.back().location == Location::ToolCall && frames.back().key == Key::Index) {
+            frames.back().elements++;
+            current_call->index = static_cast<int>(val);
+            return true;
+        }
+        return scalar(nullptr, false);
+    }
+
+    // index 必须是整数
+    bool check_index() {
+        if (!frames.empty() && frames.back().location == Location::ToolCall && frames.back().key == Key::Index) {
+            mark_unknown();
+            return false;
+        }
+        return true;
+    }
+
+    bool start_object(std::size_t) {
+        Location location = child_location(false);
+        if (location == Location::ToolCall) {
+            current_call = &out.add_tool_call();
+        }
+        frames.push_back({location, Key::Other, 0});
+        return !unknown_shape;
+    }
+
+    bool end_object() {
+        if (frames.back().location == Location::ToolCall && current_call->index < 0) {
+            mark_unknown();
+        }
+        frames.pop_back();
+        return !unknown_shape;
+    }
+
+    bool start_array(std::size_t) {
+        Location location = child_location(true);
+        if (location == Location::ToolCalls) {
+            out.has_tool_calls = true;
+        }
+        frames.push_back({location, Key::Other, 0});
+        return !unknown_shape;
+    }
+
+    bool end_array() {
+        frames.pop_back();
+        return true;
+    }
+
+    bool key(std::string& val) {
+        ChunkDecoder::Frame& top = frames.back();
+        top.key = Key::Other;
+        switch (top.location) {
+            case Location::Root:
+                if (val == "choices") top.key = Key::Choices;
+                break;
+            case Location::FirstChoice:
+                if (val == "delta") top.key = Key::Delta;
+                else if (val == "finish_reason") top.key = Key::FinishReason;
+                break;
+            case Location::Delta:
+                if (val == "content") top.key = Key::Content;
+                else if (val == "tool_calls") top.key = Key::ToolCalls;
+                break;
+            case Location::ToolCall:
+                if (val == "index") top.key = Key::Index;
+                else if (val == "id") top.key = Key::Id;
+                else if (val == "function") top.key = Key::Function;
+                break;
+            case Location::Function:
+                if (val == "name") top.key = Key::Name;
+                else if (val == "arguments") top.key = Key::Arguments;
+                break;
+            default:
+                break;
+        }
+        return true;
+    }
+
+    template <class Exception>
+    bool parse_error(std::size_t, const std::string&, const Exception&) {
+        return false;
+    }
+};
+
+void ChunkDecoder::decode(std::string_view data, DecodedChunk& out) {
+    out.clear();
+    frames.clear();
+    ChunkSaxHandler handler{frames, out};
+    bool parsed = nlohmann::json::sax_parse(data.begin(), data.end(), &handler);
+    if (!parsed || handler.unknown_shape) {
+        // 非法JSON或无法识别的结构：完整解析，保证行为与之前一致
+        ++fallbacks;
+        decode_dom(data, out);
+    }
+}
+
+void ChunkDecoder::decode_dom(std::string_view data, DecodedChunk& out) {
+    out.clear();
+    nlohmann::json chunk = nlohmann::json::parse(data.begin(), data.end());
+    if (!chunk.is_object() || !chunk.contains("choices") || !chunk["choices"].is_array() || chunk["choices"].empty()) {
+        return;
+    }
+    const auto& choice = chunk["choices"][0];
+    if (!choice.is_object()) {
+        return;
+    }
+    if (choice.contains("finish_reason") && choice["finish_reason"].is_string()) {
+        out.finish_reason = choice["finish_reason"].get<std::string>();
+        out.has_finish_reason = true;
+    }
+    if (!choice.contains("delta") || !choice["delta"].is_object()) {
+        return;
+    }
+    const auto& delta = choice["delta"];
+
+    if (delta.contains("content")) {
+        const auto& content = delta["content"];
+        if (content.is_string()) {
+            out.content = content.get<std::string>();
+            out.has_content = true;
+        } else if (content.is_array()) {
+            // 分段形式的 content：拼接所有文本段
+            for (const auto& part : content) {
+                if (part.is_object() && part.contains("text") && part["text"].is_string()) {
+                    out.content += part["text"].get<std::string>();
+                    out.has_content = true;
+                }
+            }
+        }
+    }
+
+    if (delta.contains("tool_calls") && delta["tool_calls"].is_array()) {
+        out.has_tool_calls = true;
+        int position = 0;
+        for (const auto& tool_chunk : delta["tool_calls"]) {
+            if (!tool_chunk.is_object()) {
+                ++position;
+                continue;
+            }
+            ToolCallDelta& call = out.add_tool_call();
+            // 缺少 index 时按数组中的位置处理
+            call.index = (tool_chunk.contains("index") && tool_chunk["index"].is_number_integer())
+                             ? tool_chunk["index"].get<int>() : position;
+            if (tool_chunk.contains("id") && tool_chunk["id"].is_string()) {
+                call.id = tool_chunk["id"].get<std::string>();
+                call.has_id = true;
+            }
+            if (tool_chunk.contains("function") && tool_chunk["function"].is_object()) {
+                const auto& function = tool_chunk["function"];
+                if (function.contains("name") && function["name"].is_string()) {
+                    call.name = function["name"].get<std::string>();
+                    call.has_name = true;
+                }
+                if (function.contains("arguments") && !function["arguments"].is_null()) {
+                    // 有的后端直接给出参数对象
+                    call.arguments = function["arguments"].is_string() ? function["arguments"].get<std::string>()
+                                                                        : function["arguments"].dump();
+                    call.has_arguments = true;
+                }
+            }
+            ++position;
+        }
+    }
+}
@@ -1,11 +1,25 @@
 #define PY_SSIZE_T_CLEAN
 #include <Python.h>
 #include "CodeExecutor.h"
+#include "BashSessionPool.h"
+#include "LiveOutput.h"
+#include "OutputCapture.h"
+#include "PythonWorkerPool.h"
+#include "ResourceUsage.h"
+#include "SpawnUtils.h"
+#include "Trace.h"
+#include "Watchdog.h"
 #include <iostream>
 #include <vector>
 #include <fstream>
 #include <filesystem>
 #include <stdexcept>
+#include <future>
+#include <memory>
+#include <optional>
+#include <atomic>
+#include <array>
+#include <csignal>
 #include <nlohmann/json.hpp>
 
 // Platform-specific includes for subprocess execution
@@ -19,7 +33,17 @@
 #else
 #include <unistd.h>
 #include <sys/wait.h>
+#include <sys/resource.h>
 #include <ctime>
+#include <cerrno>
+#include <fcntl.h>
+#include <pthread.h>
+#include <spawn.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <cstring>
+
+extern char** environ;
 #endif
 
 #include "Utils.h"
@@ -135,38 +159,705 @@ std::string sanitize_output_for_utf8(const std::string& output) {
 
 // --- PythonExecutor Implementation ---
 
-PythonExecutor::PythonExecutor() : main_module(nullptr), main_dict(nullptr) {
-    // 确保Python解释器正确初始化
-    if (!Py_IsInitialized()) {
-    Py_Initialize();
+namespace {
+    // 截止时间到达后，每隔这么久再中断一次（用户代码可能吞掉了上一次的异常）
+    constexpr auto kInterruptRepeat = std::chrono::seconds(1);
+    // 中断之后最多再等这么久；仍未结束就不再等待，先把超时结果返回
+    constexpr auto kInterruptGrace = std::chrono::seconds(5);
+
+    // 用来中断用户代码的信号；Python只在它自己的主线程（即我们的Python线程）上运行信号处理函数
+#ifdef _WIN32
+    constexpr int kInterruptSignal = SIGBREAK;
+#else
+    constexpr int kInterruptSignal = SIGUSR1;
+#endif
+
+    std::string format_seconds(std::chrono::milliseconds duration) {
+        if (duration.count() % 1000 == 0) {
+            return std::to_string(duration.count() / 1000) + " s";
+        }
+        std::string text = std::to_string(duration.count() / 1000.0);
+        text.erase(text.find_last_not_of('0') + 1);
+        return text + " s";
     }
-    
-    if (!Py_IsInitialized()) {
-        throw std::runtime_error("Failed to initialize Python interpreter.");
+
+    std::string join_output(const std::string& stdout_str, const std::string& stderr_str) {
+        std::string output = stdout_str;
+        if (!stderr_str.empty()) {
+            if (!output.empty()) output += "\n--- STDERR ---\n";
+            output += stderr_str;
+        }
+        return output;
     }
-    
-    // 获取 __main__ 模块和其字典 (全局命名空间)
-    main_module = PyImport_AddModule("__main__");
+
+    // 执行成功完成时的结果：有 stderr 输出即视为出错
+    std::string cell_result(const std::string& stdout_str, const std::string& stderr_str) {
+        nlohmann::json result_json;
+        if (!stderr_str.empty()) {
+            result_json["status"] = "error";
+            result_json["output"] = join_output(stdout_str, stderr_str);
+        } else {
+            result_json["status"] = "success";
+            result_json["output"] = stdout_str.empty() ? "[No output]" : stdout_str;
+        }
+        return result_json.dump();
+    }
+
+    // 逃出执行包装函数的异常（SystemExit、KeyboardInterrupt 等）
+    std::string wrapper_failure_result(const std::string& stdout_str, const std::string& stderr_str, const std::string& error) {
+        nlohmann::json result_json;
+        result_json["status"] = "error";
+        std::string output = join_output(stdout_str, stderr_str);
+        if (!output.empty()) output += "\n";
+        result_json["output"] = output + "Execution wrapper failed: " + error;
+        return result_json.dump();
+    }
+
+    std::string timeout_result(const std::string& output, std::chrono::milliseconds timeout, const std::string& note) {
+        nlohmann::json result_json;
+        result_json["status"] = "timeout";
+        result_json["timeout_seconds"] = timeout.count() / 1000.0;
+        result_json["output"] = (output.empty() ? "" : output + "\n") + note;
+        return result_json.dump();
+    }
+
+    std::string import_profile_path(const nlohmann::json& config) {
+        if (config.contains("python") && config["python"].contains("import_profile") &&
+            config["python"]["import_profile"].is_string() &&
+            !config["python"]["import_profile"].get<std::string>().empty()) {
+            return config["python"]["import_profile"].get<std::string>();
+        }
+        std::string directory = cache_directory();
+        return directory.empty() ? "" : directory + "/import_profile.json";
+    }
+
+    // 执行包装函数：在解释器启动时编译一次，之后每次执行只调用它。
+    // 用户代码只解析一次，各部分只编译一次、执行一次；最后一个表达式的值会像交互式解释器一样打印出来。
+    // 返回代码中 import 语句导入的、执行后已经加载且不是解释器启动时就有的顶层模块。
+    const char* kWrapperSource = R"#(
+import ast
+import sys
+import traceback
+
+_baseline = frozenset(sys.modules)
+
+def _imported_modules(tree):
+    names = set()
+    for node in ast.walk(tree):
+        if isinstance(node, ast.Import):
+            names.update(alias.name.partition('.')[0] for alias in node.names)
+        elif isinstance(node, ast.ImportFrom) and node.level == 0 and node.module:
+            names.add(node.module.partition('.')[0])
+    return names
+
+def _run(source, namespace, stdout, stderr):
+    saved_stdout, saved_stderr = sys.stdout, sys.stderr
+    sys.stdout, sys.stderr = stdout, stderr
+    try:
+        try:
+            tree = ast.parse(source, '<string>', 'exec')
+        except (SyntaxError, ValueError) as e:
+            traceback.print_exception(type(e), e, None)
+            return []
+        imports = _imported_modules(tree)
+
+        last = None
+        if tree.body and isinstance(tree.body[-1], ast.Expr):
+            last = ast.Expression(tree.body.pop().value)
+        try:
+            if tree.body:
+                exec(compile(tree, '<string>', 'exec'), namespace)
+            if last is not None:
+                result = eval(compile(last, '<string>', 'eval'), namespace)
+                if result is not None:
+                    print(repr(result))
+        except Exception as e:
+            if isinstance(e, SyntaxError) and e.text is None and e.lineno:
+                # Errors found while compiling the tree (e.g. 'return' outside function) carry no source line
+                lines = source.splitlines()
+                if e.lineno <= len(lines):
+                    e.text = lines[e.lineno - 1] + '\n'
+            # Skip the frame of _run itself so only the user's code shows up
+            traceback.print_exception(type(e), e, e.__traceback__.tb_next)
+        except CellTimeout as e:
+            # Raised by the deadline handler; shows where the code was interrupted
+            traceback.print_exception(type(e), e, e.__traceback__.tb_next)
+        return [name for name in imports if name in sys.modules and name not in _baseline]
+    finally:
+        sys.stdout, sys.stderr = saved_stdout, saved_stderr
+)#";
+
+    // 用作 sys.stdout / sys.stderr 的写入对象：write() 直接把 UTF-8 文本追加到 C++ 的缓冲区，
+    // 并转发给实时输出（如果有）。只在持有GIL时访问这些字段；两次执行之间 target 为空，写入会被丢弃。
+    struct CaptureWriter {
+        PyObject_HEAD
+        OutputCapture* target;
+        LiveOutput* live;
+        bool is_stderr;
+    };
+
+    void capture_append(CaptureWriter* writer, const char* data, size_t size) {
+        writer->target->append(std::string_view(data, size));
+        if (writer->live) {
+            writer->live->write(std::string_view(data, size), writer->is_stderr);
+        }
+    }
+
+    PyObject* capture_write(PyObject* self, PyObject* text) {
+        if (!PyUnicode_Check(text)) {
+            PyErr_Format(PyExc_TypeError, "write() argument must be str, not %.100s", Py_TYPE(text)->tp_name);
+            return NULL;
+        }
+        CaptureWriter* writer = reinterpret_cast<CaptureWriter*>(self);
+        if (writer->target) {
+            Py_ssize_t size = 0;
+            const char* data = PyUnicode_AsUTF8AndSize(text, &size);
+            if (data) {
+                capture_append(writer, data, static_cast<size_t>(size));
+            } else {
+                // 孤立的代理字符无法编码为 UTF-8，替换掉而不是让 print() 失败
+                PyErr_Clear();
+                PyObject* encoded = PyUnicode_AsEncodedString(text, "utf-8", "replace");
+                if (!encoded) {
+                    return NULL;
+                }
+                capture_append(writer, PyBytes_AS_STRING(encoded), static_cast<size_t>(PyBytes_GET_SIZE(encoded)));
+                Py_DECREF(encoded);
+            }
+        }
+        return PyLong_FromSsize_t(PyUnicode_GET_LENGTH(text));
+    }
+
+    PyObject* capture_none(PyObject*, PyObject*) {
+        Py_RETURN_NONE;
+    }
+
+    PyObject* capture_false(PyObject*, PyObject*) {
+        Py_RETURN_FALSE;
+    }
+
+    PyObject* capture_true(PyObject*, PyObject*) {
+        Py_RETURN_TRUE;
+    }
+
+    PyObject* capture_fileno(PyObject*, PyObject*) {
+        // 与 io.StringIO 一样：没有底层文件描述符
+        PyObject* io = PyImport_ImportModule("io");
+        PyObject* unsupported = io ? PyObject_GetAttrString(io, "UnsupportedOperation") : NULL;
+        Py_XDECREF(io);
+        if (!unsupported) {
+            return NULL;
+        }
+        PyErr_SetString(unsupported, "fileno");
+        Py_DECREF(unsupported);
+        return NULL;
+    }
+
+    PyObject* capture_encoding(PyObject*, void*) {
+        return PyUnicode_FromString("utf-8");
+    }
+
+    PyObject* capture_errors(PyObject*, void*) {
+        return PyUnicode_FromString("strict");
+    }
+
+    PyObject* capture_closed(PyObject*, void*) {
+        Py_RETURN_FALSE;
+    }
+
+    void capture_dealloc(PyObject* self) {
+        PyTypeObject* type = Py_TYPE(self);
+        PyObject_Free(self);
+        Py_DECREF(type); // 堆类型的实例持有类型的引用
+    }
+
+    PyMethodDef capture_methods[] = {
+        {"write", capture_write, METH_O, NULL},
+        {"flush", capture_none, METH_NOARGS, NULL},
+        {"isatty", capture_false, METH_NOARGS, NULL},
+        {"readable", capture_false, METH_NOARGS, NULL},
+        {"seekable", capture_false, METH_NOARGS, NULL},
+        {"writable", capture_true, METH_NOARGS, NULL},
+        {"fileno", capture_fileno, METH_NOARGS, NULL},
+        {NULL, NULL, 0, NULL}
+    };
+
+    PyGetSetDef capture_getset[] = {
+        {"encoding", capture_encoding, NULL, NULL, NULL},
+        {"errors", capture_errors, NULL, NULL, NULL},
+        {"closed", capture_closed, NULL, NULL, NULL},
+        {NULL, NULL, NULL, NULL, NULL}
+    };
+
+    PyType_Slot capture_slots[] = {
+        {Py_tp_dealloc, reinterpret_cast<void*>(capture_dealloc)},
+        {Py_tp_methods, capture_methods},
+        {Py_tp_getset, capture_getset},
+        {0, NULL}
+    };
+
+    PyType_Spec capture_spec = {
+        "code_atlas.CaptureWriter", sizeof(CaptureWriter), 0, Py_TPFLAGS_DEFAULT, capture_slots
+    };
+
+    PyObject* new_capture_writer(PyObject* type, bool is_stderr) {
+        CaptureWriter* writer = PyObject_New(CaptureWriter, reinterpret_cast<PyTypeObject*>(type));
+        if (writer) {
+            writer->target = nullptr;
+            writer->live = nullptr;
+            writer->is_stderr = is_stderr;
+        }
+        return reinterpret_cast<PyObject*>(writer);
+    }
+
+    void set_capture_target(PyObject* writer, OutputCapture* target, LiveOutput* live) {
+        reinterpret_cast<CaptureWriter*>(writer)->target = target;
+        reinterpret_cast<CaptureWriter*>(writer)->live = live;
+    }
+}
+
+PythonExecutor::PythonExecutor(const nlohmann::json& config)
+    : main_session(std::make_unique<Session>()), import_profile(import_profile_path(config)) {
+    if (config.contains("python") && config["python"].contains("preload_modules")) {
+        preload_modules = config["python"]["preload_modules"].get<size_t>();
+    }
+    output_options = OutputCapture::Options(config);
+#if PY_VERSION_HEX >= 0x030C0000
+    use_subinterpreters = !(config.contains("python") && config["python"].contains("subinterpreters") &&
+                            !config["python"]["subinterpreters"].get<bool>());
+#endif
+    if (config.contains("python") && config["python"].contains("max_sessions")) {
+        max_sessions = config["python"]["max_sessions"].get<size_t>();
+    }
+    if (config.contains("python") && config["python"].contains("backend") &&
+        config["python"]["backend"] == "forkserver") {
+        PythonWorkerPool::Options pool_options;
+        if (config["python"].contains("worker_executable") && config["python"]["worker_executable"].is_string() &&
+            !config["python"]["worker_executable"].get<std::string>().empty()) {
+            pool_options.executable = config["python"]["worker_executable"].get<std::string>();
+        }
+        if (config["python"].contains("idle_workers")) {
+            pool_options.idle_workers = config["python"]["idle_workers"].get<size_t>();
+        }
+        pool_options.wrapper_source = kWrapperSource;
+        pool_options.preload = import_profile.most_frequent(preload_modules);
+        pool_options.max_sessions = max_sessions + 1; // 默认会话也占一个工作进程
+        pool_options.limits = ResourceLimits(config);
+        try {
+            worker_pool = std::make_unique<PythonWorkerPool>(std::move(pool_options));
+        } catch (const std::exception& e) {
+            std::cerr << "[Warning] " << e.what() << " Falling back to the embedded interpreter." << std::endl;
+        }
+    }
+
+    // 不等待初始化：提示符可以立即出现，第一次执行时再等待
+    std::promise<std::string> init_result;
+    main_session->ready = init_result.get_future().share();
+    main_session->thread = std::thread([this, init_result = std::move(init_result)]() mutable {
+        python_thread_main(init_result);
+    });
+}
+
+PythonExecutor::~PythonExecutor() {
+    shutdown();
+}
+
+void PythonExecutor::shutdown() {
+    if (worker_pool) {
+        worker_pool->shutdown();
+    }
+    // 子解释器必须在主解释器关闭之前结束
+    bool all_stopped = true;
+    {
+        std::lock_guard<std::mutex> lock(sessions_mutex);
+        for (auto& entry : sessions) {
+            all_stopped = stop_session(*entry.second) && all_stopped;
+        }
+    }
+    if (!all_stopped) {
+        // 有会话仍在运行用户代码，关闭主解释器不安全；进程即将退出，放弃默认会话的线程
+        {
+            std::lock_guard<std::mutex> lock(main_session->task_mutex);
+            main_session->stopping = true;
+        }
+        main_session->task_cv.notify_all();
+        if (main_session->thread.joinable()) {
+            main_session->thread.detach();
+        }
+        return;
+    }
+    stop_session(*main_session);
+}
+
+bool PythonExecutor::stop_session(Session& session) {
+    {
+        std::lock_guard<std::mutex> lock(session.task_mutex);
+        session.stopping = true;
+    }
+    session.task_cv.notify_all();
+    if (!session.thread.joinable()) {
+        return true;
+    }
+    if (session.busy) {
+        // 用户代码仍在运行，无法安全地关闭解释器；进程即将退出，直接放弃该线程
+        session.thread.detach();
+        return false;
+    }
+    session.thread.join();
+    return true;
+}
+
+bool PythonExecutor::wait_until_ready() {
+    return main_session->ready.get().empty();
+}
+
+std::string PythonExecutor::setup_session(Session& session) {
+    // 获取 __main__ 模块的字典 (全局命名空间)；每个解释器有自己的 __main__
+    PyObject* main_module = PyImport_AddModule("__main__");
     if (!main_module) {
-        throw std::runtime_error("Failed to get __main__ module.");
+        return "Failed to get __main__ module.";
     }
-    main_dict = PyModule_GetDict(main_module);
+    session.globals = PyModule_GetDict(main_module);
 
     // 简化预加载，避免复杂的导入
     const char* pre_run_code =
         "import sys\n"
         "import io\n";
-    PyObject* result = PyRun_String(pre_run_code, Py_file_input, main_dict, main_dict);
+    PyObject* result = PyRun_String(pre_run_code, Py_file_input, session.globals, session.globals);
     if (!result) {
         std::string error = check_python_error();
         // 不抛出异常，只是记录错误
     }
     Py_XDECREF(result);
+
+    // 超过时限时在用户代码中抛出的异常；继承 BaseException，不会被 except Exception 吞掉
+    session.timeout_exception = PyErr_NewExceptionWithDoc("code_atlas.CellTimeout",
+                                                          "Raised in code that ran past its time limit.",
+                                                          PyExc_BaseException, NULL);
+
+    // 执行包装函数放在隔离的命名空间中，不污染用户的全局变量
+    PyObject* wrapper_globals = PyDict_New();
+    if (wrapper_globals && session.timeout_exception &&
+        PyDict_SetItemString(wrapper_globals, "__builtins__", PyEval_GetBuiltins()) == 0 &&
+        PyDict_SetItemString(wrapper_globals, "CellTimeout", session.timeout_exception) == 0) {
+        PyObject* wrapper_result = PyRun_String(kWrapperSource, Py_file_input, wrapper_globals, wrapper_globals);
+        if (wrapper_result) {
+            session.run_function = PyDict_GetItemString(wrapper_globals, "_run");
+            Py_XINCREF(session.run_function);
+            Py_DECREF(wrapper_result);
+        }
+    }
+    Py_XDECREF(wrapper_globals);
+
+    // 类型对象属于创建它的解释器，每个会话各建一个
+    PyObject* writer_type = PyType_FromSpec(&capture_spec);
+    if (writer_type) {
+        session.stdout_writer = new_capture_writer(writer_type, false);
+        session.stderr_writer = new_capture_writer(writer_type, true);
+        Py_DECREF(writer_type); // 实例持有类型的引用
+    }
+
+    if (!session.run_function || !session.stdout_writer || !session.stderr_writer) {
+        std::string error = check_python_error();
+        clear_session(session);
+        return "Failed to create the Python execution wrapper. " + error;
+    }
+    return "";
 }
 
-PythonExecutor::~PythonExecutor() {
-    if (Py_IsInitialized()) {
+void PythonExecutor::clear_session(Session& session) {
+    for (auto& entry : session.namespaces) {
+        Py_CLEAR(entry.second);
+    }
+    session.namespaces.clear();
+    Py_CLEAR(session.timeout_exception);
+    Py_CLEAR(session.run_function);
+    Py_CLEAR(session.stdout_writer);
+    Py_CLEAR(session.stderr_writer);
+    session.globals = nullptr;
+}
+
+PyThreadState* PythonExecutor::run_tasks(Session& session, PyThreadState* state) {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(session.task_mutex);
+            session.task_cv.wait(lock, [&session]() { return session.stopping || !session.tasks.empty(); });
+            if (session.stopping) {
+                // 未执行的任务随队列一起销毁，等待者会收到 broken_promise
+                session.tasks.clear();
+                break;
+            }
+            task = std::move(session.tasks.front());
+            session.tasks.pop_front();
+            session.busy = true;
+        }
+
+        PyEval_RestoreThread(state);
+        task();
+        state = PyEval_SaveThread();
+    }
+    return state;
+}
+
+void PythonExecutor::python_thread_main(std::promise<std::string>& report_ready) {
+    Session& session = *main_session;
+#ifndef _WIN32
+    session.thread_handle = pthread_self();
+#endif
+    Trace::set_thread_name("python");
+    std::optional<TraceSpan> init_span(std::in_place, "python.init", "startup");
+
+    // 确保Python解释器正确初始化
+    if (!Py_IsInitialized()) {
+        Py_Initialize();
+    }
+
+    if (!Py_IsInitialized()) {
+        report_ready.set_value("Failed to initialize Python interpreter.");
+        return;
+    }
+
+    std::string error = setup_session(session);
+    if (!error.empty()) {
         Py_Finalize();
+        report_ready.set_value(error);
+        return;
+    }
+
+    install_interrupt_handler();
+    init_span.reset();
+
+    // 空闲时释放GIL，执行任务时再重新获取
+    PyThreadState* thread_state = PyEval_SaveThread();
+    report_ready.set_value("");
+
+    // 使用工作进程时由模板进程预先导入
+    std::vector<std::string> warmup_modules;
+    if (!worker_pool) {
+        warmup_modules = import_profile.most_frequent(preload_modules);
+    }
+    if (!warmup_modules.empty()) {
+        warmup_thread = std::thread([this, warmup_modules]() { warmup_main(warmup_modules); });
+    }
+
+    thread_state = run_tasks(session, thread_state);
+
+    // 预热线程需要GIL，必须在重新获取GIL之前等它结束
+    warmup_stopping = true;
+    if (warmup_thread.joinable()) {
+        warmup_thread.join();
+    }
+
+    PyEval_RestoreThread(thread_state);
+    clear_session(session);
+    Py_Finalize();
+}
+
+void PythonExecutor::subinterpreter_thread_main(Session& session, std::promise<std::string>& report_ready) {
+    Trace::set_thread_name("python session");
+#if PY_VERSION_HEX >= 0x030C0000
+    std::string main_error = main_session->ready.get();
+    if (!main_error.empty()) {
+        report_ready.set_value(main_error);
+        return;
+    }
+
+    // 创建子解释器需要持有主解释器的GIL；创建后当前线程状态切换到子解释器，并持有它自己的GIL
+    PyGILState_STATE gil = PyGILState_Ensure();
+    PyThreadState* main_state = PyThreadState_Get();
+    PyInterpreterConfig config = {};
+    config.use_main_obmalloc = 0;
+    config.allow_fork = 0;
+    config.allow_exec = 1; // 允许 subprocess
+    config.allow_threads = 1;
+    config.allow_daemon_threads = 0;
+    config.check_multi_interp_extensions = 1;
+    config.gil = PyInterpreterConfig_OWN_GIL;
+    PyStatus status = Py_NewInterpreterFromConfig(&session.thread_state, &config);
+    if (PyStatus_Exception(status)) {
+        PyGILState_Release(gil);
+        report_ready.set_value(std::string("Failed to create a Python subinterpreter: ") +
+                               (status.err_msg ? status.err_msg : "unknown error"));
+        return;
+    }
+
+    std::string error = setup_session(session);
+    if (!error.empty()) {
+        Py_EndInterpreter(session.thread_state);
+        session.thread_state = nullptr;
+        PyThreadState_Swap(main_state);
+        PyGILState_Release(gil);
+        report_ready.set_value(error);
+        return;
+    }
+    session.thread_id = PyThread_get_thread_ident(); // PyThreadState_SetAsyncExc 按操作系统线程编号查找线程状态
+
+    // 切回主解释器（释放子解释器的GIL），再释放主解释器的GIL
+    PyThreadState_Swap(main_state);
+    PyGILState_Release(gil);
+
+    session.interrupter = std::thread([this, &session]() { interrupter_main(session); });
+    report_ready.set_value("");
+
+    PyThreadState* thread_state = run_tasks(session, session.thread_state);
+
+    {
+        std::lock_guard<std::mutex> lock(session.interrupt_mutex);
+        session.interrupter_stopping = true;
+    }
+    session.interrupt_cv.notify_all();
+    session.interrupter.join();
+
+    // 中断线程已经删除了它的线程状态，子解释器只剩当前这一个
+    PyEval_RestoreThread(thread_state);
+    clear_session(session);
+    Py_EndInterpreter(thread_state);
+    session.thread_state = nullptr;
+#else
+    (void)session;
+    report_ready.set_value("Python subinterpreters with their own GIL require Python 3.12 or newer.");
+#endif
+}
+
+PythonExecutor::Session& PythonExecutor::session_for(const std::string& name) {
+    if (name.empty() || !use_subinterpreters) {
+        return *main_session;
+    }
+    std::lock_guard<std::mutex> lock(sessions_mutex);
+    auto it = sessions.find(name);
+    if (it != sessions.end()) {
+        return *it->second;
+    }
+    if (sessions.size() >= max_sessions) {
+        throw std::runtime_error("Too many Python sessions (python.max_sessions is " + std::to_string(max_sessions) +
+                                 "); reuse one of the existing sessions.");
+    }
+    auto session = std::make_unique<Session>();
+    session->name = name;
+    std::promise<std::string> init_result;
+    session->ready = init_result.get_future().share();
+    Session& created = *session;
+    created.thread = std::thread([this, &created, init_result = std::move(init_result)]() mutable {
+        subinterpreter_thread_main(created, init_result);
+    });
+    sessions.emplace(name, std::move(session));
+    return created;
+}
+
+void PythonExecutor::install_interrupt_handler() {
+    // 处理函数是一个原生函数：只有当前执行确实超时时才抛出异常，上一次执行遗留的信号被忽略
+    static PyMethodDef handler_def = {"_interrupt_handler", &PythonExecutor::interrupt_signal_handler, METH_VARARGS, NULL};
+    PyObject* self = PyCapsule_New(main_session.get(), NULL, NULL);
+    PyObject* handler = self ? PyCFunction_New(&handler_def, self) : NULL;
+    Py_XDECREF(self);
+    PyObject* signal_module = handler ? PyImport_ImportModule("signal") : NULL;
+    PyObject* previous = signal_module ? PyObject_CallMethod(signal_module, "signal", "iO", kInterruptSignal, handler) : NULL;
+    if (!previous) {
+        // 没有处理函数时截止时间仍然生效，只是无法打断用户代码
+        std::cerr << "[Warning] Could not install the Python interrupt handler: " << check_python_error() << std::endl;
+    }
+    Py_XDECREF(previous);
+    Py_XDECREF(signal_module);
+    Py_XDECREF(handler);
+}
+
+PyObject* PythonExecutor::interrupt_signal_handler(PyObject* self, PyObject*) {
+    Session* session = static_cast<Session*>(PyCapsule_GetPointer(self, NULL));
+    if (!session || !session->interrupt_requested) {
+        PyErr_Clear();
+        Py_RETURN_NONE;
+    }
+    std::string message = "execution exceeded its time limit of " + format_seconds(session->cell_timeout);
+    PyErr_SetString(session->timeout_exception, message.c_str());
+    return NULL;
+}
+
+void PythonExecutor::interrupt_cell(Session& session) {
+    session.interrupt_requested = true;
+    if (session.thread_state) {
+        // 子解释器：获取它的GIL可能要等一会儿，交给会话自己的中断线程，不阻塞 Watchdog
+        {
+            std::lock_guard<std::mutex> lock(session.interrupt_mutex);
+            session.interrupt_pending = true;
+        }
+        session.interrupt_cv.notify_one();
+        return;
+    }
+#ifdef _WIN32
+#if PY_VERSION_HEX >= 0x030A0000
+    // 只设置标志，阻塞中的系统调用不会被打断
+    PyErr_SetInterruptEx(kInterruptSignal);
+#endif
+#else
+    // 发给Python线程的真实信号会让阻塞中的系统调用（sleep、recv 等）以 EINTR 返回
+    pthread_kill(session.thread_handle, kInterruptSignal);
+#endif
+}
+
+void PythonExecutor::interrupter_main(Session& session) {
+    // 线程状态记录创建它的线程的编号，必须在这个线程上创建，否则 PyThreadState_SetAsyncExc 会找错对象
+    session.interrupt_state = PyThreadState_New(PyThreadState_GetInterpreter(session.thread_state));
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(session.interrupt_mutex);
+            session.interrupt_cv.wait(lock, [&session]() { return session.interrupter_stopping || session.interrupt_pending; });
+            if (session.interrupter_stopping) {
+                break;
+            }
+            session.interrupt_pending = false;
+        }
+        // 会话线程在执行结束时持有GIL清除 interrupt_requested，因此这里看到的标志不会过期
+        PyEval_RestoreThread(session.interrupt_state);
+        if (session.interrupt_requested) {
+            PyThreadState_SetAsyncExc(session.thread_id, session.timeout_exception);
+        }
+        PyEval_SaveThread();
+    }
+    PyEval_RestoreThread(session.interrupt_state);
+    PyThreadState_Clear(session.interrupt_state);
+    PyThreadState_DeleteCurrent();
+    session.interrupt_state = nullptr;
+}
+
+void PythonExecutor::warmup_main(std::vector<std::string> modules) {
+    Trace::set_thread_name("python warmup");
+    TraceSpan span("python.warmup", "startup");
+    for (const auto& module : modules) {
+        if (warmup_stopping) {
+            return;
+        }
+        // 每个模块单独获取一次GIL；导入期间解释器也会周期性地切换线程，用户代码不会被整个预热挡住
+        PyGILState_STATE gil = PyGILState_Ensure();
+        PyObject* imported = PyImport_ImportModule(module.c_str());
+        Py_XDECREF(imported);
+        PyErr_Clear(); // 模块可能已经卸载，导入失败时忽略
+        PyGILState_Release(gil);
+    }
+}
+
+void PythonExecutor::record_imports(PyObject* modules) {
+    std::vector<std::string> names;
+    if (PyList_Check(modules)) {
+        for (Py_ssize_t i = 0; i < PyList_Size(modules); ++i) {
+            const char* name = PyUnicode_AsUTF8(PyList_GetItem(modules, i));
+            if (name) {
+                names.push_back(name);
+            }
+        }
+    }
+    PyErr_Clear();
+    record_import_names(names);
+}
+
+void PythonExecutor::record_import_names(const std::vector<std::string>& modules) {
+    std::lock_guard<std::mutex> lock(import_profile_mutex);
+    bool changed = false;
+    for (const auto& name : modules) {
+        changed = import_profile.record(name) || changed;
+    }
+    if (changed) {
+        import_profile.save();
     }
 }
 
@@ -223,146 +914,225 @@ std::string PythonExecutor::check_python_error() {
 }
 
 
-std::string PythonExecutor::execute(const std::string& code) {
-    // 1. Trim leading/trailing whitespace from the code
-    std::string trimmed_code = code;
-    size_t start = trimmed_code.find_first_not_of(" \t\n\r");
-    if (start != std::string::npos) {
-        trimmed_code = trimmed_code.substr(start);
-        size_t end = trimmed_code.find_last_not_of(" \t\n\r");
-        trimmed_code = (end != std::string::npos) ? trimmed_code.substr(0, end + 1) : "";
-    } else {
-        trimmed_code.clear();
+std::string PythonExecutor::execute(const std::string& code, std::chrono::milliseconds timeout, const std::string& session_name) {
+    TraceSpan span("python.execute", "tool");
+    std::string resource_key = session_name.empty() ? "python" : "python:" + session_name;
+    if (worker_pool) {
+        ResourceUsage usage;
+        std::string output = execute_in_worker(code, timeout, session_name, usage);
+        return attach_resources(output, resource_key, usage);
     }
-    
-    if (trimmed_code.empty()) {
+    Session& session = session_for(session_name);
+    // 共用主解释器时，命名会话由默认会话在自己的命名空间中执行
+    std::string namespace_name = (&session == main_session.get()) ? session_name : "";
+
+    // 只等待解释器本身；需要的模块如果正在预热，导入时由Python的模块锁等待
+    std::string init_error = session.ready.get();
+    if (!init_error.empty()) {
+        throw std::runtime_error(init_error);
+    }
+
+    // 超时后调用者可能不再等待，任务需要自己持有代码和结果的共享状态
+    auto promise = std::make_shared<std::promise<std::string>>();
+    auto state = std::make_shared<std::atomic<int>>(kCellQueued);
+    std::future<std::string> result = promise->get_future();
+    {
+        std::lock_guard<std::mutex> lock(session.task_mutex);
+        if (session.stopping) {
+            throw std::runtime_error("Python interpreter has been shut down.");
+        }
+        session.tasks.emplace_back([this, &session, promise, state, namespace_name, resource_key, code, timeout]() {
+            int expected = kCellQueued;
+            if (!state->compare_exchange_strong(expected, kCellRunning)) {
+                session.busy = false; // 调用者已经放弃了这次执行
+                return;
+            }
+            std::string output;
+            std::exception_ptr error;
+            try {
+                // 内嵌的解释器与本进程共用资源：只能测量这个线程的消耗，不能施加限制
+                ResourceMeter meter;
+                ResourceUsage usage;
+                output = execute_in_interpreter(session, namespace_name, code, timeout, usage);
+                meter.finish(usage);
+                output = attach_resources(output, resource_key, usage);
+            } catch (...) {
+                error = std::current_exception();
+            }
+            session.busy = false;
+            if (error) {
+                promise->set_exception(error);
+            } else {
+                promise->set_value(std::move(output));
+            }
+        });
+    }
+    session.task_cv.notify_one();
+
+    if (timeout > std::chrono::milliseconds::zero() &&
+        result.wait_for(timeout + kInterruptGrace) == std::future_status::timeout) {
+        int expected = kCellQueued;
+        if (state->compare_exchange_strong(expected, kCellAbandoned)) {
+            return timeout_result("", timeout, "Execution did not start within " + format_seconds(timeout) +
+                                  ": the interpreter is still busy with an earlier call that ignored its time limit.");
+        }
+        return timeout_result("", timeout, "Execution exceeded its time limit of " + format_seconds(timeout) +
+                              " and did not stop when interrupted; it is still running, and later python calls wait for it to finish.");
+    }
+    return result.get();
+}
+
+std::string PythonExecutor::execute_in_interpreter(Session& session, const std::string& namespace_name,
+                                                   const std::string& code, std::chrono::milliseconds timeout,
+                                                   ResourceUsage& usage) {
+    // 1. Trim leading/trailing whitespace from the code
+    size_t start = code.find_first_not_of(" \t\n\r");
+    if (start == std::string::npos) {
         nlohmann::json result_json;
         result_json["status"] = "success";
         result_json["output"] = "[No code to execute]";
         return result_json.dump();
     }
+    size_t end = code.find_last_not_of(" \t\n\r");
 
-    // 2. Set the user's code as a variable in the Python interpreter's main dictionary
-    PyObject* user_code_obj = PyUnicode_FromString(trimmed_code.c_str());
+    // 2. Run it through the precompiled wrapper; output goes straight into these buffers
+    PyObject* user_code_obj = PyUnicode_FromStringAndSize(code.data() + start, static_cast<Py_ssize_t>(end - start + 1));
     if (!user_code_obj) {
+        PyErr_Clear();
         return "Error: Failed to create Python string from user code.";
     }
-    // PyDict_SetItemString returns 0 on success, -1 on failure.
-    if (PyDict_SetItemString(main_dict, "user_code", user_code_obj) != 0) {
-        Py_DECREF(user_code_obj);
-        return "Error: Failed to set user_code variable in Python context.";
+
+    PyObject* globals = session.globals;
+    if (!namespace_name.empty()) {
+        // 共用主解释器的命名会话：第一次使用时创建一个新的 __main__ 命名空间
+        PyObject*& named = session.namespaces[namespace_name];
+        if (!named) {
+            named = PyDict_New();
+            PyObject* module_name = PyUnicode_FromString("__main__");
+            bool created = named && module_name && PyDict_SetItemString(named, "__name__", module_name) == 0 &&
+                           PyDict_SetItemString(named, "__builtins__", PyEval_GetBuiltins()) == 0;
+            Py_XDECREF(module_name);
+            if (!created) {
+                Py_CLEAR(named);
+                session.namespaces.erase(namespace_name);
+                Py_DECREF(user_code_obj);
+                return "Error: Failed to create the namespace of Python session '" + namespace_name + "'. " + check_python_error();
+            }
+        }
+        globals = named;
     }
-    Py_DECREF(user_code_obj); // main_dict now owns the reference
 
-    // 3. Define the Python wrapper script
-    const char* python_script = R"#(
-import sys
-import io
-import ast
-from contextlib import redirect_stdout, redirect_stderr
+    OutputCapture stdout_capture(output_options, "stdout");
+    OutputCapture stderr_capture(output_options, "stderr");
+    LiveOutput* live = live_output.load();
+    set_capture_target(session.stdout_writer, &stdout_capture, live);
+    set_capture_target(session.stderr_writer, &stderr_capture, live);
+    session.cell_timeout = timeout;
+    uint64_t deadline = 0;
+    if (timeout > std::chrono::milliseconds::zero()) {
+        deadline = Watchdog::instance().arm(timeout, [this, &session]() { interrupt_cell(session); }, kInterruptRepeat);
+    }
+    PyObject* imported = PyObject_CallFunctionObjArgs(session.run_function, user_code_obj, globals,
+                                                      session.stdout_writer, session.stderr_writer, NULL);
+    if (deadline) {
+        // disarm() 返回后不会再有新的中断；已经发出但还没处理的信号会因为标志被清除而被忽略
+        Watchdog::instance().disarm(deadline);
+    }
+    bool timed_out = session.interrupt_requested.exchange(false);
+    if (timed_out && session.thread_state) {
+        // 撤销还没来得及抛出的异步异常，免得它落到下一次执行里
+        PyThreadState_SetAsyncExc(session.thread_id, NULL);
+    }
+    set_capture_target(session.stdout_writer, nullptr, nullptr);
+    set_capture_target(session.stderr_writer, nullptr, nullptr);
+    Py_DECREF(user_code_obj);
+    usage.output_bytes = stdout_capture.total_bytes() + stderr_capture.total_bytes();
+    std::string stdout_str = stdout_capture.str();
+    std::string stderr_str = stderr_capture.str();
 
-# The user_code variable is pre-set in globals() by the C++ host.
+    if (timed_out) {
+        // 会话保持不变：超时之前定义的变量和导入的模块仍然可用
+        if (imported) {
+            record_imports(imported);
+            Py_DECREF(imported);
+        } else {
+            std::string error = check_python_error();
+            stderr_str += error;
+        }
+        return timeout_result(join_output(stdout_str, stderr_str), timeout,
+                              "Execution was interrupted after exceeding its time limit of " + format_seconds(timeout) +
+                              "; the interpreter session is still available.");
+    }
 
-captured_stdout = io.StringIO()
-captured_stderr = io.StringIO()
+    if (!imported) {
+        // 只有 SystemExit、KeyboardInterrupt 这类非 Exception 的异常会逃出包装函数
+        return wrapper_failure_result(stdout_str, stderr_str, check_python_error());
+    }
 
-with redirect_stdout(captured_stdout), redirect_stderr(captured_stderr):
-    try:
-        # Attempt to parse the user's code into an Abstract Syntax Tree (AST)
-        tree = ast.parse(user_code, mode='exec')
-        
-        # Check if the AST body is not empty and the last statement is an expression
-        if tree.body and isinstance(tree.body[-1], ast.Expr):
-            # Separate the last expression from the rest of the statements
-            last_expr_node = tree.body.pop()
-            
-            # Execute all statements before the final expression
-            if tree.body:
-                exec_code_obj = compile(tree, '<string>', 'exec')
-                exec(exec_code_obj, globals())
-            
-            # Evaluate the final expression
-            eval_code_obj = compile(ast.Expression(last_expr_node.value), '<string>', 'eval')
-            result = eval(eval_code_obj, globals())
-            
-            # If the expression yields a result, print its representation
-            if result is not None:
-                print(repr(result))
-        else:
-            # If the code is not an expression-terminated script, execute it as a whole.
-            exec(user_code, globals())
-            
-    except Exception:
-        # If any exception occurs (e.g., syntax error in ast.parse),
-        # fall back to executing the code directly. This can handle
-        # code snippets that are not valid modules but are otherwise executable.
-        try:
-            exec(user_code, globals())
-        except Exception:
-            # If execution still fails, capture the traceback.
-            import traceback
-            traceback.print_exc()
-
-# Store the captured output in global variables for C++ to retrieve
-globals()['stdout_result'] = captured_stdout.getvalue()
-globals()['stderr_result'] = captured_stderr.getvalue()
-)#";
+    // 3. Remember which modules this code imported, so later sessions can preload them
+    record_imports(imported);
+    Py_DECREF(imported);
 
-    // 4. Execute the wrapper script
-    PyObject* result_obj = PyRun_String(python_script, Py_file_input, main_dict, main_dict);
-    nlohmann::json result_json;
+    // 4. Format output
+    return cell_result(stdout_str, stderr_str);
+}
 
-    if (!result_obj) {
-        PyDict_DelItemString(main_dict, "user_code"); // Clean up
-        result_json["status"] = "error";
-        result_json["output"] = "Execution wrapper failed: " + check_python_error();
+std::string PythonExecutor::execute_in_worker(const std::string& code, std::chrono::milliseconds timeout,
+                                              const std::string& session, ResourceUsage& usage) {
+    size_t start = code.find_first_not_of(" \t\n\r");
+    if (start == std::string::npos) {
+        nlohmann::json result_json;
+        result_json["status"] = "success";
+        result_json["output"] = "[No code to execute]";
         return result_json.dump();
     }
-    Py_XDECREF(result_obj);
+    size_t end = code.find_last_not_of(" \t\n\r");
 
-    // 5. Retrieve stdout and stderr from Python
-    std::string stdout_str;
-    std::string stderr_str;
-    
-    // Retrieve stdout
-    PyObject* stdout_val = PyDict_GetItemString(main_dict, "stdout_result");
-    if (stdout_val && PyUnicode_Check(stdout_val)) {
-        const char* s_str = PyUnicode_AsUTF8(stdout_val);
-        if (s_str) stdout_str = s_str;
-    }
-    
-    // Retrieve stderr
-    PyObject* stderr_val = PyDict_GetItemString(main_dict, "stderr_result");
-    if (stderr_val && PyUnicode_Check(stderr_val)) {
-        const char* s_str = PyUnicode_AsUTF8(stderr_val);
-        if (s_str) stderr_str = s_str;
-    }
-    
-    // 6. Clean up variables from the Python context
-    PyDict_DelItemString(main_dict, "user_code");
-    PyDict_DelItemString(main_dict, "stdout_result");
-    PyDict_DelItemString(main_dict, "stderr_result");
+    OutputCapture stdout_capture(output_options, "stdout");
+    OutputCapture stderr_capture(output_options, "stderr");
+    PythonWorkerPool::Run run = worker_pool->run(session, code.substr(start, end - start + 1), timeout,
+                                                 "execution exceeded its time limit of " + format_seconds(timeout),
+                                                 stdout_capture, stderr_capture, live_output.load());
+    record_import_names(run.imports);
+    usage = run.usage;
+    usage.output_bytes = stdout_capture.total_bytes() + stderr_capture.total_bytes();
+    std::string stdout_str = stdout_capture.str();
+    std::string stderr_str = stderr_capture.str();
 
-    // 7. Format output
-    if (!stderr_str.empty()) {
-        result_json["status"] = "error";
-        std::string combined_output = stdout_str;
-        if (!stdout_str.empty() && !stderr_str.empty()) {
-            combined_output += "\n--- STDERR ---\n";
+    if (run.timed_out) {
+        if (run.outcome == PythonWorkerPool::Run::Outcome::Lost) {
+            return timeout_result(join_output(stdout_str, stderr_str), timeout,
+                                  "Execution exceeded its time limit of " + format_seconds(timeout) +
+                                  " and did not stop when interrupted, so its worker process was killed; "
+                                  "the session's variables were lost and the next call starts a fresh session.");
         }
-        combined_output += stderr_str;
-        result_json["output"] = combined_output;
-    } else {
-        result_json["status"] = "success";
-        result_json["output"] = stdout_str.empty() ? "[No output]" : stdout_str;
+        if (run.outcome == PythonWorkerPool::Run::Outcome::Failed) {
+            stderr_str += run.failure;
+        }
+        return timeout_result(join_output(stdout_str, stderr_str), timeout,
+                              "Execution was interrupted after exceeding its time limit of " + format_seconds(timeout) +
+                              "; the interpreter session is still available.");
     }
-
-    return result_json.dump();
+    if (run.outcome == PythonWorkerPool::Run::Outcome::Lost) {
+        nlohmann::json result_json;
+        result_json["status"] = "error";
+        std::string output = join_output(stdout_str, stderr_str);
+        if (!output.empty()) output += "\n";
+        result_json["output"] = output + "The Python worker process exited unexpectedly (for example a crash in an extension "
+                                         "module); the session's variables were lost and the next call starts a fresh session.";
+        return result_json.dump();
+    }
+    if (run.outcome == PythonWorkerPool::Run::Outcome::Failed) {
+        return wrapper_failure_result(stdout_str, stderr_str, run.failure);
+    }
+    return cell_result(stdout_str, stderr_str);
 }
 
 // --- ShellExecutor Implementation (Windows) ---
 #ifdef _WIN32
-std::string execute_shell_code(const std::string& shell_name, const std::string& code) {
+std::string execute_shell_code(const std::string& shell_name, const std::string& code, std::chrono::milliseconds timeout,
+                               const ResourceLimits& limits, const OutputCapture::Options& output) {
+    TraceSpan span("shell.execute", "tool");
     // 1. 创建临时文件
     namespace fs = std::filesystem;
     fs::path temp_dir = fs::temp_directory_path();
@@ -420,6 +1190,11 @@ std::string execute_shell_code(const std::string& shell_name, const std::string&
         }
 
         // 2. 创建用于重定向的匿名管道
+        // 并发执行时，其他调用的可继承管道句柄会被这里创建的子进程继承，导致读取方迟迟收不到EOF。
+        // 因此从创建管道到关闭写句柄的整个区间互斥执行。
+        static std::mutex process_creation_mutex;
+        std::unique_lock<std::mutex> creation_lock(process_creation_mutex);
+
         SECURITY_ATTRIBUTES sa;
         sa.nLength = sizeof(SECURITY_ATTRIBUTES);
         sa.bInheritHandle = TRUE;
@@ -452,20 +1227,66 @@ std::string execute_shell_code(const std::string& shell_name, const std::string&
             command_line = L"cmd.exe /c \"" + final_temp_path.wstring() + L"\"";
         }
 
-        if (!CreateProcessW(NULL, &command_line[0], NULL, NULL, TRUE, CREATE_NO_WINDOW, NULL, NULL, &si, &pi)) {
+        // 先挂起创建，放进 Job 对象之后再运行，这样脚本启动的子进程也都属于这个 Job，
+        // Job 的限制（每个进程的 CPU 时间和内存、进程数）和资源统计也覆盖它们
+        HANDLE job = CreateJobObjectW(NULL, NULL);
+        if (job && (limits.cpu_seconds > 0 || limits.memory_bytes > 0 || limits.max_processes > 0)) {
+            JOBOBJECT_EXTENDED_LIMIT_INFORMATION job_limits;
+            ZeroMemory(&job_limits, sizeof(job_limits));
+            if (limits.cpu_seconds > 0) {
+                job_limits.BasicLimitInformation.LimitFlags |= JOB_OBJECT_LIMIT_PROCESS_TIME;
+                job_limits.BasicLimitInformation.PerProcessUserTimeLimit.QuadPart =
+                    static_cast<LONGLONG>(limits.cpu_seconds * 1e7); // 以 100 纳秒为单位
+            }
+            if (limits.memory_bytes > 0) {
+                job_limits.BasicLimitInformation.LimitFlags |= JOB_OBJECT_LIMIT_PROCESS_MEMORY;
+                job_limits.ProcessMemoryLimit = limits.memory_bytes;
+            }
+            if (limits.max_processes > 0) {
+                job_limits.BasicLimitInformation.LimitFlags |= JOB_OBJECT_LIMIT_ACTIVE_PROCESS;
+                job_limits.BasicLimitInformation.ActiveProcessLimit = static_cast<DWORD>(limits.max_processes);
+            }
+            SetInformationJobObject(job, JobObjectExtendedLimitInformation, &job_limits, sizeof(job_limits));
+        }
+        auto started = std::chrono::steady_clock::now();
+        if (!CreateProcessW(NULL, &command_line[0], NULL, NULL, TRUE, CREATE_NO_WINDOW | CREATE_SUSPENDED, NULL, NULL, &si, &pi)) {
             CloseHandle(h_stdout_wr); CloseHandle(h_stdout_rd);
             CloseHandle(h_stderr_wr); CloseHandle(h_stderr_rd);
+            if (job) CloseHandle(job);
             fs::remove(final_temp_path);
             throw std::runtime_error("CreateProcess failed. Error: " + std::to_string(GetLastError()));
         }
+        if (job && !AssignProcessToJobObject(job, pi.hProcess)) {
+            CloseHandle(job);
+            job = NULL;
+        }
+        ResumeThread(pi.hThread);
 
         // 关闭管道的写句柄，以便读取时能收到EOF
         CloseHandle(h_stdout_wr);
         CloseHandle(h_stderr_wr);
         h_stdout_wr = h_stderr_wr = NULL;
+        creation_lock.unlock();
+
+        // 超时后结束整个 Job（没有 Job 时只能结束脚本进程本身）
+        std::atomic<bool> killed{false};
+        uint64_t deadline = 0;
+        if (timeout > std::chrono::milliseconds::zero()) {
+            HANDLE process = pi.hProcess;
+            deadline = Watchdog::instance().arm(timeout, [job, process, &killed]() {
+                killed = true;
+                if (job) {
+                    TerminateJobObject(job, 1);
+                } else {
+                    TerminateProcess(process, 1);
+                }
+            });
+        }
 
         // 4. 改进的输出读取逻辑
-        std::string stdout_str, stderr_str;
+        // 内存中每个流只保留开头和结尾，其余写入溢出文件
+        OutputCapture stdout_capture(output, "stdout");
+        OutputCapture stderr_capture(output, "stderr");
         DWORD dwRead;
         CHAR chBuf[4096];
         DWORD bytes_available = 0;  // 声明在外层作用域
@@ -484,7 +1305,7 @@ std::string execute_shell_code(const std::string& shell_name, const std::string&
             if (PeekNamedPipe(h_stdout_rd, NULL, 0, NULL, &bytes_available, NULL) && bytes_available > 0) {
                 if (ReadFile(h_stdout_rd, chBuf, sizeof(chBuf) - 1, &dwRead, NULL) && dwRead > 0) {
                     chBuf[dwRead] = '\0';
-                    stdout_str += chBuf;
+                    stdout_capture.append(std::string_view(chBuf, dwRead));
                 }
             }
             
@@ -493,7 +1314,7 @@ std::string execute_shell_code(const std::string& shell_name, const std::string&
             if (PeekNamedPipe(h_stderr_rd, NULL, 0, NULL, &bytes_available, NULL) && bytes_available > 0) {
                 if (ReadFile(h_stderr_rd, chBuf, sizeof(chBuf) - 1, &dwRead, NULL) && dwRead > 0) {
                     chBuf[dwRead] = '\0';
-                    stderr_str += chBuf;
+                    stderr_capture.append(std::string_view(chBuf, dwRead));
                 }
             }
             
@@ -506,7 +1327,7 @@ std::string execute_shell_code(const std::string& shell_name, const std::string&
         while (PeekNamedPipe(h_stdout_rd, NULL, 0, NULL, &bytes_available, NULL) && bytes_available > 0) {
             if (ReadFile(h_stdout_rd, chBuf, sizeof(chBuf) - 1, &dwRead, NULL) && dwRead > 0) {
                 chBuf[dwRead] = '\0';
-                stdout_str += chBuf;
+                stdout_capture.append(std::string_view(chBuf, dwRead));
             } else {
                 break;
             }
@@ -516,17 +1337,47 @@ std::string execute_shell_code(const std::string& shell_name, const std::string&
         while (PeekNamedPipe(h_stderr_rd, NULL, 0, NULL, &bytes_available, NULL) && bytes_available > 0) {
             if (ReadFile(h_stderr_rd, chBuf, sizeof(chBuf) - 1, &dwRead, NULL) && dwRead > 0) {
                 chBuf[dwRead] = '\0';
-                stderr_str += chBuf;
+                stderr_capture.append(std::string_view(chBuf, dwRead));
             } else {
                 break;
             }
         }
         
+        std::string stdout_str = stdout_capture.str();
+        std::string stderr_str = stderr_capture.str();
+
+        // disarm() 返回后回调不会再运行，之后才能关闭它用到的句柄
+        if (deadline) {
+            Watchdog::instance().disarm(deadline);
+        }
+        bool timed_out = killed;
+
         DWORD exit_code;
         GetExitCodeProcess(pi.hProcess, &exit_code);
+
+        ResourceUsage usage;
+        usage.wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        usage.output_bytes = stdout_capture.total_bytes() + stderr_capture.total_bytes();
+        JOBOBJECT_BASIC_ACCOUNTING_INFORMATION accounting;
+        JOBOBJECT_EXTENDED_LIMIT_INFORMATION job_info;
+        if (job && QueryInformationJobObject(job, JobObjectBasicAccountingInformation, &accounting, sizeof(accounting), NULL)) {
+            usage.user_seconds = static_cast<double>(accounting.TotalUserTime.QuadPart) / 1e7;
+            usage.system_seconds = static_cast<double>(accounting.TotalKernelTime.QuadPart) / 1e7;
+            usage.processes = static_cast<long>(accounting.TotalProcesses);
+        }
+        if (job && QueryInformationJobObject(job, JobObjectExtendedLimitInformation, &job_info, sizeof(job_info), NULL)) {
+            usage.max_rss_kb = static_cast<long>(job_info.PeakProcessMemoryUsed / 1024);
+        }
+        // 超出 Job 限制的进程以这些状态码结束
+        if (exit_code == ERROR_NOT_ENOUGH_QUOTA || exit_code == STATUS_NO_MEMORY) {
+            if (limits.memory_bytes > 0) usage.limit_exceeded = "memory";
+        } else if (limits.cpu_seconds > 0 && usage.user_seconds >= limits.cpu_seconds) {
+            usage.limit_exceeded = "cpu";
+        }
         
         CloseHandle(pi.hProcess);
         CloseHandle(pi.hThread);
+        if (job) CloseHandle(job);
         CloseHandle(h_stdout_rd);
         CloseHandle(h_stderr_rd);
         
@@ -555,6 +1406,13 @@ std::string execute_shell_code(const std::string& shell_name, const std::string&
 #endif
         }
 
+        if (timed_out) {
+            return attach_resources(timeout_result(join_output(result_str, stderr_str), timeout,
+                                                   "Process exceeded its time limit of " + format_seconds(timeout) +
+                                                   " and was killed along with its child processes."),
+                                    shell_name, usage);
+        }
+
         if (exit_code != 0 || !stderr_str.empty()) {
             result_json["status"] = "error";
             std::string error_output = result_str;
@@ -572,144 +1430,361 @@ std::string execute_shell_code(const std::string& shell_name, const std::string&
             result_json["output"] = result_str.empty() ? "[No output]" : result_str;
         }
         
-        return result_json.dump();
+        return attach_resources(result_json.dump(), shell_name, usage);
 
     } catch (...) {
         fs::remove(final_temp_path); // 确保在异常时也删除文件
         throw;
     }
 }
+
+std::string execute_shell_session(BashSessionPool&, const std::string&, const std::string&, std::chrono::milliseconds) {
+    throw std::runtime_error("Persistent bash sessions require a POSIX system.");
+}
 #else
 // --- ShellExecutor Implementation (Linux/macOS) ---
-std::string execute_shell_code(const std::string& shell_name, const std::string& code) {
-    // Improved Linux/macOS implementation with OS-aware shell selection
-    namespace fs = std::filesystem;
-    fs::path temp_dir = fs::temp_directory_path();
 
-    // Generate unique temporary filename
-    std::string temp_filename = "code_exec_" + std::to_string(getpid()) + "_" + std::to_string(time(nullptr));
+namespace {
+
+// The script is handed to the shell as /dev/fd/3, so nothing is written to disk
+constexpr int kScriptFd = 3;
+constexpr const char* kScriptPath = "/dev/fd/3";
+
+// Create a pipe whose ends are close-on-exec, so concurrently spawned scripts don't inherit them
+bool open_pipe(int fds[2]) {
+#ifdef __linux__
+    return pipe2(fds, O_CLOEXEC) == 0;
+#else
+    if (pipe(fds) != 0) {
+        return false;
+    }
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    return true;
+#endif
+}
+
+// Linux: put the script in an anonymous in-memory file. It is seekable, so bash reads it in
+// blocks instead of a byte at a time, and the whole script is in place before the shell starts.
+int script_memfd(const std::string& script) {
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+    int fd = memfd_create("code-atlas-script", MFD_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    size_t written = 0;
+    while (written < script.size()) {
+        ssize_t n = write(fd, script.data() + written, script.size() - written);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            close(fd);
+            return -1;
+        }
+        written += static_cast<size_t>(n);
+    }
+    return fd;
+#else
+    (void)script;
+    return -1;
+#endif
+}
+
+// Write to the script pipe without letting a shell that exited early kill us with SIGPIPE:
+// the signal is blocked for this thread during the write and a pending one is consumed.
+ssize_t write_script(int fd, const char* data, size_t size) {
+    sigset_t pipe_set, old_set;
+    sigemptyset(&pipe_set);
+    sigaddset(&pipe_set, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipe_set, &old_set);
+    ssize_t n = write(fd, data, size);
+    int saved_errno = errno;
+    if (n < 0 && errno == EPIPE && !sigismember(&old_set, SIGPIPE)) {
+        sigset_t pending;
+        sigpending(&pending);
+        if (sigismember(&pending, SIGPIPE)) {
+            int signal_number = 0;
+            sigwait(&pipe_set, &signal_number);
+        }
+    }
+    pthread_sigmask(SIG_SETMASK, &old_set, nullptr);
+    errno = saved_errno;
+    return n;
+}
+
+// Trailing newlines carry no information in a tool result
+std::string trim_trailing_newlines(std::string text) {
+    while (!text.empty() && (text.back() == '\n' || text.back() == '\r')) {
+        text.pop_back();
+    }
+    return text;
+}
+
+// Result of a finished script: success only if it exited with status 0 and wrote nothing to stderr.
+// A note (e.g. that the session ended) goes on its own line after everything else.
+std::string shell_result(std::string output, std::string errors, int exit_status, int term_signal,
+                         const std::string& note = "") {
+    output = trim_trailing_newlines(std::move(output));
+    errors = trim_trailing_newlines(std::move(errors));
+
+    nlohmann::json result_json;
+    std::string text;
+    if (exit_status == 0 && term_signal == 0 && errors.empty()) {
+        result_json["status"] = "success";
+        text = output.empty() && note.empty() ? "[No output]" : output;
+    } else {
+        result_json["status"] = "error";
+        text = join_output(output, errors);
+        if (term_signal != 0) {
+            if (!text.empty()) text += "\n";
+            text += "Process terminated by signal: " + std::to_string(term_signal);
+        } else if (exit_status != 0) {
+            if (!text.empty()) text += "\n";
+            text += "Process exited with status: " + std::to_string(exit_status);
+        }
+    }
+    if (!note.empty()) {
+        if (!text.empty()) text += "\n";
+        text += note;
+    }
+    result_json["output"] = text;
+    return result_json.dump();
+}
+
+// Which limit a finished script ran into, judged from its wait status and usage. A shell that
+// runs the offending command as a child reports its death as status 128 + signal.
+void note_exceeded_limit(ResourceUsage& usage, const ResourceLimits& limits, int exit_status, int term_signal) {
+    if (!usage.limit_exceeded.empty() || limits.cpu_seconds <= 0) {
+        return;
+    }
+    if (term_signal == 0 && exit_status > 128) {
+        term_signal = exit_status - 128;
+    }
+    if (term_signal == SIGXCPU ||
+        (term_signal == SIGKILL && usage.user_seconds + usage.system_seconds >= limits.cpu_seconds)) {
+        usage.limit_exceeded = "cpu";
+    }
+}
+
+// Tells the model which limit stopped the script, so it doesn't retry the same thing blindly
+std::string limit_note(const ResourceUsage& usage, const ResourceLimits& limits) {
+    if (usage.limit_exceeded == "cpu") {
+        return "CPU time limit of " + format_seconds(std::chrono::milliseconds(
+            static_cast<long long>(limits.cpu_seconds * 1000))) + " per process exceeded.";
+    }
+    if (usage.limit_exceeded == "memory") {
+        return "Memory limit of " + std::to_string(limits.memory_bytes / (1024 * 1024)) +
+               " MB exceeded; the largest process was killed.";
+    }
+    if (usage.limit_exceeded == "processes") {
+        return "Process limit of " + std::to_string(limits.max_processes) + " reached; starting more processes failed.";
+    }
+    return "";
+}
 
-    // Determine file extension and command based on shell type
-    std::string ext;
-    std::string command_prefix;
+} // namespace
 
+std::string execute_shell_code(const std::string& shell_name, const std::string& code, std::chrono::milliseconds timeout,
+                               const ResourceLimits& limits, const OutputCapture::Options& output) {
+    TraceSpan span("shell.execute", "tool");
+    // The shell reads the script from a descriptor: bash takes it as its script file, pwsh reads
+    // it into a script block (-File insists on a .ps1 extension). Unknown shells default to bash.
+    // -Command would exit with 1 whenever the script's last statement failed; the trailing "exit 0"
+    // keeps -File's exit status instead: 0 on normal completion, N for "exit N", 1 on a terminating error.
+    std::vector<const char*> argv;
     if (shell_name == "powershell") {
-        ext = ".ps1";
-        command_prefix = "pwsh -ExecutionPolicy Bypass -File";
-    } else if (shell_name == "bash") {
-        ext = ".sh";
-        command_prefix = "bash";
+        argv = {"pwsh", "-ExecutionPolicy", "Bypass", "-Command",
+                "& ([ScriptBlock]::Create([IO.File]::ReadAllText('/dev/fd/3'))); exit 0"};
     } else {
-        // Default to bash for unknown shell types on Unix systems
-        ext = ".sh";
-        command_prefix = "bash";
+        argv = {"bash", kScriptPath};
     }
+    argv.push_back(nullptr);
+    std::string command = argv[0];
 
-    fs::path temp_file_path = temp_dir / (temp_filename + ext);
-    
-    try {
-        // Write to temporary file
-        {
-            std::ofstream temp_file(temp_file_path, std::ios::out);
-            if (!temp_file.is_open()) {
-                throw std::runtime_error("Could not create temporary file for shell execution.");
-            }
+    std::string script = code;
+    if (!script.empty() && script.back() != '\n') {
+        script += '\n';
+    }
 
-            // Add appropriate shebang for shell scripts
-            if (shell_name == "bash" || (shell_name != "powershell" && ext == ".sh")) {
-                temp_file << "#!/bin/bash\n";
-            }
+    int stdout_fds[2];
+    int stderr_fds[2];
+    if (!open_pipe(stdout_fds)) {
+        throw std::runtime_error("Failed to create pipe for command: " + command);
+    }
+    if (!open_pipe(stderr_fds)) {
+        close(stdout_fds[0]);
+        close(stdout_fds[1]);
+        throw std::runtime_error("Failed to create pipe for command: " + command);
+    }
 
-            // Write code maintaining original format
-            // Ensure code ends with newline to avoid execution issues
-            temp_file << code;
-            if (!code.empty() && code.back() != '\n') {
-                temp_file << '\n';
-            }
+    // Without memfd the script goes through a pipe that the read loop below keeps filling. With limits
+    // the pipe is used on purpose: the shell blocks on it until the limits are in place.
+    int script_fd = limits.applies_to_processes() ? -1 : script_memfd(script);
+    int feed_fd = -1;
+    if (script_fd < 0) {
+        int script_fds[2];
+        if (!open_pipe(script_fds)) {
+            for (int fd : {stdout_fds[0], stdout_fds[1], stderr_fds[0], stderr_fds[1]}) close(fd);
+            throw std::runtime_error("Failed to create pipe for command: " + command);
         }
-        
-        // Set execution permissions
-        fs::permissions(temp_file_path, fs::perms::owner_read | fs::perms::owner_write | fs::perms::owner_exec);
+        script_fd = script_fds[0];
+        feed_fd = script_fds[1];
+        fcntl(feed_fd, F_SETFL, fcntl(feed_fd, F_GETFL) | O_NONBLOCK);
+    }
+    script_fd = move_fd_above(script_fd, kScriptFd);
 
-        // Build execution command
-        std::string command = command_prefix + " \"" + temp_file_path.string() + "\"";
-        
-        std::array<char, 128> buffer;
-        std::string result;
-        int exit_code = 0;
-        
-        // Redirect stderr to a temporary file to capture it separately
-        fs::path stderr_path = temp_dir / (temp_filename + "_stderr.txt");
-        command += " 2> \"" + stderr_path.string() + "\"";
+    auto started = std::chrono::steady_clock::now();
 
-        std::unique_ptr<FILE, decltype(&pclose)> pipe(popen(command.c_str(), "r"), pclose);
-        if (!pipe) {
-            fs::remove(temp_file_path);
-            fs::remove(stderr_path);
-            throw std::runtime_error("Failed to execute command: " + command);
-        }
+    // Run it in its own process group so a timeout can kill everything the script started
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, stdout_fds[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, stderr_fds[1], STDERR_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, script_fd, kScriptFd);
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETPGROUP);
+    posix_spawnattr_setpgroup(&attributes, 0);
 
-        while (fgets(buffer.data(), buffer.size(), pipe.get()) != nullptr) {
-            result += buffer.data();
+    pid_t pid = 0;
+    int spawn_error = script_fd < 0 ? errno :
+        posix_spawnp(&pid, argv[0], &actions, &attributes, const_cast<char* const*>(argv.data()), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attributes);
+    close(stdout_fds[1]);
+    close(stderr_fds[1]);
+    if (script_fd >= 0) {
+        close(script_fd);
+    }
+    if (spawn_error != 0) {
+        close(stdout_fds[0]);
+        close(stderr_fds[0]);
+        if (feed_fd >= 0) {
+            close(feed_fd);
         }
-        
-        exit_code = pclose(pipe.get());
+        throw std::runtime_error("Failed to execute command: " + command + " (" + std::strerror(spawn_error) + ")");
+    }
 
-        // Read stderr
-        std::string stderr_str;
-        std::ifstream stderr_file(stderr_path);
-        if (stderr_file) {
-            stderr_str.assign((std::istreambuf_iterator<char>(stderr_file)),
-                              (std::istreambuf_iterator<char>()));
-        }
+    // The shell hasn't read a byte of the script yet, so everything it starts inherits the limits
+    std::unique_ptr<CgroupLeaf> cgroup = CgroupLeaf::create(limits);
+    if (cgroup && !cgroup->add(pid)) {
+        cgroup.reset();
+    }
+    apply_rlimits(pid, limits, cgroup != nullptr);
 
-        // Clean up temporary files
-        fs::remove(temp_file_path);
-        fs::remove(stderr_path);
+    // On timeout: SIGTERM to the whole group first, then SIGKILL if anything is still around
+    std::atomic<int> kill_attempts{0};
+    uint64_t deadline = 0;
+    if (timeout > std::chrono::milliseconds::zero()) {
+        deadline = Watchdog::instance().arm(timeout, [pid, &kill_attempts]() {
+            killpg(pid, kill_attempts++ == 0 ? SIGTERM : SIGKILL);
+        }, kKillGrace);
+    }
 
-        // Remove trailing newlines if present from stdout and stderr
-        while (!result.empty() && (result.back() == '\n' || result.back() == '\r')) {
-            result.pop_back();
+    // Drain stdout and stderr together (and keep feeding the script pipe) until both are closed.
+    // Only the head and tail of each stream stay in memory; the rest goes to a spill file.
+    OutputCapture stdout_capture(output, "stdout");
+    OutputCapture stderr_capture(output, "stderr");
+    std::array<char, 65536> buffer;
+    size_t script_written = 0;
+    int stdout_fd = stdout_fds[0];
+    int stderr_fd = stderr_fds[0];
+    while (stdout_fd >= 0 || stderr_fd >= 0) {
+        pollfd fds[3];
+        nfds_t count = 0;
+        for (int fd : {stdout_fd, stderr_fd}) {
+            if (fd >= 0) fds[count++] = {fd, POLLIN, 0};
         }
-        while (!stderr_str.empty() && (stderr_str.back() == '\n' || stderr_str.back() == '\r')) {
-            stderr_str.pop_back();
+        if (feed_fd >= 0) fds[count++] = {feed_fd, POLLOUT, 0};
+        if (poll(fds, count, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
         }
-
-        nlohmann::json result_json;
-        if (WIFEXITED(exit_code) && WEXITSTATUS(exit_code) == 0 && stderr_str.empty()) {
-            result_json["status"] = "success";
-            result_json["output"] = result.empty() ? "[No output]" : result;
-        } else {
-            result_json["status"] = "error";
-            std::string error_output = result;
-            if (!stderr_str.empty()) {
-                if(!error_output.empty()) error_output += "\n--- STDERR ---\n";
-                error_output += stderr_str;
-            }
-            if (WIFEXITED(exit_code)) {
-                int status = WEXITSTATUS(exit_code);
-                if (status != 0) {
-                    if (!error_output.empty()) error_output += "\n";
-                    error_output += "Process exited with status: " + std::to_string(status);
+        for (nfds_t i = 0; i < count; ++i) {
+            if (fds[i].revents == 0) continue;
+            if (fds[i].fd == feed_fd) {
+                ssize_t n = write_script(feed_fd, script.data() + script_written, script.size() - script_written);
+                if (n > 0) {
+                    script_written += static_cast<size_t>(n);
                 }
-            } else if (WIFSIGNALED(exit_code)) {
-                 if (!error_output.empty()) error_output += "\n";
-                 error_output += "Process terminated by signal: " + std::to_string(WTERMSIG(exit_code));
+                if (script_written == script.size() || (n < 0 && errno != EINTR && errno != EAGAIN)) {
+                    close(feed_fd);
+                    feed_fd = -1;
+                }
+                continue;
+            }
+            int& fd = fds[i].fd == stdout_fd ? stdout_fd : stderr_fd;
+            OutputCapture& target = fds[i].fd == stdout_fd ? stdout_capture : stderr_capture;
+            ssize_t n = read(fd, buffer.data(), buffer.size());
+            if (n > 0) {
+                target.append(std::string_view(buffer.data(), static_cast<size_t>(n)));
+            } else if (n == 0 || errno != EINTR) {
+                close(fd);
+                fd = -1;
             }
-            result_json["output"] = error_output;
         }
+    }
+    for (int fd : {stdout_fd, stderr_fd, feed_fd}) {
+        if (fd >= 0) close(fd);
+    }
 
-        return result_json.dump();
-        
-    } catch (...) {
-        // Ensure temporary file is deleted even on exception
-        fs::remove(temp_file_path);
-        // Also remove stderr temp file on error
-        fs::path stderr_path = temp_dir / (temp_filename + "_stderr.txt");
-        if (fs::exists(stderr_path)) {
-            fs::remove(stderr_path);
-        }
-        throw;
+    // The group leader isn't reaped until waitpid, so its group id can't be reused before disarm() returns
+    if (deadline) {
+        Watchdog::instance().disarm(deadline);
+    }
+    bool timed_out = kill_attempts > 0;
+    int exit_code = 0;
+    struct rusage rusage {};
+    while (wait4(pid, &exit_code, 0, &rusage) < 0 && errno == EINTR) {
+    }
+
+    // rusage covers the shell and the children it waited for; the cgroup also sees those it didn't
+    ResourceUsage usage;
+    usage.wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    usage.output_bytes = stdout_capture.total_bytes() + stderr_capture.total_bytes();
+    std::string result = stdout_capture.str();
+    std::string stderr_str = stderr_capture.str();
+    fill_from_rusage(usage, rusage);
+    if (cgroup) {
+        cgroup->read_usage(usage);
+    }
+    int exit_status = WIFEXITED(exit_code) ? WEXITSTATUS(exit_code) : 0;
+    int term_signal = WIFSIGNALED(exit_code) ? WTERMSIG(exit_code) : 0;
+    note_exceeded_limit(usage, limits, exit_status, term_signal);
+
+    if (timed_out) {
+        return attach_resources(
+            timeout_result(join_output(trim_trailing_newlines(result), trim_trailing_newlines(stderr_str)), timeout,
+                           "Process exceeded its time limit of " + format_seconds(timeout) +
+                           " and was killed along with its child processes."),
+            shell_name, usage);
+    }
+    return attach_resources(shell_result(std::move(result), std::move(stderr_str), exit_status, term_signal,
+                                         limit_note(usage, limits)),
+                            shell_name, usage);
+}
+
+std::string execute_shell_session(BashSessionPool& sessions, const std::string& session, const std::string& code,
+                                  std::chrono::milliseconds timeout) {
+    TraceSpan span("bash.execute", "tool");
+    BashSessionPool::Run run = sessions.run(session, code, timeout);
+    std::string key = session.empty() ? "bash" : "bash:" + session;
+    if (run.timed_out) {
+        return attach_resources(
+            timeout_result(join_output(trim_trailing_newlines(run.output), trim_trailing_newlines(run.errors)), timeout,
+                           "Command exceeded its time limit of " + format_seconds(timeout) +
+                           " and was killed along with its bash session and every process started in it; "
+                           "the next call starts a new session (working directory, variables and functions are reset)."),
+            key, run.usage);
+    }
+    note_exceeded_limit(run.usage, sessions.limits(), run.exit_status, run.term_signal);
+    std::string note = limit_note(run.usage, sessions.limits());
+    if (run.ended) {
+        if (!note.empty()) note += "\n";
+        note += "The bash session ended; the next call starts a new one "
+                "(working directory, variables and functions are reset).";
     }
+    return attach_resources(shell_result(std::move(run.output), std::move(run.errors), run.exit_status, run.term_signal,
+                                         note),
+                            key, run.usage);
 }
 #endif
@@ -0,0 +1,180 @@
+#include "ContextManager.h"
+#include "Color.h"
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+    // 每条消息在聊天模板中的固定开销（角色标记、分隔符等）的近似值
+    constexpr size_t kMessageOverheadTokens = 4;
+
+    bool is_continuation_byte(char c) {
+        return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+    }
+
+    bool has_role(const nlohmann::json& message, const char* role) {
+        return message.contains("role") && message["role"] == role;
+    }
+}
+
+ContextManager::ContextManager(const nlohmann::json& config) {
+    if (!config.contains("context")) {
+        return;
+    }
+    const auto& context = config["context"];
+    if (context.contains("max_prompt_tokens")) {
+        max_prompt_tokens = context["max_prompt_tokens"].get<size_t>();
+    }
+    if (context.contains("tool_output_head_chars")) {
+        head_chars = context["tool_output_head_chars"].get<size_t>();
+    }
+    if (context.contains("tool_output_tail_chars")) {
+        tail_chars = context["tool_output_tail_chars"].get<size_t>();
+    }
+    if (context.contains("keep_recent_turns")) {
+        // 当前轮次的工具结果必须完整地发送给模型，因此至少保留一轮
+        keep_recent_turns = std::max<size_t>(1, context["keep_recent_turns"].get<size_t>());
+    }
+    if (context.contains("tokenizer_vocab") && context["tokenizer_vocab"].is_string() &&
+        !context["tokenizer_vocab"].get<std::string>().empty()) {
+        try {
+            tokenizer.load(context["tokenizer_vocab"].get<std::string>());
+        } catch (const std::exception& e) {
+            std::cerr << Color::YELLOW << "[Context] " << e.what()
+                      << ". Falling back to byte-based token estimates." << Color::RESET << std::endl;
+        }
+    }
+}
+
+CompactionReport ContextManager::enforce(ConversationHistory& history) {
+    CompactionReport report;
+
+    // 同步缓存：只为新追加的消息计数
+    if (token_counts.size() > history.size()) {
+        token_counts.clear();
+    }
+    size_t total = 0;
+    for (size_t i = 0; i < history.size(); ++i) {
+        if (i >= token_counts.size()) {
+            token_counts.push_back(message_tokens(history[i]));
+        }
+        total += token_counts[i];
+    }
+    report.tokens_before = total;
+    report.tokens_after = total;
+    if (!enabled() || total <= max_prompt_tokens) {
+        return report;
+    }
+
+    size_t first = (!history.empty() && has_role(history[0], "system")) ? 1 : 0;
+
+    // 最近 keep_recent_turns 轮从这个位置开始，不做任何修改
+    size_t protected_start = first;
+    size_t turns_seen = 0;
+    for (size_t i = history.size(); i-- > first;) {
+        if (has_role(history[i], "user") && ++turns_seen == keep_recent_turns) {
+            protected_start = i;
+            break;
+        }
+    }
+
+    // 第一步：从最早的开始，把工具输出压缩为首尾摘录
+    for (size_t i = first; i < protected_start && total > max_prompt_tokens; ++i) {
+        const auto& message = history[i];
+        if (!has_role(message, "tool") || !message.contains("content") || !message["content"].is_string() ||
+            message["content"].get_ref<const std::string&>().size() <= head_chars + tail_chars) {
+            continue;
+        }
+        nlohmann::json compacted = compact_tool_message(message);
+        size_t tokens = message_tokens(compacted);
+        if (tokens >= token_counts[i]) {
+            continue;
+        }
+        history.replace(i, std::move(compacted));
+        total -= token_counts[i] - tokens;
+        token_counts[i] = tokens;
+        ++report.compacted_outputs;
+    }
+
+    // 第二步：仍然超出预算时，从最早的轮次开始整轮删除
+    while (total > max_prompt_tokens && first < protected_start) {
+        size_t end = first + 1;
+        while (end < protected_start && !has_role(history[end], "user")) {
+            ++end;
+        }
+        for (size_t i = first; i < end; ++i) {
+            total -= token_counts[i];
+        }
+        token_counts.erase(token_counts.begin() + static_cast<std::ptrdiff_t>(first),
+                           token_counts.begin() + static_cast<std::ptrdiff_t>(end));
+        history.erase(first, end);
+        report.dropped_messages += end - first;
+        protected_start -= end - first;
+    }
+
+    report.tokens_after = total;
+    return report;
+}
+
+size_t ContextManager::message_tokens(const nlohmann::json& message) const {
+    size_t tokens = kMessageOverheadTokens;
+    if (message.contains("content") && message["content"].is_string()) {
+        tokens += tokenizer.count(message["content"].get_ref<const std::string&>());
+    }
+    if (message.contains("tool_calls") && message["tool_calls"].is_array()) {
+        for (const auto& call : message["tool_calls"]) {
+            tokens += kMessageOverheadTokens;
+            if (call.contains("function")) {
+                const auto& function = call["function"];
+                if (function.contains("name") && function["name"].is_string()) {
+                    tokens += tokenizer.count(function["name"].get_ref<const std::string&>());
+                }
+                if (function.contains("arguments") && function["arguments"].is_string()) {
+                    tokens += tokenizer.count(function["arguments"].get_ref<const std::string&>());
+                }
+            }
+        }
+    }
+    return tokens;
+}
+
+std::string ContextManager::excerpt(const std::string& text) const {
+    if (text.size() <= head_chars + tail_chars) {
+        return text;
+    }
+    // 在UTF-8字符边界处截断
+    size_t head_end = head_chars;
+    while (head_end > 0 && is_continuation_byte(text[head_end])) {
+        --head_end;
+    }
+    size_t tail_start = text.size() - tail_chars;
+    while (tail_start < text.size() && is_continuation_byte(text[tail_start])) {
+        ++tail_start;
+    }
+
+    size_t omitted_lines = 0;
+    for (size_t i = head_end; i < tail_start; ++i) {
+        if (text[i] == '\n') ++omitted_lines;
+    }
+    return text.substr(0, head_end) + "\n\n[... " + std::to_string(tail_start - head_end) + " bytes, " +
+           std::to_string(omitted_lines) + " lines omitted to fit the context budget ...]\n\n" + text.substr(tail_start);
+}
+
+nlohmann::json ContextManager::compact_tool_message(const nlohmann::json& message) const {
+    nlohmann::json compacted = message;
+    const std::string& content = message["content"].get_ref<const std::string&>();
+
+    // 工具结果通常是 {"status": ..., "output": ...}，只截取 output 以保持结构
+    try {
+        nlohmann::json result = nlohmann::json::parse(content);
+        if (result.is_object() && result.contains("output") && result["output"].is_string()) {
+            result["output"] = excerpt(result["output"].get<std::string>());
+            compacted["content"] = result.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+            return compacted;
+        }
+    } catch (const nlohmann::json::parse_error&) {
+        // 不是JSON，按普通文本处理
+    }
+    compacted["content"] = excerpt(content);
+    return compacted;
+}
@@ -0,0 +1,78 @@
+#include "ConversationHistory.h"
+#include <algorithm>
+
+ConversationHistory::ConversationHistory(std::string system_suffix)
+    : system_suffix(std::move(system_suffix)) {}
+
+void ConversationHistory::push_back(nlohmann::json message) {
+    std::string serialized = serialize(entries.size(), message);
+    if (!joined.empty()) {
+        joined.push_back(',');
+    }
+    size_t offset = joined.size();
+    joined += serialized;
+    entries.push_back({std::move(message), std::move(serialized), offset});
+}
+
+void ConversationHistory::replace(size_t index, nlohmann::json message) {
+    Entry& entry = entries.at(index);
+    entry.serialized = serialize(index, message);
+    entry.message = std::move(message);
+    rejoin_from(index);
+}
+
+void ConversationHistory::erase(size_t first, size_t last) {
+    if (first >= last || first >= entries.size()) {
+        return;
+    }
+    last = std::min(last, entries.size());
+    entries.erase(entries.begin() + static_cast<std::ptrdiff_t>(first), entries.begin() + static_cast<std::ptrdiff_t>(last));
+    // 删除了首条消息时，新的首条消息需要按首条的规则重新序列化
+    if (first == 0 && !entries.empty()) {
+        entries[0].serialized = serialize(0, entries[0].message);
+    }
+    rejoin_from(first);
+}
+
+void ConversationHistory::rejoin_from(size_t index) {
+    if (index >= entries.size()) {
+        joined.resize(index == 0 || entries.empty() ? 0 : entries.back().offset + entries.back().serialized.size());
+        return;
+    }
+    // 保留 index 之前的片段，只重新拼接之后的部分
+    joined.resize(index == 0 ? 0 : entries[index - 1].offset + entries[index - 1].serialized.size());
+    for (size_t i = index; i < entries.size(); ++i) {
+        if (!joined.empty()) {
+            joined.push_back(',');
+        }
+        entries[i].offset = joined.size();
+        joined += entries[i].serialized;
+    }
+}
+
+std::string ConversationHistory::request_body(std::string_view payload_prefix) const {
+    std::string body;
+    body.reserve(payload_prefix.size() + joined.size() + 2);
+    body.append(payload_prefix.data(), payload_prefix.size());
+    body += joined;
+    body += "]}";
+    return body;
+}
+
+namespace {
+    // 工具输出可能包含非法UTF-8，用替换字符代替而不是在发送时抛出异常
+    std::string dump_message(const nlohmann::json& message) {
+        return message.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+    }
+}
+
+std::string ConversationHistory::serialize(size_t index, const nlohmann::json& message) const {
+    // 只有首条系统消息需要在发送时追加后缀
+    if (index == 0 && !system_suffix.empty() && message.contains("role") && message["role"] == "system" &&
+        message.contains("content") && message["content"].is_string()) {
+        nlohmann::json wire_message = message;
+        wire_message["content"] = message["content"].get<std::string>() + system_suffix;
+        return dump_message(wire_message);
+    }
+    return dump_message(message);
+}
@@ -0,0 +1,89 @@
+#include "ImportProfile.h"
+#include "Utils.h"
+#include <algorithm>
+#include <fstream>
+#include <nlohmann/json.hpp>
+
+namespace {
+    // 文件格式变化时递增，旧文件会被忽略
+    constexpr int kProfileFormat = 1;
+}
+
+ImportProfile::ImportProfile(std::string path) : path(std::move(path)) {
+    if (this->path.empty()) {
+        return;
+    }
+    std::ifstream file(this->path);
+    if (!file) {
+        return;
+    }
+    try {
+        nlohmann::json profile = nlohmann::json::parse(file);
+        if (profile.value("format", 0) != kProfileFormat || !profile.contains("modules") ||
+            !profile["modules"].is_object()) {
+            return;
+        }
+        for (const auto& [module, sessions] : profile["modules"].items()) {
+            if (sessions.is_number_unsigned()) {
+                sessions_by_module[module] = sessions.get<size_t>();
+            }
+        }
+    } catch (const std::exception&) {
+        sessions_by_module.clear(); // 损坏的文件等同于没有记录
+    }
+}
+
+std::vector<std::string> ImportProfile::most_frequent(size_t max_modules, size_t min_sessions) const {
+    std::vector<std::pair<std::string, size_t>> candidates;
+    for (const auto& entry : sessions_by_module) {
+        if (entry.second >= min_sessions) {
+            candidates.push_back(entry);
+        }
+    }
+    // 会话数相同时按名字排序，结果是确定的
+    std::stable_sort(candidates.begin(), candidates.end(), [](const auto& a, const auto& b) {
+        return a.second > b.second;
+    });
+
+    std::vector<std::string> modules;
+    for (size_t i = 0; i < candidates.size() && i < max_modules; ++i) {
+        modules.push_back(candidates[i].first);
+    }
+    return modules;
+}
+
+bool ImportProfile::record(const std::string& module) {
+    if (!recorded_this_session.insert(module).second) {
+        return false;
+    }
+    sessions_by_module[module] += 1;
+    return true;
+}
+
+void ImportProfile::save() const {
+    if (path.empty()) {
+        return;
+    }
+
+    std::vector<std::pair<std::string, size_t>> entries(sessions_by_module.begin(), sessions_by_module.end());
+    if (entries.size() > kMaxEntries) {
+        // 优先保留本次会话用到的模块，否则新出现的模块永远积累不到足够的计数
+        std::stable_sort(entries.begin(), entries.end(), [this](const auto& a, const auto& b) {
+            bool a_current = recorded_this_session.count(a.first) > 0;
+            bool b_current = recorded_this_session.count(b.first) > 0;
+            if (a_current != b_current) {
+                return a_current;
+            }
+            return a.second > b.second;
+        });
+        entries.resize(kMaxEntries);
+    }
+
+    nlohmann::json profile;
+    profile["format"] = kProfileFormat;
+    profile["modules"] = nlohmann::json::object();
+    for (const auto& [module, sessions] : entries) {
+        profile["modules"][module] = sessions;
+    }
+    write_file_atomically(path, profile.dump(2));
+}
@@ -0,0 +1,113 @@
+#include "LiveOutput.h"
+#include "Color.h"
+#include <cstdio>
+
+LiveOutput::LiveOutput(std::chrono::milliseconds flush_interval, size_t max_pending_bytes)
+    : flush_interval(flush_interval), max_pending_bytes(max_pending_bytes) {
+    flusher = std::thread([this]() { flusher_loop(); });
+}
+
+LiveOutput::~LiveOutput() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cv.notify_all();
+    if (flusher.joinable()) {
+        flusher.join();
+    }
+}
+
+void LiveOutput::write(std::string_view text, bool is_stderr) {
+    if (text.empty()) {
+        return;
+    }
+    bool was_empty;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (pending.size() + text.size() > max_pending_bytes) {
+            dropped_bytes += text.size();
+            return;
+        }
+        was_empty = pending.empty();
+        if (!section_open) {
+            pending += "\n\n--- Live output ---\n";
+            section_open = true;
+        }
+        if (is_stderr != pending_is_stderr) {
+            pending += is_stderr ? Color::RED : Color::RESET;
+            pending_is_stderr = is_stderr;
+        }
+        pending.append(text.data(), text.size());
+        last_was_newline = text.back() == '\n';
+    }
+    // 刷新线程只在缓冲区从空变为非空时需要唤醒，其余情况它会在下一个间隔自己来取
+    if (was_empty) {
+        cv.notify_one();
+    }
+}
+
+void LiveOutput::hold() {
+    std::lock_guard<std::mutex> lock(mutex);
+    held = true;
+}
+
+void LiveOutput::release() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        held = false;
+    }
+    cv.notify_one();
+}
+
+void LiveOutput::flush() {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!pending.empty() || dropped_bytes > 0) {
+        write_pending(lock);
+    }
+    if (section_open) {
+        if (!last_was_newline) {
+            pending += "\n";
+            write_pending(lock);
+        }
+        section_open = false;
+        last_was_newline = true;
+    }
+}
+
+void LiveOutput::flusher_loop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        cv.wait(lock, [this]() { return stopping || (!pending.empty() && !held); });
+        if (!pending.empty() || dropped_bytes > 0) {
+            write_pending(lock);
+        }
+        if (stopping) {
+            return;
+        }
+        // 限速：距离上一次写终端至少间隔 flush_interval
+        cv.wait_for(lock, flush_interval, [this]() { return stopping; });
+    }
+}
+
+void LiveOutput::write_pending(std::unique_lock<std::mutex>& lock) {
+    std::string chunk;
+    chunk.swap(pending);
+    if (pending_is_stderr) {
+        chunk += Color::RESET;
+        pending_is_stderr = false;
+    }
+    if (dropped_bytes > 0) {
+        chunk += Color::YELLOW + "\n[... " + std::to_string(dropped_bytes) +
+                 " bytes of live output not shown ...]\n" + Color::RESET;
+        dropped_bytes = 0;
+    }
+
+    // 在持有 mutex 时取得写锁，保证各段按取出的顺序写到终端；写的时候不阻塞写入方
+    std::unique_lock<std::mutex> write_lock(write_mutex);
+    lock.unlock();
+    std::fwrite(chunk.data(), 1, chunk.size(), stdout);
+    std::fflush(stdout);
+    write_lock.unlock();
+    lock.lock();
+}
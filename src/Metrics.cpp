@@ -0,0 +1,433 @@
+#include "Metrics.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+
+namespace {
+    // 导出时使用的说明；没有列出的指标用名称代替
+    const std::map<std::string, std::string> kHelp = {
+        {"request_serialize_seconds", "Time to build the request body"},
+        {"request_connect_seconds", "TCP connect and TLS handshake of requests that opened a new connection"},
+        {"request_ttfb_seconds", "Time from the start of a request to the first response byte"},
+        {"request_ttft_seconds", "Time from the start of a request to the first streamed text or tool call"},
+        {"request_stream_seconds", "Time from the first streamed text to the end of the response"},
+        {"request_total_seconds", "Duration of a request including streaming"},
+        {"request_tokens_per_second", "Streamed deltas per second after the first one"},
+        {"request_payload_bytes", "Size of the request body"},
+        {"response_bytes", "Size of the response body"},
+        {"tool_seconds", "Execution time of a tool call"},
+        {"turn_seconds", "Time from user input to the final reply"},
+        {"turn_api_seconds", "Time spent in API requests during a turn"},
+        {"turn_tool_wait_seconds", "Time a turn waited for tool results after a reply ended"},
+        {"turn_requests", "API requests per turn"},
+    };
+
+    const double kQuantiles[] = {0.5, 0.9, 0.99, 0.999};
+
+    // 直方图中保存的整数与实际值之间的比例
+    double resolution(MetricUnit unit) {
+        switch (unit) {
+        case MetricUnit::Seconds: return 1e-6;
+        case MetricUnit::PerSecond: return 1e-3;
+        default: return 1.0;
+        }
+    }
+
+    std::string format_value(MetricUnit unit, double value) {
+        char text[32];
+        switch (unit) {
+        case MetricUnit::Seconds:
+            if (value < 1.0) {
+                std::snprintf(text, sizeof(text), "%.1f ms", value * 1000.0);
+            } else {
+                std::snprintf(text, sizeof(text), "%.2f s", value);
+            }
+            break;
+        case MetricUnit::Bytes:
+            if (value < 1024.0) {
+                std::snprintf(text, sizeof(text), "%.0f B", value);
+            } else {
+                std::snprintf(text, sizeof(text), "%.1f KB", value / 1024.0);
+            }
+            break;
+        case MetricUnit::Count:
+            std::snprintf(text, sizeof(text), "%.0f", value);
+            break;
+        case MetricUnit::PerSecond:
+            std::snprintf(text, sizeof(text), "%.1f/s", value);
+            break;
+        }
+        return text;
+    }
+
+    std::string escape_label(const std::string& value) {
+        std::string escaped;
+        for (char c : value) {
+            if (c == '\\' || c == '"') {
+                escaped += '\\';
+                escaped += c;
+            } else if (c == '\n') {
+                escaped += "\\n";
+            } else {
+                escaped += c;
+            }
+        }
+        return escaped;
+    }
+
+    // 保留到 1/per_unit（例如 1e6 为微秒）
+    double round_to(double value, double per_unit) {
+        return std::round(value * per_unit) / per_unit;
+    }
+}
+
+// --- Histogram ---
+
+size_t Histogram::index_of(uint64_t value) {
+    const uint64_t sub_buckets = uint64_t{1} << kSubBucketBits;
+    if (value < sub_buckets) {
+        return static_cast<size_t>(value);
+    }
+    int msb = kSubBucketBits;
+    while (msb < 63 && (value >> (msb + 1)) != 0) {
+        ++msb;
+    }
+    int shift = msb - kSubBucketBits;
+    // 每个 2 的幂区间 [2^msb, 2^(msb+1)) 对应 sub_buckets 个宽度为 2^shift 的桶
+    return static_cast<size_t>((shift + 1) * sub_buckets + ((value >> shift) - sub_buckets));
+}
+
+uint64_t Histogram::lowest_of(size_t index) {
+    const uint64_t sub_buckets = uint64_t{1} << kSubBucketBits;
+    uint64_t magnitude = index / sub_buckets;
+    uint64_t offset = index % sub_buckets;
+    if (magnitude == 0) {
+        return offset;
+    }
+    return (sub_buckets + offset) << (magnitude - 1);
+}
+
+uint64_t Histogram::highest_of(size_t index) {
+    const uint64_t sub_buckets = uint64_t{1} << kSubBucketBits;
+    uint64_t magnitude = index / sub_buckets;
+    return lowest_of(index) + (magnitude == 0 ? 0 : (uint64_t{1} << (magnitude - 1)) - 1);
+}
+
+void Histogram::record(uint64_t value) {
+    const uint64_t max_trackable = uint64_t{1} << kMaxValueBits;
+    if (counts.empty()) {
+        counts.assign(index_of(max_trackable) + 1, 0);
+    }
+    value = std::min(value, max_trackable);
+    counts[index_of(value)]++;
+    total++;
+    total_sum += static_cast<double>(value);
+    min_value = std::min(min_value, value);
+    max_value = std::max(max_value, value);
+}
+
+uint64_t Histogram::value_at(double quantile) const {
+    if (total == 0) {
+        return 0;
+    }
+    quantile = std::clamp(quantile, 0.0, 1.0);
+    uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(quantile * static_cast<double>(total))));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts.size(); ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+            uint64_t middle = lowest_of(i) + (highest_of(i) - lowest_of(i)) / 2;
+            return std::clamp(middle, min_value, max_value);
+        }
+    }
+    return max_value;
+}
+
+// --- Metrics ---
+
+Metrics::Metrics() : started(std::chrono::system_clock::now()) {
+}
+
+Metrics& Metrics::instance() {
+    static Metrics metrics;
+    return metrics;
+}
+
+void Metrics::record(const std::string& name, MetricUnit unit, double value, const std::string& tool) {
+    if (!(value >= 0)) {
+        return; // 负数和 NaN
+    }
+    uint64_t scaled = static_cast<uint64_t>(std::llround(value / resolution(unit)));
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = series.find({name, tool});
+    if (it == series.end()) {
+        it = series.emplace(std::make_pair(name, tool), Series{unit, Histogram()}).first;
+    }
+    it->second.histogram.record(scaled);
+    records++;
+}
+
+void Metrics::record_request(const RequestTimings& timings) {
+    record("request_serialize_seconds", MetricUnit::Seconds, timings.serialize_ms / 1000.0);
+    if (!timings.reused_connection) {
+        record("request_connect_seconds", MetricUnit::Seconds, std::max(timings.connect_ms, timings.tls_ms) / 1000.0);
+    }
+    record("request_ttfb_seconds", MetricUnit::Seconds, timings.ttfb_ms / 1000.0);
+    if (timings.output_tokens > 0) {
+        record("request_ttft_seconds", MetricUnit::Seconds, timings.ttft_ms / 1000.0);
+        record("request_stream_seconds", MetricUnit::Seconds, timings.stream_ms / 1000.0);
+    }
+    if (timings.tokens_per_second > 0) {
+        record("request_tokens_per_second", MetricUnit::PerSecond, timings.tokens_per_second);
+    }
+    record("request_total_seconds", MetricUnit::Seconds, timings.total_ms / 1000.0);
+    record("request_payload_bytes", MetricUnit::Bytes, static_cast<double>(timings.request_bytes));
+    record("response_bytes", MetricUnit::Bytes, static_cast<double>(timings.response_bytes));
+}
+
+void Metrics::set_last_turn(nlohmann::json breakdown) {
+    std::lock_guard<std::mutex> lock(mutex);
+    last_turn = std::move(breakdown);
+    records++;
+}
+
+uint64_t Metrics::generation() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return records;
+}
+
+std::string Metrics::summary() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (series.empty()) {
+        return "No requests yet.\n";
+    }
+    std::ostringstream out;
+    char line[256];
+    std::snprintf(line, sizeof(line), "%-28s %-8s %6s %11s %11s %11s %11s\n", "Metric", "Tool", "Count", "p50", "p90",
+                  "p99", "Max");
+    out << line;
+    for (const auto& [key, entry] : series) {
+        const Histogram& h = entry.histogram;
+        double scale = resolution(entry.unit);
+        std::snprintf(line, sizeof(line), "%-28s %-8s %6llu %11s %11s %11s %11s\n", key.first.c_str(),
+                      key.second.empty() ? "-" : key.second.c_str(), static_cast<unsigned long long>(h.count()),
+                      format_value(entry.unit, h.value_at(0.5) * scale).c_str(),
+                      format_value(entry.unit, h.value_at(0.9) * scale).c_str(),
+                      format_value(entry.unit, h.value_at(0.99) * scale).c_str(),
+                      format_value(entry.unit, h.max() * scale).c_str());
+        out << line;
+    }
+
+    if (!last_turn.is_null()) {
+        const auto& turn = last_turn;
+        out << "\nLast turn: " << format_value(MetricUnit::Seconds, turn["total_seconds"].get<double>()) << " total, "
+            << turn["requests"].get<size_t>() << " request(s) taking "
+            << format_value(MetricUnit::Seconds, turn["api_seconds"].get<double>()) << "\n";
+        out << "  serialize " << format_value(MetricUnit::Seconds, turn["serialize_seconds"].get<double>())
+            << ", connect " << format_value(MetricUnit::Seconds, turn["connect_seconds"].get<double>())
+            << ", ttfb " << format_value(MetricUnit::Seconds, turn["ttfb_seconds"].get<double>())
+            << ", ttft " << format_value(MetricUnit::Seconds, turn["ttft_seconds"].get<double>())
+            << ", streaming " << format_value(MetricUnit::Seconds, turn["stream_seconds"].get<double>()) << "\n";
+        out << "  " << turn["output_tokens"].get<size_t>() << " tokens at "
+            << format_value(MetricUnit::PerSecond, turn["tokens_per_second"].get<double>()) << ", sent "
+            << format_value(MetricUnit::Bytes, turn["payload_bytes"].get<double>()) << "\n";
+        if (!turn["tools"].empty()) {
+            out << "  tools:";
+            bool first = true;
+            for (const auto& [tool, stats] : turn["tools"].items()) {
+                out << (first ? " " : ", ") << tool << " " << stats["calls"].get<size_t>() << "x "
+                    << format_value(MetricUnit::Seconds, stats["seconds"].get<double>());
+                first = false;
+            }
+            out << "; waited " << format_value(MetricUnit::Seconds, turn["tool_wait_seconds"].get<double>())
+                << " for results after the reply\n";
+        }
+    }
+    return out.str();
+}
+
+std::string Metrics::prometheus() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::ostringstream out;
+    out.precision(9);
+    std::string current;
+    for (const auto& [key, entry] : series) {
+        const std::string name = "code_atlas_" + key.first;
+        if (key.first != current) {
+            auto help = kHelp.find(key.first);
+            out << "# HELP " << name << " " << (help != kHelp.end() ? help->second : key.first) << "\n";
+            out << "# TYPE " << name << " summary\n";
+            current = key.first;
+        }
+        std::string labels = key.second.empty() ? "" : "tool=\"" + escape_label(key.second) + "\"";
+        const Histogram& h = entry.histogram;
+        double scale = resolution(entry.unit);
+        for (double quantile : kQuantiles) {
+            out << name << "{" << labels << (labels.empty() ? "" : ",") << "quantile=\"" << quantile << "\"} "
+                << h.value_at(quantile) * scale << "\n";
+        }
+        std::string suffix = labels.empty() ? "" : "{" + labels + "}";
+        out << name << "_sum" << suffix << " " << h.sum() * scale << "\n";
+        out << name << "_count" << suffix << " " << h.count() << "\n";
+    }
+    return out.str();
+}
+
+nlohmann::json Metrics::snapshot() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto now = std::chrono::system_clock::now();
+    nlohmann::json json;
+    json["timestamp"] = std::chrono::duration_cast<std::chrono::seconds>(now.time_since_epoch()).count();
+    json["uptime_seconds"] = std::chrono::duration_cast<std::chrono::seconds>(now - started).count();
+    json["metrics"] = nlohmann::json::object();
+    for (const auto& [key, entry] : series) {
+        const Histogram& h = entry.histogram;
+        double scale = resolution(entry.unit);
+        double per_unit = entry.unit == MetricUnit::Seconds ? 1e6 : 1e3;
+        nlohmann::json item;
+        if (!key.second.empty()) {
+            item["tool"] = key.second;
+        }
+        item["count"] = h.count();
+        item["sum"] = round_to(h.sum() * scale, per_unit);
+        item["min"] = round_to(h.min() * scale, per_unit);
+        item["max"] = round_to(h.max() * scale, per_unit);
+        item["mean"] = round_to(h.count() ? h.sum() * scale / static_cast<double>(h.count()) : 0.0, per_unit);
+        item["p50"] = round_to(h.value_at(0.5) * scale, per_unit);
+        item["p90"] = round_to(h.value_at(0.9) * scale, per_unit);
+        item["p99"] = round_to(h.value_at(0.99) * scale, per_unit);
+        item["p999"] = round_to(h.value_at(0.999) * scale, per_unit);
+        json["metrics"][key.first].push_back(std::move(item));
+    }
+    if (!last_turn.is_null()) {
+        json["last_turn"] = last_turn;
+    }
+    return json;
+}
+
+// --- TurnBreakdown ---
+
+TurnBreakdown::TurnBreakdown() : start(std::chrono::steady_clock::now()) {
+}
+
+void TurnBreakdown::add_request(const RequestTimings& timings) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (requests == 0) {
+        ttft_ms = timings.ttft_ms;
+    }
+    requests++;
+    serialize_ms += timings.serialize_ms;
+    if (!timings.reused_connection) {
+        connect_ms += std::max(timings.connect_ms, timings.tls_ms);
+    }
+    ttfb_ms += timings.ttfb_ms;
+    stream_ms += timings.stream_ms;
+    api_ms += timings.total_ms;
+    output_tokens += timings.output_tokens;
+    request_bytes += timings.request_bytes;
+}
+
+void TurnBreakdown::add_tool(const std::string& tool, double seconds) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& entry = tools[tool];
+    entry.first++;
+    entry.second += seconds;
+}
+
+void TurnBreakdown::add_tool_wait(double seconds) {
+    std::lock_guard<std::mutex> lock(mutex);
+    tool_wait_seconds += seconds;
+}
+
+void TurnBreakdown::finish() {
+    double total = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    nlohmann::json breakdown;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        breakdown["total_seconds"] = round_to(total, 1e6);
+        breakdown["requests"] = requests;
+        breakdown["api_seconds"] = round_to(api_ms / 1000.0, 1e6);
+        breakdown["serialize_seconds"] = round_to(serialize_ms / 1000.0, 1e6);
+        breakdown["connect_seconds"] = round_to(connect_ms / 1000.0, 1e6);
+        breakdown["ttfb_seconds"] = round_to(ttfb_ms / 1000.0, 1e6);
+        breakdown["ttft_seconds"] = round_to(ttft_ms / 1000.0, 1e6);
+        breakdown["stream_seconds"] = round_to(stream_ms / 1000.0, 1e6);
+        breakdown["output_tokens"] = output_tokens;
+        breakdown["tokens_per_second"] = round_to(stream_ms > 0 ? output_tokens / (stream_ms / 1000.0) : 0.0, 1e3);
+        breakdown["payload_bytes"] = request_bytes;
+        breakdown["tools"] = nlohmann::json::object();
+        for (const auto& [tool, entry] : tools) {
+            breakdown["tools"][tool] = {{"calls", entry.first}, {"seconds", round_to(entry.second, 1e6)}};
+        }
+        breakdown["tool_wait_seconds"] = round_to(tool_wait_seconds, 1e6);
+    }
+
+    Metrics& metrics = Metrics::instance();
+    metrics.record("turn_seconds", MetricUnit::Seconds, total);
+    metrics.record("turn_api_seconds", MetricUnit::Seconds, breakdown["api_seconds"].get<double>());
+    metrics.record("turn_tool_wait_seconds", MetricUnit::Seconds, breakdown["tool_wait_seconds"].get<double>());
+    metrics.record("turn_requests", MetricUnit::Count, static_cast<double>(breakdown["requests"].get<size_t>()));
+    metrics.set_last_turn(std::move(breakdown));
+}
+
+// --- MetricsExporter ---
+
+MetricsExporter::MetricsExporter(const nlohmann::json& config) {
+    if (config.contains("metrics")) {
+        const auto& metrics = config["metrics"];
+        if (metrics.contains("prometheus_file") && metrics["prometheus_file"].is_string()) {
+            prometheus_file = metrics["prometheus_file"].get<std::string>();
+        }
+        if (metrics.contains("json_file") && metrics["json_file"].is_string()) {
+            json_file = metrics["json_file"].get<std::string>();
+        }
+        if (metrics.contains("export_interval_seconds")) {
+            interval = std::chrono::seconds(std::max<long>(1, metrics["export_interval_seconds"].get<long>()));
+        }
+    }
+    if (prometheus_file.empty() && json_file.empty()) {
+        return;
+    }
+    thread = std::thread([this]() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!cv.wait_for(lock, interval, [this]() { return stopping; })) {
+            lock.unlock();
+            export_now();
+            lock.lock();
+        }
+    });
+}
+
+MetricsExporter::~MetricsExporter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cv.notify_all();
+    if (thread.joinable()) {
+        thread.join();
+    }
+    export_now();
+}
+
+void MetricsExporter::export_now() {
+    if (prometheus_file.empty() && json_file.empty()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(export_mutex);
+    Metrics& metrics = Metrics::instance();
+    uint64_t generation = metrics.generation();
+    if (generation == exported_generation) {
+        return;
+    }
+    if (!prometheus_file.empty()) {
+        write_file_atomically(prometheus_file, metrics.prometheus());
+    }
+    if (!json_file.empty()) {
+        write_file_atomically(json_file, metrics.snapshot().dump(2) + "\n");
+    }
+    exported_generation = generation;
+}
@@ -0,0 +1,218 @@
+#include "OutputCapture.h"
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <mutex>
+#include <system_error>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+    bool is_continuation_byte(char c) {
+        return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+    }
+
+    int process_id() {
+#ifdef _WIN32
+        return _getpid();
+#else
+        return static_cast<int>(getpid());
+#endif
+    }
+
+    // 默认的溢出目录只属于这个进程，退出时连同其中的文件一起删除
+    class DefaultSpillDirectory {
+    public:
+        ~DefaultSpillDirectory() {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (created) {
+                std::error_code error;
+                std::filesystem::remove_all(path, error);
+            }
+        }
+
+        std::string get() {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (path.empty()) {
+                std::error_code error;
+                std::filesystem::path directory = std::filesystem::temp_directory_path(error);
+                if (error) {
+                    return "";
+                }
+                path = (directory / ("code-atlas-" + std::to_string(process_id()))).string();
+            }
+            std::error_code error;
+            if (std::filesystem::create_directories(path, error)) {
+                created = true;
+            }
+            return path;
+        }
+
+    private:
+        std::mutex mutex;
+        std::string path;
+        bool created = false;
+    };
+
+    DefaultSpillDirectory default_spill_directory;
+    std::atomic<unsigned long> spill_counter{0};
+}
+
+OutputCapture::Options::Options(const nlohmann::json& config) {
+    if (!config.contains("execution")) {
+        return;
+    }
+    const auto& execution = config["execution"];
+    if (execution.contains("max_output_bytes")) {
+        max_bytes = execution["max_output_bytes"].get<size_t>();
+    }
+    if (execution.contains("output_spill_dir") && execution["output_spill_dir"].is_string()) {
+        spill_directory = execution["output_spill_dir"].get<std::string>();
+    }
+    if (execution.contains("spill_output")) {
+        spill_to_disk = execution["spill_output"].get<bool>();
+    }
+}
+
+OutputCapture::OutputCapture(size_t max_bytes)
+    : head_limit(max_bytes - max_bytes / 2), tail_limit(max_bytes / 2) {
+}
+
+OutputCapture::OutputCapture(const Options& options, const char* stream)
+    : OutputCapture(options.max_bytes) {
+    spill_directory = options.spill_directory;
+    this->stream = stream;
+    spill_enabled = options.spill_to_disk && options.max_bytes > 0;
+}
+
+OutputCapture::~OutputCapture() = default;
+
+void OutputCapture::start_spill() {
+    spill_enabled = false; // 只尝试一次
+    std::string directory = spill_directory;
+    std::error_code error;
+    if (directory.empty()) {
+        directory = default_spill_directory.get();
+    } else {
+        std::filesystem::create_directories(directory, error);
+    }
+    if (directory.empty()) {
+        return;
+    }
+    // 配置的目录可能被多个实例共用，文件名带上进程号，免得互相截断
+    std::string path = (std::filesystem::path(directory) /
+                        ("output-" + std::to_string(process_id()) + "-" + std::to_string(++spill_counter) +
+                         "-" + stream + ".txt")).string();
+    auto file = std::make_unique<std::ofstream>(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!*file) {
+        return;
+    }
+    // 还没有超过上限，开头和结尾两段就是到目前为止的全部输出
+    file->write(head.data(), static_cast<std::streamsize>(head.size()));
+    file->write(tail.data(), static_cast<std::streamsize>(tail.size()));
+    if (!*file) {
+        file.reset();
+        std::filesystem::remove(path, error);
+        return;
+    }
+    spill = std::move(file);
+    spill_file = std::move(path);
+}
+
+void OutputCapture::append(std::string_view data) {
+    if (data.empty()) {
+        return;
+    }
+    newlines += static_cast<size_t>(std::count(data.begin(), data.end(), '\n'));
+    ends_with_newline = data.back() == '\n';
+    if (spill_enabled && total + data.size() > head_limit + tail_limit) {
+        start_spill();
+    }
+    total += data.size();
+    if (spill) {
+        spill->write(data.data(), static_cast<std::streamsize>(data.size()));
+        if (!*spill) {
+            // 磁盘写满等情况：放弃文件，退回到只有开头和结尾
+            spill.reset();
+            std::error_code error;
+            std::filesystem::remove(spill_file, error);
+            spill_file.clear();
+        }
+    }
+    if (head_limit == 0) {
+        head.append(data.data(), data.size());
+        return;
+    }
+
+    if (head.size() < head_limit) {
+        size_t take = std::min(head_limit - head.size(), data.size());
+        head.append(data.data(), take);
+        data.remove_prefix(take);
+    }
+    if (data.empty()) {
+        return;
+    }
+    if (data.size() >= tail_limit) {
+        tail.assign(data.data() + data.size() - tail_limit, tail_limit);
+        return;
+    }
+    tail.append(data.data(), data.size());
+    if (tail.size() > 2 * tail_limit) {
+        tail.erase(0, tail.size() - tail_limit);
+    }
+}
+
+size_t OutputCapture::omitted_bytes() const {
+    size_t kept = head.size() + std::min(tail.size(), tail_limit);
+    return total - kept;
+}
+
+std::string OutputCapture::str() const {
+    size_t omitted = omitted_bytes();
+    if (omitted == 0) {
+        return head + tail;
+    }
+
+    // 两端都退到完整的字符边界，被切掉的半个字符计入省略的字节数
+    size_t head_end = head.size();
+    size_t continuation = 0;
+    while (continuation < 3 && head_end - continuation > 0 && is_continuation_byte(head[head_end - continuation - 1])) {
+        ++continuation;
+    }
+    if (continuation < head_end) {
+        unsigned char lead = static_cast<unsigned char>(head[head_end - continuation - 1]);
+        size_t length = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : lead >= 0xC0 ? 2 : 1;
+        if (length > continuation + 1) {
+            head_end -= continuation + 1;
+            omitted += continuation + 1;
+        }
+    }
+    size_t tail_begin = tail.size() - std::min(tail.size(), tail_limit);
+    size_t tail_skip = 0;
+    while (tail_begin + tail_skip < tail.size() && is_continuation_byte(tail[tail_begin + tail_skip])) {
+        ++tail_skip;
+    }
+    omitted += tail_skip;
+
+    std::string result(head, 0, head_end);
+    size_t omitted_lines = newlines - static_cast<size_t>(std::count(result.begin(), result.end(), '\n')) -
+                           static_cast<size_t>(std::count(tail.begin() + static_cast<std::ptrdiff_t>(tail_begin + tail_skip),
+                                                          tail.end(), '\n'));
+    if (!result.empty() && result.back() != '\n') {
+        result += '\n';
+    }
+    result += "[... " + std::to_string(omitted) + " bytes (" + std::to_string(omitted_lines) + " lines) omitted";
+    if (spill) {
+        spill->flush();
+        result += "; the full " + std::string(stream) + " (" + std::to_string(total) + " bytes, " +
+                  std::to_string(total_lines()) + " lines) is saved in " + spill_file +
+                  ", read the parts you need from there";
+    }
+    result += " ...]\n";
+    result.append(tail, tail_begin + tail_skip, std::string::npos);
+    return result;
+}
@@ -0,0 +1,190 @@
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include "PythonSyntaxChecker.h"
+#include "CodeExecutor.h"
+#include <algorithm>
+
+namespace {
+    // 在隔离的命名空间中定义的编译辅助函数；忽略编译期警告（例如无效的转义序列），避免打印到终端。
+    // 注意 catch_warnings 修改的是进程级的警告过滤器，与同时运行的用户代码之间存在短暂的竞争。
+    const char* kCheckFunctionSource = R"#(
+import warnings
+
+def _check(source):
+    with warnings.catch_warnings():
+        warnings.simplefilter('ignore')
+        try:
+            compile(source, '<tool code>', 'exec')
+        except SyntaxError as e:
+            return (e.msg or '', e.lineno or 0, e.text or '')
+        except Exception:
+            pass
+    return None
+)#";
+
+    // 这类错误报告在开始的位置，后续文本仍然可能把它闭合
+    bool may_be_closed_later(const std::string& message) {
+        return message.find("was never closed") != std::string::npos ||
+               message.find("unterminated triple-quoted") != std::string::npos;
+    }
+}
+
+PythonSyntaxChecker::PythonSyntaxChecker(PythonExecutor& executor) : executor(executor) {
+    worker = std::thread([this]() { worker_loop(); });
+}
+
+PythonSyntaxChecker::~PythonSyntaxChecker() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cv.notify_all();
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+bool PythonSyntaxChecker::create_check_function() {
+    PyObject* globals = PyDict_New();
+    if (globals && PyDict_SetItemString(globals, "__builtins__", PyEval_GetBuiltins()) == 0) {
+        PyObject* result = PyRun_String(kCheckFunctionSource, Py_file_input, globals, globals);
+        if (result) {
+            check_function = PyDict_GetItemString(globals, "_check");
+            Py_XINCREF(check_function);
+            Py_DECREF(result);
+        }
+    }
+    Py_XDECREF(globals);
+    PyErr_Clear();
+    return check_function != nullptr;
+}
+
+void PythonSyntaxChecker::begin() {
+    std::lock_guard<std::mutex> lock(mutex);
+    ++generation;
+    pending.clear();
+    has_pending = false;
+    has_fatal = false;
+    fatal = SyntaxCheckResult();
+}
+
+void PythonSyntaxChecker::submit(std::string_view code) {
+    if (disabled) {
+        return;
+    }
+    size_t last_newline = code.rfind('\n');
+    if (last_newline == std::string_view::npos) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (has_fatal) {
+            return;
+        }
+        // 只保留最新的快照：编译跟不上生成速度时跳过中间状态
+        pending.assign(code.data(), last_newline + 1);
+        has_pending = true;
+    }
+    cv.notify_one();
+}
+
+bool PythonSyntaxChecker::fatal_error(SyntaxCheckResult& result) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!has_fatal) {
+        return false;
+    }
+    result = fatal;
+    return true;
+}
+
+void PythonSyntaxChecker::record_abort(size_t generated_bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    counters.aborted_streams += 1;
+    counters.tokens_saved += (generated_bytes + 3) / 4;
+}
+
+SyntaxCheckStats PythonSyntaxChecker::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+
+void PythonSyntaxChecker::worker_loop() {
+    // 解释器或辅助函数不可用时检查器不做任何事
+    if (!executor.wait_until_ready()) {
+        disabled = true;
+        return;
+    }
+    PyGILState_STATE init_gil = PyGILState_Ensure();
+    bool created = create_check_function();
+    PyGILState_Release(init_gil);
+    if (!created) {
+        disabled = true;
+        return;
+    }
+
+    while (true) {
+        std::string source;
+        unsigned long source_generation;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [this]() { return stopping || has_pending; });
+            if (stopping) {
+                break;
+            }
+            source.swap(pending);
+            has_pending = false;
+            source_generation = generation;
+        }
+
+        SyntaxCheckResult result;
+        PyGILState_STATE gil = PyGILState_Ensure();
+        bool is_fatal = compile_prefix(source, result);
+        PyGILState_Release(gil);
+
+        if (is_fatal) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (source_generation == generation && !has_fatal) {
+                has_fatal = true;
+                fatal = std::move(result);
+            }
+        }
+    }
+
+    PyGILState_STATE gil = PyGILState_Ensure();
+    Py_CLEAR(check_function);
+    PyGILState_Release(gil);
+}
+
+bool PythonSyntaxChecker::compile_prefix(const std::string& source, SyntaxCheckResult& result) {
+    PyObject* source_obj = PyUnicode_DecodeUTF8(source.data(), static_cast<Py_ssize_t>(source.size()), "replace");
+    if (!source_obj) {
+        PyErr_Clear();
+        return false;
+    }
+    PyObject* error = PyObject_CallFunctionObjArgs(check_function, source_obj, NULL);
+    Py_DECREF(source_obj);
+    if (!error) {
+        PyErr_Clear();
+        return false;
+    }
+
+    bool is_fatal = false;
+    if (PyTuple_Check(error) && PyTuple_Size(error) == 3) {
+        const char* message = PyUnicode_AsUTF8(PyTuple_GetItem(error, 0));
+        long line = PyLong_AsLong(PyTuple_GetItem(error, 1));
+        const char* text = PyUnicode_AsUTF8(PyTuple_GetItem(error, 2));
+        PyErr_Clear();
+
+        long complete_lines = static_cast<long>(std::count(source.begin(), source.end(), '\n'));
+        result.message = message ? message : "";
+        result.line = static_cast<int>(line);
+        result.text = text ? text : "";
+        while (!result.text.empty() && (result.text.back() == '\n' || result.text.back() == '\r')) {
+            result.text.pop_back();
+        }
+        // 错误行之后已经有完整的行，说明解析器读过了这一行仍无法继续
+        is_fatal = line > 0 && line < complete_lines && !may_be_closed_later(result.message);
+    }
+    Py_DECREF(error);
+    return is_fatal;
+}
@@ -0,0 +1,704 @@
+#include "PythonWorkerPool.h"
+
+#ifndef _WIN32
+
+#include "LiveOutput.h"
+#include "OutputCapture.h"
+#include "SpawnUtils.h"
+#include "Watchdog.h"
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <stdexcept>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <nlohmann/json.hpp>
+
+extern char** environ;
+
+namespace {
+    // 截止时间到达后每隔这么久再中断一次；中断这么多次仍未结束就强制结束工作进程
+    constexpr auto kInterruptRepeat = std::chrono::seconds(1);
+    constexpr int kInterruptsBeforeKill = 5;
+
+    // 关闭后最多等模板进程结束工作进程并退出这么久（kExitPolls * kExitPollInterval），之后强制结束它
+    constexpr int kExitPolls = 50;
+    constexpr auto kExitPollInterval = std::chrono::milliseconds(10);
+
+    // 用 -c 运行的引导代码：以单独的文件名编译模板代码，它的栈帧不会和用户代码（"<string>"）混淆
+    const char* kBootstrapSource = "import sys; exec(compile(sys.argv[1], '<code-atlas worker>', 'exec'))";
+
+    // 模板进程：先编译执行包装函数（其中记录的“启动时已有的模块”不包括预加载的模块），
+    // 再导入常用模块，然后在 fd 3 上处理请求，每个请求 6 字节：命令、4 字节大端 pid、信号编号。
+    //   'w'：为附带的套接字 fork 一个工作进程，回复它的 pid；
+    //   'k'：向仍是自己子进程的工作进程发送信号；'r'：结束工作进程并回收它（不回复）。
+    // 工作进程退出后保持未回收，直到本进程发出 'r'，所以它的 pid 在此之前不会被重用；
+    // 信号由作为父进程的模板发送，已回收的 pid 不会收到信号。fd 3 读到 EOF 时结束所有工作进程后退出。
+    // 工作进程与本进程之间的消息都是 4 字节大端长度 + UTF-8 JSON：
+    //   请求 {"code", "interrupt", "limits"}；应答若干个 {"chunks": [["o"|"e", text], ...]}，
+    //   最后是 {"done", "imports", "failed", "usage"}。
+    // 每次执行前把 RLIMIT_CPU 的软限制设为已用时间加上限额、RLIMIT_AS 设为内存限额，执行后恢复；
+    // 硬限制不变（降低后无法再提高）。超出 CPU 限额时 SIGXCPU 在用户代码中抛出 CellTimeout。
+    const char* kTemplateSource = R"#(
+import io
+import json
+import math
+import os
+import resource
+import signal
+import socket
+import struct
+import sys
+import time
+import traceback
+import types
+
+class CellTimeout(BaseException):
+    """Raised in code that ran past its time limit."""
+CellTimeout.__module__ = 'code_atlas'
+
+_wrapper = {'__builtins__': __builtins__, 'CellTimeout': CellTimeout}
+exec(sys.argv[2], _wrapper)
+_run = _wrapper['_run']
+
+for _name in sys.argv[3:]:
+    try:
+        __import__(_name)
+    except BaseException:
+        pass
+
+_running = False      # a cell is executing
+_sending = False      # a frame is being written; an interrupt waits until it is complete
+_deferred = False
+_interrupt_message = ''
+_cpu_message = ''
+_cpu_exceeded = False
+
+def _on_interrupt(signum, frame):
+    global _deferred, _interrupt_message, _cpu_exceeded
+    if not _running:
+        return
+    if signum == signal.SIGXCPU:
+        _cpu_exceeded = True
+        _interrupt_message = _cpu_message
+    if _sending:
+        _deferred = True
+        return
+    raise CellTimeout(_interrupt_message)
+
+def _cpu_time(who):
+    usage = resource.getrusage(who)
+    return usage.ru_utime, usage.ru_stime
+
+def _set_soft_limit(which, soft):
+    try:
+        hard = resource.getrlimit(which)[1]
+        if hard != resource.RLIM_INFINITY and (soft == resource.RLIM_INFINITY or soft > hard):
+            soft = hard
+        resource.setrlimit(which, (soft, hard))
+    except (ValueError, OSError):
+        pass
+
+def _apply_limits(limits):
+    global _cpu_message
+    cpu = limits.get('cpu_seconds', 0)
+    if cpu > 0:
+        user, system = _cpu_time(resource.RUSAGE_SELF)
+        _cpu_message = 'CPU time limit of %gs exceeded' % cpu
+        _set_soft_limit(resource.RLIMIT_CPU, math.ceil(user + system + cpu))
+    memory = limits.get('memory_bytes', 0)
+    if memory > 0:
+        _set_soft_limit(resource.RLIMIT_AS, memory)
+
+def _restore_limits(limits):
+    if limits.get('cpu_seconds', 0) > 0:
+        _set_soft_limit(resource.RLIMIT_CPU, resource.RLIM_INFINITY)
+    if limits.get('memory_bytes', 0) > 0:
+        _set_soft_limit(resource.RLIMIT_AS, resource.RLIM_INFINITY)
+
+class _Channel:
+    def __init__(self, sock):
+        self.sock = sock
+        self.chunks = []
+        self.size = 0
+        self.last_flush = time.monotonic()
+
+    def send(self, message):
+        global _sending, _deferred
+        data = json.dumps(message, ensure_ascii=False).encode('utf-8')
+        _sending = True
+        try:
+            self.sock.sendall(struct.pack('>I', len(data)) + data)
+        finally:
+            _sending = False
+        if _deferred:
+            _deferred = False
+            if _running:
+                raise CellTimeout(_interrupt_message)
+
+    def output(self, key, text):
+        if self.chunks and self.chunks[-1][0] == key:
+            self.chunks[-1][1] += text
+        else:
+            self.chunks.append([key, text])
+        self.size += len(text)
+        if self.size >= 16384 or time.monotonic() - self.last_flush >= 0.05:
+            self.flush()
+
+    def flush(self):
+        self.last_flush = time.monotonic()
+        if self.chunks:
+            chunks, self.chunks, self.size = self.chunks, [], 0
+            self.send({'chunks': chunks})
+
+class _Writer:
+    encoding = 'utf-8'
+    errors = 'strict'
+    closed = False
+
+    def __init__(self, channel, key):
+        self.channel = channel
+        self.key = key
+
+    def write(self, text):
+        if not isinstance(text, str):
+            raise TypeError('write() argument must be str, not ' + type(text).__name__)
+        if text:
+            # Lone surrogates cannot be encoded as UTF-8; replace them instead of failing print()
+            self.channel.output(self.key, text.encode('utf-8', 'replace').decode('utf-8'))
+        return len(text)
+
+    def flush(self):
+        pass
+
+    def isatty(self):
+        return False
+
+    def readable(self):
+        return False
+
+    def seekable(self):
+        return False
+
+    def writable(self):
+        return True
+
+    def fileno(self):
+        raise io.UnsupportedOperation('fileno')
+
+def _recv_exact(sock, size):
+    data = b''
+    while len(data) < size:
+        part = sock.recv(size - len(data))
+        if not part:
+            return None
+        data += part
+    return data
+
+def _serve(sock):
+    global _running, _interrupt_message, _cpu_exceeded
+    signal.signal(signal.SIGUSR1, _on_interrupt)
+    signal.signal(signal.SIGXCPU, _on_interrupt)
+    main = types.ModuleType('__main__')
+    sys.modules['__main__'] = main
+    namespace = main.__dict__
+    namespace['__builtins__'] = __builtins__
+    channel = _Channel(sock)
+    stdout = _Writer(channel, 'o')
+    stderr = _Writer(channel, 'e')
+    while True:
+        header = _recv_exact(sock, 4)
+        if header is None:
+            return
+        body = _recv_exact(sock, struct.unpack('>I', header)[0])
+        if body is None:
+            return
+        request = json.loads(body)
+        _interrupt_message = request.get('interrupt', '')
+        limits = request.get('limits', {})
+        imports, failed = [], None
+        _cpu_exceeded = False
+        self_before = _cpu_time(resource.RUSAGE_SELF)
+        children_before = _cpu_time(resource.RUSAGE_CHILDREN)
+        _apply_limits(limits)
+        _running = True
+        try:
+            try:
+                imports = _run(request['code'], namespace, stdout, stderr)
+            finally:
+                _running = False
+        except BaseException:
+            # SystemExit, KeyboardInterrupt and the like escape the wrapper; the worker keeps serving
+            _running = False
+            failed = traceback.format_exc()
+        _restore_limits(limits)
+        self_after = _cpu_time(resource.RUSAGE_SELF)
+        children_after = _cpu_time(resource.RUSAGE_CHILDREN)
+        max_rss = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+        usage = {
+            'user': self_after[0] - self_before[0] + children_after[0] - children_before[0],
+            'system': self_after[1] - self_before[1] + children_after[1] - children_before[1],
+            'max_rss_kb': max_rss // 1024 if sys.platform == 'darwin' else max_rss,
+            'cpu_limit': _cpu_exceeded,
+        }
+        channel.flush()
+        channel.send({'done': True, 'imports': imports, 'failed': failed, 'usage': usage})
+
+_workers = set()   # forked workers that code-atlas has not released; alive or unreaped
+_released = set()  # killed on request, not reaped yet
+
+def _reap_released():
+    for pid in list(_released):
+        try:
+            done = os.waitpid(pid, os.WNOHANG)[0]
+        except ChildProcessError:
+            done = pid
+        if done:
+            _released.discard(pid)
+
+def _recv_request(control):
+    message, fds, _, _ = socket.recv_fds(control, 6, 1)
+    while message and len(message) < 6:
+        part = control.recv(6 - len(message))
+        if not part:
+            return None, fds
+        message += part
+    return message, fds
+
+signal.signal(signal.SIGINT, signal.SIG_IGN)   # Ctrl+C is handled by code-atlas itself
+control = socket.socket(fileno=3)
+while True:
+    try:
+        message, fds = _recv_request(control)
+    except OSError:
+        break
+    if not message:
+        break
+    command, pid, signum = struct.unpack('>cib', message)
+    if command == b'w' and fds:
+        pid = os.fork()
+        if pid == 0:
+            try:
+                control.close()
+                _serve(socket.socket(fileno=fds[0]))
+            finally:
+                os._exit(0)
+        os.close(fds[0])
+        _workers.add(pid)
+        try:
+            control.sendall(struct.pack('>i', pid))
+        except OSError:
+            break
+    elif command == b'k' and pid in _workers:
+        os.kill(pid, signum)
+    elif command == b'r' and pid in _workers:
+        os.kill(pid, signal.SIGKILL)
+        _workers.discard(pid)
+        _released.add(pid)
+    if command != b'w':
+        for fd in fds:
+            os.close(fd)
+    _reap_released()
+for pid in _workers:
+    os.kill(pid, signal.SIGKILL)
+for pid in _workers | _released:
+    try:
+        os.waitpid(pid, 0)
+    except ChildProcessError:
+        pass
+)#";
+
+    bool write_all(int fd, const char* data, size_t size) {
+        while (size > 0) {
+            ssize_t written = send(fd, data, size, kSendFlags);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            data += written;
+            size -= static_cast<size_t>(written);
+        }
+        return true;
+    }
+
+    bool read_all(int fd, char* data, size_t size) {
+        while (size > 0) {
+            ssize_t got = read(fd, data, size);
+            if (got < 0 && errno == EINTR) continue;
+            if (got <= 0) return false;
+            data += got;
+            size -= static_cast<size_t>(got);
+        }
+        return true;
+    }
+
+    bool write_frame(int fd, const std::string& payload) {
+        uint32_t size = static_cast<uint32_t>(payload.size());
+        unsigned char header[4] = {
+            static_cast<unsigned char>(size >> 24), static_cast<unsigned char>(size >> 16),
+            static_cast<unsigned char>(size >> 8), static_cast<unsigned char>(size)
+        };
+        return write_all(fd, reinterpret_cast<const char*>(header), sizeof(header)) &&
+               write_all(fd, payload.data(), payload.size());
+    }
+
+    bool read_frame(int fd, std::string& payload) {
+        unsigned char header[4];
+        if (!read_all(fd, reinterpret_cast<char*>(header), sizeof(header))) {
+            return false;
+        }
+        uint32_t size = (uint32_t(header[0]) << 24) | (uint32_t(header[1]) << 16) | (uint32_t(header[2]) << 8) | header[3];
+        payload.resize(size);
+        return read_all(fd, payload.data(), size);
+    }
+}
+
+PythonWorkerPool::PythonWorkerPool(Options options) : options(std::move(options)) {
+    start_template();
+    spawner = std::thread([this]() { spawner_main(); });
+}
+
+PythonWorkerPool::~PythonWorkerPool() {
+    shutdown();
+    if (spawner.joinable()) {
+        spawner.join();
+    }
+    for (auto& worker : idle) {
+        close(worker->fd);
+    }
+    for (auto& entry : sessions) {
+        close(entry.second->fd);
+    }
+    for (auto& worker : retired) {
+        close(worker->fd);
+    }
+    if (template_fd >= 0) {
+        close(template_fd);
+    }
+}
+
+void PythonWorkerPool::shutdown() {
+    // 只结束进程，不关闭套接字：其他线程可能正在读写它们，读到 EOF 后自行返回
+    std::lock_guard<std::mutex> lock(mutex);
+    if (stopping) {
+        return;
+    }
+    stopping = true;
+    cv.notify_all();
+    if (template_pid > 0) {
+        // 模板进程读到 EOF 后结束并回收所有工作进程，然后退出；之后的 signal_worker() 不再发出任何信号
+        {
+            std::lock_guard<std::mutex> template_lock(template_mutex);
+            if (template_fd >= 0) {
+                ::shutdown(template_fd, SHUT_WR);
+            }
+        }
+        pid_t reaped = 0;
+        for (int attempt = 0; attempt < kExitPolls && reaped == 0; ++attempt) {
+            if (attempt > 0) {
+                std::this_thread::sleep_for(kExitPollInterval);
+            }
+            while ((reaped = waitpid(template_pid, nullptr, WNOHANG)) < 0 && errno == EINTR) {
+            }
+        }
+        if (reaped == 0) {
+            // 模板进程是本进程的子进程，回收之前 pid 不会被重用
+            kill(template_pid, SIGKILL);
+            while (waitpid(template_pid, nullptr, 0) < 0 && errno == EINTR) {
+            }
+        }
+        template_pid = -1;
+    }
+}
+
+void PythonWorkerPool::start_template() {
+    int control[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, control) != 0) {
+        template_error = std::string("Could not create the worker control socket: ") + std::strerror(errno);
+        return;
+    }
+    set_cloexec(control[0]);
+    disable_sigpipe(control[0]);
+
+    // 模板进程在 fd 3 上接收 fork 请求
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, control[1], 3);
+
+    std::vector<std::string> args = {options.executable, "-c", kBootstrapSource, kTemplateSource, options.wrapper_source};
+    args.insert(args.end(), options.preload.begin(), options.preload.end());
+    std::vector<char*> argv;
+    for (auto& arg : args) {
+        argv.push_back(arg.data());
+    }
+    argv.push_back(nullptr);
+
+    pid_t pid = 0;
+    int spawn_error = posix_spawnp(&pid, options.executable.c_str(), &actions, nullptr, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(control[1]);
+    if (spawn_error != 0) {
+        close(control[0]);
+        template_error = "Could not start the Python worker template '" + options.executable + "': " + std::strerror(spawn_error);
+        return;
+    }
+    template_pid = pid;
+    template_fd = control[0];
+}
+
+bool PythonWorkerPool::send_template_request(char command, int pid, int signum, int fd) {
+    char request[6] = {
+        command, static_cast<char>(pid >> 24), static_cast<char>(pid >> 16), static_cast<char>(pid >> 8),
+        static_cast<char>(pid), static_cast<char>(signum)
+    };
+    iovec io{request, sizeof(request)};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+    msghdr message{};
+    message.msg_iov = &io;
+    message.msg_iovlen = 1;
+    if (fd >= 0) {
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        cmsghdr* header = CMSG_FIRSTHDR(&message);
+        header->cmsg_level = SOL_SOCKET;
+        header->cmsg_type = SCM_RIGHTS;
+        header->cmsg_len = CMSG_LEN(sizeof(int));
+        std::memcpy(CMSG_DATA(header), &fd, sizeof(int));
+    }
+
+    ssize_t sent;
+    while ((sent = sendmsg(template_fd, &message, kSendFlags)) < 0 && errno == EINTR) {
+    }
+    if (sent <= 0) {
+        return false;
+    }
+    // 描述符随第一个字节送达；其余部分（很少会有）补发
+    return write_all(template_fd, request + sent, sizeof(request) - static_cast<size_t>(sent));
+}
+
+void PythonWorkerPool::signal_worker(int pid, int signum) {
+    std::lock_guard<std::mutex> lock(template_mutex);
+    if (template_fd >= 0) {
+        send_template_request('k', pid, signum);
+    }
+}
+
+void PythonWorkerPool::release_worker(int pid) {
+    std::lock_guard<std::mutex> lock(template_mutex);
+    if (template_fd >= 0) {
+        send_template_request('r', pid, 0);
+    }
+}
+
+std::shared_ptr<PythonWorkerPool::Worker> PythonWorkerPool::spawn_worker() {
+    std::lock_guard<std::mutex> lock(template_mutex);
+    if (template_fd < 0) {
+        throw std::runtime_error(template_error);
+    }
+
+    int pair[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0) {
+        throw std::runtime_error(std::string("Could not create a worker socket: ") + std::strerror(errno));
+    }
+    set_cloexec(pair[0]);
+    set_cloexec(pair[1]);
+    disable_sigpipe(pair[0]);
+
+    // 把套接字的一端交给模板进程，它 fork 出的工作进程继承这一端，并回复工作进程的 pid
+    bool sent = send_template_request('w', 0, 0, pair[1]);
+    close(pair[1]);
+    unsigned char reply[4];
+    if (!sent || !read_all(template_fd, reinterpret_cast<char*>(reply), sizeof(reply))) {
+        close(pair[0]);
+        close(template_fd);
+        template_fd = -1;
+        template_error = "The Python worker template process exited; check that '" + options.executable +
+                         "' is Python 3.9 or newer.";
+        throw std::runtime_error(template_error);
+    }
+
+    auto worker = std::make_shared<Worker>();
+    worker->pid = static_cast<int>((uint32_t(reply[0]) << 24) | (uint32_t(reply[1]) << 16) | (uint32_t(reply[2]) << 8) | reply[3]);
+    worker->fd = pair[0];
+    return worker;
+}
+
+void PythonWorkerPool::spawner_main() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        cv.wait(lock, [this]() { return stopping || idle.size() < options.idle_workers; });
+        if (stopping) {
+            return;
+        }
+        lock.unlock();
+        std::shared_ptr<Worker> worker;
+        try {
+            worker = spawn_worker();
+        } catch (const std::exception&) {
+            // 模板进程不可用；执行时会报告错误
+            return;
+        }
+        lock.lock();
+        if (stopping) {
+            release_worker(worker->pid);
+            close(worker->fd);
+            return;
+        }
+        idle.push_back(std::move(worker));
+        cv.notify_all();
+    }
+}
+
+std::shared_ptr<PythonWorkerPool::Worker> PythonWorkerPool::worker_for(const std::string& session) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping) {
+            throw std::runtime_error("Python interpreter has been shut down.");
+        }
+        auto it = sessions.find(session);
+        if (it != sessions.end()) {
+            return it->second;
+        }
+        if (sessions.size() >= options.max_sessions) {
+            throw std::runtime_error("Too many Python sessions (python.max_sessions is " +
+                                     std::to_string(options.max_sessions) + "); reuse one of the existing sessions.");
+        }
+        if (!idle.empty()) {
+            std::shared_ptr<Worker> worker = idle.front();
+            idle.pop_front();
+            sessions[session] = worker;
+            cv.notify_all(); // 让后台线程补充空闲进程
+            return worker;
+        }
+    }
+
+    // 没有空闲的工作进程（刚启动或都已被占用）：直接 fork 一个
+    std::shared_ptr<Worker> worker = spawn_worker();
+    std::lock_guard<std::mutex> lock(mutex);
+    auto inserted = sessions.emplace(session, worker);
+    if (!inserted.second) {
+        // 同一会话的另一个调用抢先绑定了工作进程，新 fork 的这个留作空闲
+        idle.push_back(worker);
+        return inserted.first->second;
+    }
+    return worker;
+}
+
+void PythonWorkerPool::retire(const std::string& session, const std::shared_ptr<Worker>& worker) {
+    worker->lost = true;
+    release_worker(worker->pid);
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = sessions.find(session);
+    if (it != sessions.end() && it->second == worker) {
+        sessions.erase(it);
+    }
+    retired.push_back(worker);
+}
+
+PythonWorkerPool::Run PythonWorkerPool::run(const std::string& session, const std::string& code,
+                                            std::chrono::milliseconds timeout, const std::string& interrupt_message,
+                                            OutputCapture& stdout_capture, OutputCapture& stderr_capture,
+                                            LiveOutput* live) {
+    Run result;
+    std::shared_ptr<Worker> worker = worker_for(session);
+    std::lock_guard<std::mutex> worker_lock(worker->mutex);
+    if (worker->lost) {
+        // 等待期间上一次执行丢失了这个工作进程；会话已经解绑，换一个新的
+        return run(session, code, timeout, interrupt_message, stdout_capture, stderr_capture, live);
+    }
+
+    nlohmann::json request;
+    request["code"] = code;
+    request["interrupt"] = interrupt_message;
+    if (options.limits.cpu_seconds > 0 || options.limits.memory_bytes > 0) {
+        request["limits"] = {{"cpu_seconds", options.limits.cpu_seconds},
+                             {"memory_bytes", options.limits.memory_bytes}};
+    }
+    auto started = std::chrono::steady_clock::now();
+    if (!write_frame(worker->fd, request.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace))) {
+        retire(session, worker);
+        result.outcome = Run::Outcome::Lost;
+        return result;
+    }
+
+    std::atomic<int> interrupts{0};
+    uint64_t deadline = 0;
+    if (timeout > std::chrono::milliseconds::zero()) {
+        int pid = worker->pid;
+        deadline = Watchdog::instance().arm(timeout, [this, pid, &interrupts]() {
+            signal_worker(pid, interrupts++ < kInterruptsBeforeKill ? SIGUSR1 : SIGKILL);
+        }, kInterruptRepeat);
+    }
+
+    bool done = false;
+    std::string payload;
+    while (read_frame(worker->fd, payload)) {
+        nlohmann::json message = nlohmann::json::parse(payload, nullptr, false);
+        if (message.is_discarded()) {
+            break;
+        }
+        if (message.contains("chunks")) {
+            for (const auto& chunk : message["chunks"]) {
+                bool is_stderr = chunk[0] == "e";
+                const std::string& text = chunk[1].get_ref<const std::string&>();
+                (is_stderr ? stderr_capture : stdout_capture).append(text);
+                if (live) {
+                    live->write(text, is_stderr);
+                }
+            }
+        } else if (message.contains("done")) {
+            if (message["imports"].is_array()) {
+                result.imports = message["imports"].get<std::vector<std::string>>();
+            }
+            if (message["failed"].is_string()) {
+                result.outcome = Run::Outcome::Failed;
+                result.failure = message["failed"].get<std::string>();
+            }
+            if (message.contains("usage") && message["usage"].is_object()) {
+                const auto& usage = message["usage"];
+                result.usage.user_seconds = usage.value("user", 0.0);
+                result.usage.system_seconds = usage.value("system", 0.0);
+                result.usage.max_rss_kb = usage.value("max_rss_kb", -1L);
+                if (usage.value("cpu_limit", false)) {
+                    result.usage.limit_exceeded = "cpu";
+                }
+            }
+            done = true;
+            break;
+        }
+    }
+
+    if (deadline) {
+        Watchdog::instance().disarm(deadline);
+    }
+    result.timed_out = interrupts > 0;
+    result.usage.wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    if (!done) {
+        retire(session, worker);
+        result.outcome = Run::Outcome::Lost;
+    }
+    return result;
+}
+
+#else
+
+#include <stdexcept>
+
+PythonWorkerPool::PythonWorkerPool(Options options) : options(std::move(options)) {
+    throw std::runtime_error("The forkserver Python backend requires a POSIX system.");
+}
+
+PythonWorkerPool::~PythonWorkerPool() = default;
+
+PythonWorkerPool::Run PythonWorkerPool::run(const std::string&, const std::string&, std::chrono::milliseconds,
+                                            const std::string&, OutputCapture&, OutputCapture&, LiveOutput*) {
+    throw std::runtime_error("The forkserver Python backend requires a POSIX system.");
+}
+
+void PythonWorkerPool::shutdown() {
+}
+
+#endif // _WIN32
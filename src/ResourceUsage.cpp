@@ -0,0 +1,311 @@
+#include "ResourceUsage.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#endif
+
+namespace {
+    // 结果中的秒数保留到毫秒
+    double round_ms(double seconds) {
+        return std::round(seconds * 1000.0) / 1000.0;
+    }
+
+#ifndef _WIN32
+    double seconds_of(const timeval& tv) {
+        return static_cast<double>(tv.tv_sec) + static_cast<double>(tv.tv_usec) / 1e6;
+    }
+
+    long maxrss_kb(const struct rusage& usage) {
+#ifdef __APPLE__
+        return static_cast<long>(usage.ru_maxrss / 1024); // macOS 以字节为单位
+#else
+        return static_cast<long>(usage.ru_maxrss);
+#endif
+    }
+
+    bool write_file(const std::string& path, const std::string& value) {
+        std::ofstream file(path);
+        file << value;
+        file.flush();
+        return static_cast<bool>(file);
+    }
+
+    // 读取 "key value" 格式文件（cpu.stat、memory.events）中的一个值
+    bool read_keyed(const std::string& path, const std::string& key, long long& value) {
+        std::ifstream file(path);
+        std::string name;
+        long long number;
+        while (file >> name >> number) {
+            if (name == key) {
+                value = number;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool read_number(const std::string& path, long long& value) {
+        std::ifstream file(path);
+        return static_cast<bool>(file >> value);
+    }
+
+    // 还有进程、暂时删不掉的叶子 cgroup；创建新叶子时再试
+    std::mutex stale_mutex;
+    std::vector<std::string> stale_leaves;
+
+    void remove_stale_leaves() {
+        std::lock_guard<std::mutex> lock(stale_mutex);
+        stale_leaves.erase(std::remove_if(stale_leaves.begin(), stale_leaves.end(), [](const std::string& path) {
+            return rmdir(path.c_str()) == 0 || errno == ENOENT;
+        }), stale_leaves.end());
+    }
+#endif
+}
+
+nlohmann::json ResourceUsage::to_json() const {
+    nlohmann::json json;
+    json["wall_seconds"] = round_ms(wall_seconds);
+    json["cpu_user_seconds"] = round_ms(user_seconds);
+    json["cpu_system_seconds"] = round_ms(system_seconds);
+    if (max_rss_kb >= 0) {
+        json["max_rss_kb"] = max_rss_kb;
+    }
+    json["output_bytes"] = output_bytes;
+    if (processes >= 0) {
+        json["processes"] = processes;
+    }
+    if (!limit_exceeded.empty()) {
+        json["limit_exceeded"] = limit_exceeded;
+    }
+    return json;
+}
+
+ResourceLimits::ResourceLimits(const nlohmann::json& config) {
+    if (!config.contains("execution")) {
+        return;
+    }
+    const auto& execution = config["execution"];
+    if (execution.contains("limits") && execution["limits"].is_object()) {
+        const auto& limits = execution["limits"];
+        if (limits.contains("cpu_seconds")) {
+            cpu_seconds = limits["cpu_seconds"].get<double>();
+        }
+        if (limits.contains("memory_mb")) {
+            memory_bytes = static_cast<size_t>(limits["memory_mb"].get<double>() * 1024 * 1024);
+        }
+        if (limits.contains("max_processes")) {
+            max_processes = limits["max_processes"].get<long>();
+        }
+    }
+    if (execution.contains("cgroup_root") && execution["cgroup_root"].is_string()) {
+        cgroup_root = execution["cgroup_root"].get<std::string>();
+    }
+}
+
+ResourceMeter::ResourceMeter() : start(std::chrono::steady_clock::now()) {
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    if (GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user)) {
+        start_user = (static_cast<double>(user.dwHighDateTime) * 4294967296.0 + user.dwLowDateTime) / 1e7;
+        start_system = (static_cast<double>(kernel.dwHighDateTime) * 4294967296.0 + kernel.dwLowDateTime) / 1e7;
+    }
+#else
+    struct rusage usage {};
+#ifdef RUSAGE_THREAD
+    getrusage(RUSAGE_THREAD, &usage);
+#else
+    getrusage(RUSAGE_SELF, &usage);
+#endif
+    start_user = seconds_of(usage.ru_utime);
+    start_system = seconds_of(usage.ru_stime);
+#endif
+}
+
+void ResourceMeter::finish(ResourceUsage& usage) const {
+    usage.wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    if (GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user)) {
+        usage.user_seconds = (static_cast<double>(user.dwHighDateTime) * 4294967296.0 + user.dwLowDateTime) / 1e7 - start_user;
+        usage.system_seconds = (static_cast<double>(kernel.dwHighDateTime) * 4294967296.0 + kernel.dwLowDateTime) / 1e7 - start_system;
+    }
+#else
+    struct rusage now {};
+#ifdef RUSAGE_THREAD
+    getrusage(RUSAGE_THREAD, &now);
+#else
+    getrusage(RUSAGE_SELF, &now);
+#endif
+    usage.user_seconds = seconds_of(now.ru_utime) - start_user;
+    usage.system_seconds = seconds_of(now.ru_stime) - start_system;
+    struct rusage process {};
+    getrusage(RUSAGE_SELF, &process);
+    usage.max_rss_kb = maxrss_kb(process);
+#endif
+}
+
+ResourceLedger& ResourceLedger::instance() {
+    static ResourceLedger ledger;
+    return ledger;
+}
+
+void ResourceLedger::record(const std::string& key, const ResourceUsage& usage) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Totals& entry = totals[key];
+    double cpu = usage.user_seconds + usage.system_seconds;
+    entry.calls++;
+    entry.wall_seconds += usage.wall_seconds;
+    entry.cpu_seconds += cpu;
+    entry.max_call_wall_seconds = std::max(entry.max_call_wall_seconds, usage.wall_seconds);
+    entry.max_call_cpu_seconds = std::max(entry.max_call_cpu_seconds, cpu);
+    entry.peak_rss_kb = std::max(entry.peak_rss_kb, usage.max_rss_kb);
+    entry.output_bytes += usage.output_bytes;
+    if (!usage.limit_exceeded.empty()) {
+        entry.limits_exceeded++;
+    }
+}
+
+std::string ResourceLedger::summary() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (totals.empty()) {
+        return "No tool calls yet.\n";
+    }
+    std::ostringstream out;
+    char line[256];
+    std::snprintf(line, sizeof(line), "%-24s %6s %10s %10s %10s %10s %12s %10s %7s\n", "Session", "Calls", "Wall s",
+                  "CPU s", "Max wall", "Max CPU", "Peak RSS MB", "Output KB", "Limits");
+    out << line;
+    for (const auto& [key, entry] : totals) {
+        std::string peak = entry.peak_rss_kb >= 0 ? std::to_string(entry.peak_rss_kb / 1024) : "-";
+        std::snprintf(line, sizeof(line), "%-24s %6zu %10.2f %10.2f %10.2f %10.2f %12s %10.1f %7zu\n", key.c_str(),
+                      entry.calls, entry.wall_seconds, entry.cpu_seconds, entry.max_call_wall_seconds,
+                      entry.max_call_cpu_seconds, peak.c_str(), entry.output_bytes / 1024.0, entry.limits_exceeded);
+        out << line;
+    }
+    return out.str();
+}
+
+std::string attach_resources(const std::string& result, const std::string& key, const ResourceUsage& usage) {
+    ResourceLedger::instance().record(key, usage);
+    // 结果总是 nlohmann::json 输出的对象：直接在最后的 '}' 之前插入字段，不必重新解析可能很长的输出
+    if (result.size() < 2 || result.front() != '{' || result.back() != '}') {
+        return result;
+    }
+    std::string field = std::string(result.size() > 2 ? "," : "") + "\"resources\":" + usage.to_json().dump();
+    std::string attached = result;
+    attached.insert(attached.size() - 1, field);
+    return attached;
+}
+
+#ifndef _WIN32
+
+void fill_from_rusage(ResourceUsage& usage, const struct rusage& rusage) {
+    usage.user_seconds = seconds_of(rusage.ru_utime);
+    usage.system_seconds = seconds_of(rusage.ru_stime);
+    usage.max_rss_kb = maxrss_kb(rusage);
+}
+
+bool apply_rlimits(int pid, const ResourceLimits& limits, bool in_cgroup) {
+#ifdef __linux__
+    bool applied = true;
+    if (limits.cpu_seconds > 0) {
+        // 软限制到达时收到 SIGXCPU，再过一秒仍在运行则被内核结束
+        rlim_t seconds = static_cast<rlim_t>(std::ceil(limits.cpu_seconds));
+        struct rlimit cpu {seconds, seconds + 1};
+        applied = prlimit(pid, RLIMIT_CPU, &cpu, nullptr) == 0 && applied;
+    }
+    if (limits.memory_bytes > 0 && !in_cgroup) {
+        struct rlimit memory {static_cast<rlim_t>(limits.memory_bytes), static_cast<rlim_t>(limits.memory_bytes)};
+        applied = prlimit(pid, RLIMIT_AS, &memory, nullptr) == 0 && applied;
+    }
+    return applied;
+#else
+    (void)pid;
+    (void)limits;
+    (void)in_cgroup;
+    return false;
+#endif
+}
+
+std::unique_ptr<CgroupLeaf> CgroupLeaf::create(const ResourceLimits& limits) {
+#ifdef __linux__
+    if (limits.cgroup_root.empty()) {
+        return nullptr;
+    }
+    remove_stale_leaves();
+    // 控制器需要在父目录的 subtree_control 中启用；已经启用或无权限时写入失败，忽略即可
+    write_file(limits.cgroup_root + "/cgroup.subtree_control", "+memory +pids");
+
+    static std::atomic<unsigned long> counter{0};
+    std::string path = limits.cgroup_root + "/code-atlas-" + std::to_string(getpid()) + "-" + std::to_string(counter++);
+    if (mkdir(path.c_str(), 0755) != 0) {
+        return nullptr;
+    }
+    std::unique_ptr<CgroupLeaf> leaf(new CgroupLeaf(path));
+    if (limits.memory_bytes > 0) {
+        write_file(path + "/memory.max", std::to_string(limits.memory_bytes));
+        write_file(path + "/memory.swap.max", "0"); // 否则超出的部分换出到交换区，而不是触发 OOM
+    }
+    if (limits.max_processes > 0) {
+        write_file(path + "/pids.max", std::to_string(limits.max_processes));
+    }
+    return leaf;
+#else
+    (void)limits;
+    return nullptr;
+#endif
+}
+
+CgroupLeaf::~CgroupLeaf() {
+    if (rmdir(path.c_str()) != 0 && errno == EBUSY) {
+        std::lock_guard<std::mutex> lock(stale_mutex);
+        stale_leaves.push_back(path);
+    }
+}
+
+bool CgroupLeaf::add(int pid) const {
+    return write_file(path + "/cgroup.procs", std::to_string(pid));
+}
+
+void CgroupLeaf::read_usage(ResourceUsage& usage) {
+    long long value = 0;
+    if (read_keyed(path + "/cpu.stat", "user_usec", value)) {
+        usage.user_seconds = static_cast<double>(value - user_usec) / 1e6;
+        user_usec = value;
+    }
+    if (read_keyed(path + "/cpu.stat", "system_usec", value)) {
+        usage.system_seconds = static_cast<double>(value - system_usec) / 1e6;
+        system_usec = value;
+    }
+    if (read_number(path + "/memory.peak", value)) {
+        usage.max_rss_kb = static_cast<long>(value / 1024);
+    }
+    if (read_number(path + "/pids.peak", value)) {
+        usage.processes = static_cast<long>(value);
+    }
+    if (read_keyed(path + "/memory.events", "oom_kill", value) && value > oom_kills) {
+        oom_kills = value;
+        usage.limit_exceeded = "memory";
+    }
+    if (read_keyed(path + "/pids.events", "max", value) && value > pids_max_events) {
+        pids_max_events = value;
+        if (usage.limit_exceeded.empty()) {
+            usage.limit_exceeded = "processes";
+        }
+    }
+}
+
+#endif // _WIN32
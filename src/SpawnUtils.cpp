@@ -0,0 +1,30 @@
+#include "SpawnUtils.h"
+
+#ifndef _WIN32
+
+#include <fcntl.h>
+#include <unistd.h>
+
+void set_cloexec(int fd) {
+    fcntl(fd, F_SETFD, fcntl(fd, F_GETFD) | FD_CLOEXEC);
+}
+
+void disable_sigpipe(int fd) {
+#ifdef SO_NOSIGPIPE
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#else
+    (void)fd;
+#endif
+}
+
+int move_fd_above(int fd, int slot) {
+    if (fd > slot) {
+        return fd;
+    }
+    int moved = fcntl(fd, F_DUPFD_CLOEXEC, slot + 1);
+    close(fd);
+    return moved;
+}
+
+#endif // _WIN32
@@ -0,0 +1,173 @@
+#include "SseParser.h"
+#include <cstring>
+
+namespace {
+    // 压缩阈值：已消费数据超过这个大小并且占缓冲区一半以上时才移动剩余数据
+    constexpr size_t kCompactThreshold = 4096;
+}
+
+void SseParser::feed(std::string_view chunk) {
+    if (event_start == buffer.size()) {
+        // 所有数据都已消费，直接清空（保留容量）
+        buffer.clear();
+        read_pos = 0;
+        event_start = 0;
+        data_begin = data_end = 0;
+        type_begin = type_end = 0;
+    } else if (event_start >= kCompactThreshold && event_start * 2 >= buffer.size()) {
+        // 当前事件的所有偏移量都不小于 event_start，整体前移即可
+        auto shift = [this](size_t& offset) {
+            offset = offset >= event_start ? offset - event_start : 0;
+        };
+        buffer.erase(0, event_start);
+        shift(read_pos);
+        shift(data_begin);
+        shift(data_end);
+        shift(type_begin);
+        shift(type_end);
+        event_start = 0;
+    }
+    buffer.append(chunk.data(), chunk.size());
+}
+
+bool SseParser::next_event(SseEvent& event) {
+    while (read_pos < buffer.size()) {
+        const char* base = buffer.data();
+        const void* nl = std::memchr(base + read_pos, '\n', buffer.size() - read_pos);
+        if (!nl) {
+            return false;
+        }
+        size_t line_end = static_cast<const char*>(nl) - base;
+        size_t line_begin = read_pos;
+        read_pos = line_end + 1;
+        if (line_end > line_begin && base[line_end - 1] == '\r') {
+            --line_end;
+        }
+
+        if (line_end == line_begin) {
+            // 空行：事件结束
+            if (data_lines > 0) {
+                dispatch(event);
+                event_start = read_pos;
+                return true;
+            }
+            clear_event_fields();
+            event_start = read_pos;
+            continue;
+        }
+        process_line(line_begin, line_end);
+    }
+    return false;
+}
+
+bool SseParser::finish(SseEvent& event) {
+    if (read_pos < buffer.size()) {
+        size_t line_end = buffer.size();
+        if (buffer[line_end - 1] == '\r') {
+            --line_end;
+        }
+        if (line_end > read_pos) {
+            process_line(read_pos, line_end);
+        }
+        read_pos = buffer.size();
+    }
+    if (data_lines == 0) {
+        clear_event_fields();
+        event_start = read_pos;
+        return false;
+    }
+    dispatch(event);
+    event_start = read_pos;
+    return true;
+}
+
+void SseParser::reset() {
+    buffer.clear();
+    read_pos = 0;
+    event_start = 0;
+    clear_event_fields();
+    last_event_id.clear();
+    retry = -1;
+}
+
+void SseParser::process_line(size_t begin, size_t end) {
+    const char* line = buffer.data() + begin;
+    size_t length = end - begin;
+
+    if (line[0] == ':') {
+        return; // 注释行
+    }
+
+    size_t field_length = length;
+    size_t value_begin = end;
+    if (const void* colon = std::memchr(line, ':', length)) {
+        field_length = static_cast<const char*>(colon) - line;
+        value_begin = begin + field_length + 1;
+        if (value_begin < end && buffer[value_begin] == ' ') {
+            ++value_begin; // 去掉冒号后的单个空格
+        }
+    }
+    std::string_view field(line, field_length);
+
+    if (field == "data") {
+        if (data_lines == 0) {
+            // 单行 data 直接引用缓冲区，不做任何拷贝
+            data_begin = value_begin;
+            data_end = end;
+        } else {
+            if (data_lines == 1) {
+                joined_data.assign(buffer, data_begin, data_end - data_begin);
+            }
+            joined_data.push_back('\n');
+            joined_data.append(buffer, value_begin, end - value_begin);
+        }
+        ++data_lines;
+    } else if (field == "event") {
+        type_begin = value_begin;
+        type_end = end;
+        has_type = true;
+    } else if (field == "id") {
+        std::string_view value(buffer.data() + value_begin, end - value_begin);
+        if (value.find('\0') == std::string_view::npos) {
+            last_event_id.assign(value.data(), value.size());
+        }
+    } else if (field == "retry") {
+        long parsed = 0;
+        bool valid = value_begin < end;
+        for (size_t i = value_begin; i < end; ++i) {
+            char c = buffer[i];
+            if (c < '0' || c > '9') {
+                valid = false;
+                break;
+            }
+            parsed = parsed * 10 + (c - '0');
+        }
+        if (valid) {
+            retry = parsed;
+        }
+    }
+    // 其他字段按规范忽略
+}
+
+void SseParser::dispatch(SseEvent& event) {
+    if (data_lines == 1) {
+        event.data = std::string_view(buffer.data() + data_begin, data_end - data_begin);
+    } else {
+        event.data = joined_data;
+    }
+    if (has_type && type_end > type_begin) {
+        event.event = std::string_view(buffer.data() + type_begin, type_end - type_begin);
+    } else {
+        event.event = "message";
+    }
+    event.id = last_event_id;
+    clear_event_fields();
+}
+
+void SseParser::clear_event_fields() {
+    data_begin = data_end = 0;
+    data_lines = 0;
+    type_begin = type_end = 0;
+    has_type = false;
+    // joined_data 保留容量，下次多行事件时复用
+}
@@ -0,0 +1,252 @@
+#include "TerminalRenderer.h"
+#include "Color.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+namespace {
+    // 一个槽位渲染后最多产生的字节数（内容 + 暂存的反引号 + 颜色控制序列），用于判断帧缓冲是否快满
+    constexpr size_t kMaxSlotOutput = 512;
+}
+
+TerminalRenderer::TerminalRenderer(std::chrono::milliseconds flush_interval)
+    : slots(new Slot[kSlotCount]), flush_interval(flush_interval) {
+    frame.reserve(kFrameBytes);
+    last_write = std::chrono::steady_clock::now() - flush_interval;
+    render_thread = std::thread([this]() { render_loop(); });
+}
+
+TerminalRenderer::~TerminalRenderer() {
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex);
+        stopping = true;
+    }
+    wake_cv.notify_all();
+    if (render_thread.joinable()) {
+        render_thread.join();
+    }
+}
+
+void TerminalRenderer::begin_stream() {
+    std::cout.flush();
+    std::fflush(stdout);
+}
+
+void TerminalRenderer::markdown(std::string_view text) {
+    if (!text.empty()) {
+        push(EventKind::Markdown, text);
+    }
+}
+
+void TerminalRenderer::plain(std::string_view text) {
+    if (!text.empty()) {
+        push(EventKind::Plain, text);
+    }
+}
+
+void TerminalRenderer::tool_code_begin() {
+    push(EventKind::ToolCodeBegin);
+}
+
+void TerminalRenderer::tool_code_end() {
+    push(EventKind::ToolCodeEnd);
+}
+
+void TerminalRenderer::end_stream() {
+    push(EventKind::EndStream);
+    flush();
+}
+
+void TerminalRenderer::flush() {
+    uint64_t target = ++barriers_requested;
+    barrier_pending = true;
+    push(EventKind::Barrier);
+    {
+        // 渲染线程可能正在等待帧边界，屏障需要立即处理
+        std::lock_guard<std::mutex> lock(wake_mutex);
+        wake_cv.notify_one();
+    }
+    std::unique_lock<std::mutex> lock(barrier_mutex);
+    barrier_cv.wait(lock, [this, target]() { return barriers_completed >= target; });
+}
+
+void TerminalRenderer::push(EventKind kind, std::string_view text) {
+    size_t offset = 0;
+    do {
+        size_t length = std::min(text.size() - offset, kSlotBytes);
+        size_t t = tail.load(std::memory_order_relaxed);
+        while (t - head.load(std::memory_order_acquire) >= kSlotCount) {
+            // 队列已满：渲染线程落后太多，只能等它腾出槽位
+            wake();
+            std::this_thread::yield();
+        }
+        Slot& slot = slots[t & (kSlotCount - 1)];
+        slot.kind = kind;
+        slot.length = static_cast<uint16_t>(length);
+        if (length > 0) {
+            std::memcpy(slot.data, text.data() + offset, length);
+        }
+        tail.store(t + 1);
+        offset += length;
+    } while (offset < text.size());
+    wake();
+}
+
+void TerminalRenderer::wake() {
+    if (sleeping.load()) {
+        std::lock_guard<std::mutex> lock(wake_mutex);
+        wake_cv.notify_one();
+    }
+}
+
+void TerminalRenderer::render_loop() {
+    Trace::set_thread_name("render");
+    while (true) {
+        if (drain()) {
+            continue;
+        }
+
+        if (!frame.empty()) {
+            auto deadline = last_write + flush_interval;
+            if (stopping || std::chrono::steady_clock::now() >= deadline) {
+                write_frame();
+                continue;
+            }
+            // 等到帧边界，期间到达的数据会合并进同一帧；屏障和退出会提前唤醒
+            std::unique_lock<std::mutex> lock(wake_mutex);
+            wake_cv.wait_until(lock, deadline, [this]() { return stopping.load() || barrier_pending.load(); });
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(wake_mutex);
+        sleeping = true;
+        wake_cv.wait(lock, [this]() { return stopping.load() || head.load(std::memory_order_relaxed) != tail.load(); });
+        sleeping = false;
+        if (stopping && head.load(std::memory_order_relaxed) == tail.load()) {
+            lock.unlock();
+            write_frame();
+            return;
+        }
+    }
+}
+
+bool TerminalRenderer::drain() {
+    size_t h = head.load(std::memory_order_relaxed);
+    size_t t = tail.load(std::memory_order_acquire);
+    if (h == t) {
+        return false;
+    }
+    TraceSpan span("render.drain", "render");
+    while (h != t) {
+        const Slot& slot = slots[h & (kSlotCount - 1)];
+        switch (slot.kind) {
+            case EventKind::Markdown:
+                render_markdown(slot.data, slot.length);
+                break;
+            case EventKind::Plain:
+                append(slot.data, slot.length);
+                break;
+            case EventKind::ToolCodeBegin:
+                append(Color::LIGHT_PINK.data(), Color::LIGHT_PINK.size());
+                append("\n", 1); // Add an extra newline for tool code
+                break;
+            case EventKind::ToolCodeEnd:
+                append(Color::RESET.data(), Color::RESET.size());
+                break;
+            case EventKind::EndStream:
+                finish_markdown();
+                break;
+            case EventKind::Barrier: {
+                head.store(++h, std::memory_order_release);
+                barrier_pending = false;
+                write_frame();
+                {
+                    std::lock_guard<std::mutex> lock(barrier_mutex);
+                    ++barriers_completed;
+                }
+                barrier_cv.notify_all();
+                return true;
+            }
+        }
+        head.store(++h, std::memory_order_release);
+
+        if (frame.size() + kMaxSlotOutput > kFrameBytes) {
+            write_frame();
+        }
+        if (h == t) {
+            t = tail.load(std::memory_order_acquire);
+        }
+    }
+    return false;
+}
+
+void TerminalRenderer::render_markdown(const char* data, size_t length) {
+    size_t i = 0;
+    while (i < length) {
+        if (fence_state == FenceState::Language) {
+            // 围栏后的语言标识不输出，直到换行才进入代码块
+            const void* newline = std::memchr(data + i, '\n', length - i);
+            if (!newline) {
+                return;
+            }
+            i = static_cast<size_t>(static_cast<const char*>(newline) - data) + 1;
+            append(Color::YELLOW.data(), Color::YELLOW.size());
+            fence_state = FenceState::Code;
+            continue;
+        }
+
+        if (data[i] == '`') {
+            ++i;
+            if (++pending_backticks == 3) {
+                pending_backticks = 0;
+                if (fence_state == FenceState::Text) {
+                    fence_state = FenceState::Language;
+                } else {
+                    append(Color::RESET.data(), Color::RESET.size()); // End yellow color, no extra newline
+                    fence_state = FenceState::Text;
+                }
+            }
+            continue;
+        }
+
+        if (pending_backticks > 0) {
+            // 不足三个的反引号只是普通文本
+            append("``", static_cast<size_t>(pending_backticks));
+            pending_backticks = 0;
+        }
+        size_t end = i + 1;
+        while (end < length && data[end] != '`') {
+            ++end;
+        }
+        append(data + i, end - i);
+        i = end;
+    }
+}
+
+void TerminalRenderer::finish_markdown() {
+    if (pending_backticks > 0) {
+        append("``", static_cast<size_t>(pending_backticks));
+    }
+    // Ensure color is reset if a markdown code block was left open
+    if (fence_state == FenceState::Code) {
+        append(Color::RESET.data(), Color::RESET.size());
+    }
+    pending_backticks = 0;
+    fence_state = FenceState::Text;
+}
+
+void TerminalRenderer::append(const char* data, size_t length) {
+    frame.append(data, length);
+}
+
+void TerminalRenderer::write_frame() {
+    if (!frame.empty()) {
+        TraceSpan span("render.write", "render");
+        std::fwrite(frame.data(), 1, frame.size(), stdout);
+        frame.clear();
+    }
+    std::fflush(stdout);
+    last_write = std::chrono::steady_clock::now();
+}
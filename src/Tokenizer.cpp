@@ -0,0 +1,182 @@
+#include "Tokenizer.h"
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+    constexpr size_t kMaxPieceBytes = 256;     // 超长片段分段合并，避免平方级的合并开销
+    constexpr size_t kMaxPieceCacheEntries = 1 << 17;
+
+    int base64_value(char c) {
+        if (c >= 'A' && c <= 'Z') return c - 'A';
+        if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+        if (c >= '0' && c <= '9') return c - '0' + 52;
+        if (c == '+') return 62;
+        if (c == '/') return 63;
+        return -1;
+    }
+
+    bool base64_decode(std::string_view input, std::string& output) {
+        uint32_t accumulator = 0;
+        int bits = 0;
+        for (char c : input) {
+            if (c == '=') {
+                break;
+            }
+            int value = base64_value(c);
+            if (value < 0) {
+                return false;
+            }
+            accumulator = (accumulator << 6) | static_cast<uint32_t>(value);
+            bits += 6;
+            if (bits >= 8) {
+                bits -= 8;
+                output.push_back(static_cast<char>((accumulator >> bits) & 0xFF));
+            }
+        }
+        return true;
+    }
+
+    // 非ASCII字节一律视为字母，这是对 \p{L} 的近似
+    bool is_letter(unsigned char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c >= 0x80; }
+    bool is_digit(unsigned char c) { return c >= '0' && c <= '9'; }
+    bool is_space(unsigned char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f'; }
+    bool is_newline(unsigned char c) { return c == '\n' || c == '\r'; }
+    bool is_punct(unsigned char c) { return !is_space(c) && !is_letter(c) && !is_digit(c); }
+    char lower(char c) { return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c; }
+
+    // 返回从 i 开始的预分词片段长度，近似 cl100k_base 的切分规则
+    size_t next_piece_length(std::string_view text, size_t i) {
+        const size_t n = text.size();
+        auto at = [&](size_t k) { return static_cast<unsigned char>(text[k]); };
+        unsigned char c = at(i);
+
+        if (c == '\'' && i + 1 < n) {
+            char a = lower(text[i + 1]);
+            if (a == 's' || a == 't' || a == 'm' || a == 'd') return 2;
+            if (i + 2 < n) {
+                char b = lower(text[i + 2]);
+                if ((a == 'r' && b == 'e') || (a == 'v' && b == 'e') || (a == 'l' && b == 'l')) return 3;
+            }
+        }
+
+        if (is_letter(c) || (!is_digit(c) && !is_newline(c) && i + 1 < n && is_letter(at(i + 1)))) {
+            size_t j = i + 1;
+            while (j < n && is_letter(at(j))) ++j;
+            return j - i;
+        }
+
+        if (is_digit(c)) {
+            size_t j = i + 1;
+            while (j < n && j - i < 3 && is_digit(at(j))) ++j;
+            return j - i;
+        }
+
+        if (is_punct(c) || (c == ' ' && i + 1 < n && is_punct(at(i + 1)))) {
+            size_t j = (c == ' ') ? i + 1 : i;
+            while (j < n && is_punct(at(j))) ++j;
+            while (j < n && is_newline(at(j))) ++j;
+            return j - i;
+        }
+
+        // 空白：包含换行时在最后一个换行后切开；否则把最后一个空格留给后面的单词
+        size_t j = i;
+        size_t last_newline = std::string_view::npos;
+        while (j < n && is_space(at(j))) {
+            if (is_newline(at(j))) last_newline = j;
+            ++j;
+        }
+        if (last_newline != std::string_view::npos) return last_newline + 1 - i;
+        if (j < n && j - i > 1) return j - i - 1;
+        return j - i;
+    }
+}
+
+void Tokenizer::load(const std::string& path) {
+    std::ifstream f(path, std::ios::binary);
+    if (!f.is_open()) {
+        throw std::runtime_error("Could not open tokenizer vocabulary: " + path);
+    }
+
+    struct Token { size_t offset; size_t length; uint32_t rank; };
+    std::vector<Token> tokens;
+    std::string storage;
+    std::string line;
+    size_t line_number = 0;
+    while (std::getline(f, line)) {
+        ++line_number;
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty()) continue;
+        size_t space = line.find(' ');
+        if (space == std::string::npos) {
+            throw std::runtime_error("Invalid tokenizer vocabulary line " + std::to_string(line_number) + " in " + path);
+        }
+        size_t offset = storage.size();
+        if (!base64_decode(std::string_view(line).substr(0, space), storage)) {
+            throw std::runtime_error("Invalid base64 token on line " + std::to_string(line_number) + " in " + path);
+        }
+        tokens.push_back({offset, storage.size() - offset, static_cast<uint32_t>(std::stoul(line.substr(space + 1)))});
+    }
+
+    // 先完成存储再建立视图，保证视图不会因为重新分配而失效
+    vocab_storage = std::move(storage);
+    ranks.clear();
+    ranks.reserve(tokens.size());
+    for (const auto& token : tokens) {
+        ranks.emplace(std::string_view(vocab_storage).substr(token.offset, token.length), token.rank);
+    }
+    piece_cache.clear();
+}
+
+size_t Tokenizer::count(std::string_view text) const {
+    if (!loaded()) {
+        return (text.size() + 3) / 4;
+    }
+    size_t total = 0;
+    for (size_t i = 0; i < text.size();) {
+        size_t length = next_piece_length(text, i);
+        std::string_view piece = text.substr(i, length);
+        for (size_t p = 0; p < piece.size(); p += kMaxPieceBytes) {
+            total += count_piece(piece.substr(p, kMaxPieceBytes));
+        }
+        i += length;
+    }
+    return total;
+}
+
+size_t Tokenizer::count_piece(std::string_view piece) const {
+    if (ranks.count(piece)) {
+        return 1;
+    }
+    std::string key(piece);
+    auto cached = piece_cache.find(key);
+    if (cached != piece_cache.end()) {
+        return cached->second;
+    }
+
+    // 经典的字节级 BPE：反复合并 rank 最小的相邻对
+    std::vector<size_t> bounds(piece.size() + 1);
+    for (size_t k = 0; k <= piece.size(); ++k) bounds[k] = k;
+    while (bounds.size() > 2) {
+        uint32_t best_rank = std::numeric_limits<uint32_t>::max();
+        size_t best_index = 0;
+        for (size_t k = 0; k + 2 < bounds.size(); ++k) {
+            auto it = ranks.find(piece.substr(bounds[k], bounds[k + 2] - bounds[k]));
+            if (it != ranks.end() && it->second < best_rank) {
+                best_rank = it->second;
+                best_index = k;
+            }
+        }
+        if (best_rank == std::numeric_limits<uint32_t>::max()) {
+            break;
+        }
+        bounds.erase(bounds.begin() + static_cast<std::ptrdiff_t>(best_index + 1));
+    }
+
+    uint32_t result = static_cast<uint32_t>(bounds.size() - 1);
+    if (piece_cache.size() >= kMaxPieceCacheEntries) {
+        piece_cache.clear();
+    }
+    piece_cache.emplace(std::move(key), result);
+    return result;
+}
@@ -0,0 +1,239 @@
+#include "ToolArgsDecoder.h"
+
+namespace {
+    constexpr uint32_t kReplacementChar = 0xFFFD;
+
+    int hex_value(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+}
+
+ToolArgsDecoder::ToolArgsDecoder(std::string field) : field_name(std::move(field)) {}
+
+void ToolArgsDecoder::reset() {
+    arguments.clear();
+    decoded.clear();
+    key.clear();
+    depth = 0;
+    in_string = false;
+    expect_key = false;
+    key_matches = false;
+    field_started = false;
+    field_finished = false;
+    object_closed = false;
+    target = StringTarget::None;
+    escape = Escape::None;
+    code_unit = 0;
+    high_surrogate = 0;
+    hex_digits = 0;
+}
+
+std::string_view ToolArgsDecoder::feed(std::string_view fragment) {
+    size_t decoded_before = decoded.size();
+    arguments.append(fragment.data(), fragment.size());
+
+    size_t i = 0;
+    while (i < fragment.size()) {
+        char c = fragment[i];
+
+        if (in_string) {
+            if (escape == Escape::None && c != '\\' && c != '"') {
+                // 快速路径：批量复制不含转义和引号的连续字节
+                size_t end = i + 1;
+                while (end < fragment.size() && fragment[end] != '\\' && fragment[end] != '"') {
+                    ++end;
+                }
+                if (target == StringTarget::Field) {
+                    decoded.append(fragment.data() + i, end - i);
+                } else if (target == StringTarget::Key) {
+                    key.append(fragment.data() + i, end - i);
+                }
+                i = end;
+                continue;
+            }
+            consume_string_byte(c);
+            ++i;
+            continue;
+        }
+
+        switch (c) {
+            case '"':
+                in_string = true;
+                if (depth == 1 && expect_key) {
+                    target = StringTarget::Key;
+                    key.clear();
+                } else if (depth == 1 && key_matches && !field_started) {
+                    target = StringTarget::Field;
+                    field_started = true;
+                } else {
+                    target = StringTarget::Skip;
+                }
+                break;
+            case '{':
+            case '[':
+                ++depth;
+                if (depth == 1) {
+                    expect_key = (c == '{');
+                }
+                break;
+            case '}':
+            case ']':
+                --depth;
+                if (depth == 0 && c == '}') {
+                    object_closed = true;
+                }
+                break;
+            case ',':
+                if (depth == 1) {
+                    expect_key = true;
+                    key_matches = false;
+                }
+                break;
+            case ':':
+                if (depth == 1) {
+                    expect_key = false;
+                }
+                break;
+            default:
+                // 数字、字面量和空白不影响结构状态
+                break;
+        }
+        ++i;
+    }
+
+    return std::string_view(decoded).substr(decoded_before);
+}
+
+void ToolArgsDecoder::consume_string_byte(char c) {
+    switch (escape) {
+        case Escape::None:
+            if (c == '\\') {
+                escape = Escape::Backslash;
+            } else if (c == '"') {
+                in_string = false;
+                if (target == StringTarget::Key) {
+                    key_matches = (key == field_name);
+                } else if (target == StringTarget::Field) {
+                    field_finished = true;
+                }
+                target = StringTarget::None;
+            } else {
+                append_output(c);
+            }
+            return;
+
+        case Escape::Backslash:
+            escape = Escape::None;
+            switch (c) {
+                case 'n': append_output('\n'); break;
+                case 't': append_output('\t'); break;
+                case 'r': append_output('\r'); break;
+                case 'b': append_output('\b'); break;
+                case 'f': append_output('\f'); break;
+                case 'u':
+                    escape = Escape::Unicode;
+                    code_unit = 0;
+                    hex_digits = 0;
+                    break;
+                default:
+                    // '"'、'\\'、'/' 以及非法转义都按字面输出
+                    append_output(c);
+                    break;
+            }
+            return;
+
+        case Escape::Unicode: {
+            int value = hex_value(c);
+            if (value < 0) {
+                // 非法的 \u 序列：输出替换字符并把当前字节当作普通字符处理
+                escape = Escape::None;
+                high_surrogate = 0;
+                append_code_point(kReplacementChar);
+                consume_string_byte(c);
+                return;
+            }
+            code_unit = (code_unit << 4) | static_cast<uint32_t>(value);
+            if (++hex_digits == 4) {
+                finish_code_unit();
+            }
+            return;
+        }
+
+        case Escape::HighSurrogate:
+            if (c == '\\') {
+                escape = Escape::HighSurrogateBackslash;
+                return;
+            }
+            // 高位代理后面没有跟低位代理
+            escape = Escape::None;
+            high_surrogate = 0;
+            append_code_point(kReplacementChar);
+            consume_string_byte(c);
+            return;
+
+        case Escape::HighSurrogateBackslash:
+            if (c == 'u') {
+                escape = Escape::Unicode;
+                code_unit = 0;
+                hex_digits = 0;
+                return;
+            }
+            escape = Escape::Backslash;
+            high_surrogate = 0;
+            append_code_point(kReplacementChar);
+            consume_string_byte(c);
+            return;
+    }
+}
+
+void ToolArgsDecoder::finish_code_unit() {
+    escape = Escape::None;
+
+    if (high_surrogate != 0) {
+        uint32_t high = high_surrogate;
+        high_surrogate = 0;
+        if (code_unit >= 0xDC00 && code_unit <= 0xDFFF) {
+            append_code_point(0x10000 + ((high - 0xD800) << 10) + (code_unit - 0xDC00));
+            return;
+        }
+        append_code_point(kReplacementChar);
+    }
+
+    if (code_unit >= 0xD800 && code_unit <= 0xDBFF) {
+        high_surrogate = code_unit;
+        escape = Escape::HighSurrogate;
+    } else if (code_unit >= 0xDC00 && code_unit <= 0xDFFF) {
+        append_code_point(kReplacementChar);
+    } else {
+        append_code_point(code_unit);
+    }
+}
+
+void ToolArgsDecoder::append_output(char c) {
+    if (target == StringTarget::Field) {
+        decoded.push_back(c);
+    } else if (target == StringTarget::Key) {
+        key.push_back(c);
+    }
+}
+
+void ToolArgsDecoder::append_code_point(uint32_t cp) {
+    if (cp < 0x80) {
+        append_output(static_cast<char>(cp));
+    } else if (cp < 0x800) {
+        append_output(static_cast<char>(0xC0 | (cp >> 6)));
+        append_output(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        append_output(static_cast<char>(0xE0 | (cp >> 12)));
+        append_output(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        append_output(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else {
+        append_output(static_cast<char>(0xF0 | (cp >> 18)));
+        append_output(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+        append_output(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        append_output(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+}
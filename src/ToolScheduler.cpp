@@ -0,0 +1,84 @@
+#include "ToolScheduler.h"
+#include "Trace.h"
+
+ToolScheduler::ToolScheduler(size_t max_parallel) {
+    if (max_parallel < 1) {
+        max_parallel = 1;
+    }
+    workers.reserve(max_parallel);
+    for (size_t i = 0; i < max_parallel; ++i) {
+        workers.emplace_back([this]() { worker_loop(); });
+    }
+}
+
+ToolScheduler::~ToolScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cv.notify_all();
+    for (auto& worker : workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+}
+
+std::future<std::string> ToolScheduler::submit(std::function<std::string()> task, const std::string& lane) {
+    Job job{std::packaged_task<std::string()>(std::move(task)), lane};
+    std::future<std::string> result = job.task.get_future();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!lane.empty()) {
+            auto it = lanes.find(lane);
+            if (it != lanes.end()) {
+                // 通道正忙：排在该通道已有任务之后
+                it->second.push_back(std::move(job));
+                return result;
+            }
+            lanes.emplace(lane, std::deque<Job>());
+        }
+        ready.push_back(std::move(job));
+    }
+    cv.notify_one();
+    return result;
+}
+
+void ToolScheduler::worker_loop() {
+    Trace::set_thread_name("tool worker");
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [this]() { return stopping || !ready.empty(); });
+            if (ready.empty()) {
+                return; // stopping 且没有剩余任务
+            }
+            job = std::move(ready.front());
+            ready.pop_front();
+        }
+
+        // packaged_task 会把异常保存到 future 中
+        job.task();
+
+        if (!job.lane.empty()) {
+            bool promoted = false;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                auto it = lanes.find(job.lane);
+                if (it != lanes.end()) {
+                    if (it->second.empty()) {
+                        lanes.erase(it);
+                    } else {
+                        ready.push_back(std::move(it->second.front()));
+                        it->second.pop_front();
+                        promoted = true;
+                    }
+                }
+            }
+            if (promoted) {
+                cv.notify_one();
+            }
+        }
+    }
+}
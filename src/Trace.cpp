@@ -0,0 +1,185 @@
+#include "Trace.h"
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+std::atomic<bool> Trace::active{false};
+
+namespace {
+    struct Event {
+        const char* name;
+        const char* category;
+        uint64_t begin;
+        uint64_t end;
+    };
+
+    // 只由所属线程写入；count 以 release 发布，写文件的线程以 acquire 读取
+    struct Chunk {
+        static constexpr size_t kEvents = 4096;
+        Event events[kEvents];
+        std::atomic<size_t> count{0};
+        std::atomic<Chunk*> next{nullptr};
+    };
+
+    // 每个线程最多保留的块数（约一百万个事件），超出的事件只计数
+    constexpr size_t kMaxChunks = 256;
+
+    struct ThreadBuffer {
+        uint32_t tid = 0;
+        std::atomic<const char*> name{nullptr};
+        Chunk* head = nullptr;
+        Chunk* tail = nullptr;     // 只由所属线程访问
+        size_t chunks = 1;         // 只由所属线程访问
+        std::atomic<uint64_t> dropped{0};
+    };
+
+    // 缓冲区在进程退出之前一直保留：线程可能在写出文件之后才结束一个区间
+    struct Registry {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+        std::string path;
+        uint64_t origin = 0; // start() 时的时间，文件中的时间戳从这里算起
+        bool written = false;
+    };
+
+    Registry& registry() {
+        static Registry* instance = new Registry(); // 不析构：atexit 中的 finish() 之后仍可能有线程在记录
+        return *instance;
+    }
+
+    thread_local ThreadBuffer* local_buffer = nullptr;
+
+    ThreadBuffer& current_buffer() {
+        if (!local_buffer) {
+            auto buffer = std::make_unique<ThreadBuffer>();
+            buffer->head = buffer->tail = new Chunk();
+            Registry& reg = registry();
+            std::lock_guard<std::mutex> lock(reg.mutex);
+            buffer->tid = static_cast<uint32_t>(reg.buffers.size() + 1);
+            local_buffer = buffer.get();
+            reg.buffers.push_back(std::move(buffer));
+        }
+        return *local_buffer;
+    }
+
+    int process_id() {
+#ifdef _WIN32
+        return _getpid();
+#else
+        return static_cast<int>(getpid());
+#endif
+    }
+
+    // trace-event 的时间单位是微秒，保留到纳秒
+    void write_microseconds(std::FILE* file, uint64_t nanoseconds) {
+        std::fprintf(file, "%llu.%03llu", static_cast<unsigned long long>(nanoseconds / 1000),
+                     static_cast<unsigned long long>(nanoseconds % 1000));
+    }
+}
+
+uint64_t Trace::now() {
+    auto since_epoch = std::chrono::steady_clock::now().time_since_epoch();
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(since_epoch).count()) | 1;
+}
+
+bool Trace::start(const std::string& path) {
+    Registry& reg = registry();
+    {
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        // 先确认文件可以创建，避免运行结束后才发现记录白费
+        std::FILE* file = std::fopen(path.c_str(), "wb");
+        if (!file) {
+            return false;
+        }
+        std::fclose(file);
+        reg.path = path;
+        reg.origin = now();
+        reg.written = false;
+    }
+    active.store(true);
+    return true;
+}
+
+void Trace::set_thread_name(const char* name) {
+    if (enabled()) {
+        current_buffer().name.store(name, std::memory_order_release);
+    }
+}
+
+void Trace::record(const char* name, const char* category, uint64_t begin, uint64_t end) {
+    ThreadBuffer& buffer = current_buffer();
+    Chunk* chunk = buffer.tail;
+    size_t count = chunk->count.load(std::memory_order_relaxed);
+    if (count == Chunk::kEvents) {
+        if (buffer.chunks == kMaxChunks) {
+            buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        Chunk* fresh = new Chunk();
+        chunk->next.store(fresh, std::memory_order_release);
+        buffer.tail = chunk = fresh;
+        buffer.chunks++;
+        count = 0;
+    }
+    chunk->events[count] = Event{name, category, begin, end};
+    chunk->count.store(count + 1, std::memory_order_release);
+}
+
+void Trace::finish() {
+    if (!active.exchange(false)) {
+        return;
+    }
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    if (reg.written) {
+        return;
+    }
+    reg.written = true;
+
+    std::FILE* file = std::fopen(reg.path.c_str(), "wb");
+    if (!file) {
+        return;
+    }
+    int pid = process_id();
+    std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    std::fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":0,\"args\":{\"name\":\"code-atlas\"}}", pid);
+    for (const auto& buffer : reg.buffers) {
+        const char* name = buffer->name.load(std::memory_order_acquire);
+        if (name) {
+            std::fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":%s}}",
+                         pid, buffer->tid, nlohmann::json(name).dump().c_str());
+        }
+        uint64_t dropped = buffer->dropped.load(std::memory_order_relaxed);
+        if (dropped > 0) {
+            std::fprintf(file, ",\n{\"name\":\"dropped_events\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,\"args\":{\"count\":%llu}}",
+                         pid, buffer->tid, static_cast<unsigned long long>(dropped));
+        }
+        for (Chunk* chunk = buffer->head; chunk; chunk = chunk->next.load(std::memory_order_acquire)) {
+            size_t count = chunk->count.load(std::memory_order_acquire);
+            for (size_t i = 0; i < count; ++i) {
+                const Event& event = chunk->events[i];
+                if (event.begin < reg.origin) {
+                    continue; // 开始记录之前开始的区间
+                }
+                std::fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%u,\"ts\":",
+                             event.name, event.category, pid, buffer->tid);
+                write_microseconds(file, event.begin - reg.origin);
+                std::fputs(",\"dur\":", file);
+                write_microseconds(file, event.end - event.begin);
+                std::fputc('}', file);
+            }
+        }
+    }
+    std::fprintf(file, "\n]}\n");
+    std::fclose(file);
+}
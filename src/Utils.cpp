@@ -1,16 +1,26 @@
 #include "Utils.h"
 #include <vector>
 #include <algorithm>
+#include <atomic>
 #include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <thread>
 
 #ifdef _WIN32
 #include <windows.h>
+#include <process.h>
 #elif defined(__APPLE__)
 #include <sys/utsname.h>
 #elif defined(__linux__)
 #include <sys/utsname.h>
 #endif
 
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
 std::string unescape_string(std::string s) {
     size_t pos = 0;
     while ((pos = s.find("\\\\", pos)) != std::string::npos) { s.replace(pos, 2, "\\"); pos += 1; }
@@ -97,46 +107,70 @@ std::string os_to_string(OperatingSystem os) {
     }
 }
 
-bool is_powershell_available() {
-    OperatingSystem os = detect_operating_system();
-
-    if (os == OperatingSystem::Windows) {
-        // On Windows, PowerShell is typically available
-        return true;
-    } else {
-        // On Linux/macOS, check if pwsh (PowerShell Core) is available
-        int result = std::system("pwsh -v > /dev/null 2>&1");
-        return (result == 0);
-    }
-}
-
-std::vector<std::string> get_supported_shells() {
-    std::vector<std::string> shells;
-    OperatingSystem os = detect_operating_system();
-
-    // Python is supported on all platforms
-    shells.push_back("python");
-
+std::string os_prompt_suffix(OperatingSystem os) {
     switch (os) {
         case OperatingSystem::Windows:
-            shells.push_back("batch");
-            if (is_powershell_available()) {
-                shells.push_back("powershell");
-            }
-            break;
+            return "\n\n**You are currently working on Windows.**";
         case OperatingSystem::Linux:
+            return "\n\n**You are currently working on Linux.**";
         case OperatingSystem::MacOS:
-            shells.push_back("bash");
-            if (is_powershell_available()) {
-                shells.push_back("powershell");
-            }
-            break;
+            return "\n\n**You are currently working on macOS.**";
         case OperatingSystem::Unknown:
         default:
-            // For unknown OS, try bash as a fallback
-            shells.push_back("bash");
-            break;
+            return "\n\n**You are currently working on an unknown operating system.**";
+    }
+}
+
+std::string cache_directory() {
+#ifdef _WIN32
+    const char* local_app_data = std::getenv("LOCALAPPDATA");
+    return (local_app_data && *local_app_data) ? std::string(local_app_data) + "\\code-atlas" : "";
+#else
+    const char* xdg_cache = std::getenv("XDG_CACHE_HOME");
+    if (xdg_cache && *xdg_cache) {
+        return std::string(xdg_cache) + "/code-atlas";
+    }
+    const char* home = std::getenv("HOME");
+    return (home && *home) ? std::string(home) + "/.cache/code-atlas" : "";
+#endif
+}
+
+bool write_file_atomically(const std::string& path, const std::string& content) {
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    fs::path target(path);
+    if (target.has_parent_path()) {
+        fs::create_directories(target.parent_path(), ec);
     }
 
-    return shells;
+    // 临时文件名由进程号、线程和进程内计数组成，多个实例写同一个文件时也不会互相覆盖
+#ifdef _WIN32
+    const int pid = _getpid();
+#else
+    const int pid = static_cast<int>(getpid());
+#endif
+    static std::atomic<unsigned long> temp_counter{0};
+    fs::path temp = target;
+    temp += "." + std::to_string(pid) + "_" +
+            std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + "_" +
+            std::to_string(temp_counter++) + ".tmp";
+    {
+        std::ofstream file(temp, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!file) {
+            return false;
+        }
+        file << content;
+        // 磁盘写满之类的错误可能要到刷新时才出现，关闭后再检查一次，失败就不改名
+        file.close();
+        if (!file) {
+            fs::remove(temp, ec);
+            return false;
+        }
+    }
+    fs::rename(temp, target, ec);
+    if (ec) {
+        fs::remove(temp, ec);
+        return false;
+    }
+    return true;
 }
@@ -0,0 +1,86 @@
+#include "Watchdog.h"
+
+Watchdog& Watchdog::instance() {
+    static Watchdog watchdog;
+    return watchdog;
+}
+
+Watchdog::~Watchdog() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cv.notify_all();
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+uint64_t Watchdog::arm(Clock::duration delay, std::function<void()> on_expire, Clock::duration repeat) {
+    uint64_t id;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        id = next_id++;
+        entries.emplace(id, Entry{Clock::now() + delay, repeat, std::move(on_expire)});
+        if (!thread.joinable()) {
+            thread = std::thread([this]() { run(); });
+        }
+    }
+    cv.notify_all();
+    return id;
+}
+
+void Watchdog::disarm(uint64_t id) {
+    std::unique_lock<std::mutex> lock(mutex);
+    entries.erase(id);
+    cv.wait(lock, [this, id]() { return running_id != id; });
+}
+
+void Watchdog::expire_all() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Clock::time_point now = Clock::now();
+        for (auto& entry : entries) {
+            entry.second.when = now;
+        }
+    }
+    cv.notify_all();
+}
+
+void Watchdog::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping) {
+        // 截止时间很少同时超过几个，线性查找最早的一个即可
+        auto earliest = entries.end();
+        for (auto it = entries.begin(); it != entries.end(); ++it) {
+            if (earliest == entries.end() || it->second.when < earliest->second.when) {
+                earliest = it;
+            }
+        }
+        if (earliest == entries.end()) {
+            cv.wait(lock);
+            continue;
+        }
+        if (Clock::now() < earliest->second.when) {
+            // 复制一份：等待期间 disarm() 可能删除这个条目，wait_until 醒来后还会读取时间点
+            Clock::time_point when = earliest->second.when;
+            cv.wait_until(lock, when);
+            continue; // 期间可能有新的或被取消的截止时间，重新查找
+        }
+
+        uint64_t id = earliest->first;
+        std::function<void()> on_expire = earliest->second.on_expire;
+        if (earliest->second.repeat > Clock::duration::zero()) {
+            earliest->second.when = Clock::now() + earliest->second.repeat;
+        } else {
+            entries.erase(earliest);
+        }
+
+        running_id = id;
+        lock.unlock();
+        on_expire();
+        lock.lock();
+        running_id = 0;
+        cv.notify_all(); // 唤醒等待这个回调结束的 disarm()
+    }
+}
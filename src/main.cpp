@@ -2,56 +2,305 @@
 #include <string>
 #include <vector>
 #include <csignal>
+#include <cstdlib>
 #include <algorithm>
+#include <future>
+#include <map>
+#include <memory>
 #include <nlohmann/json.hpp>
 #include "Config.h"
 #include "ApiClient.h"
+#include "ConversationHistory.h"
+#include "ContextManager.h"
 #include "CodeExecutor.h"
+#include "BashSessionPool.h"
+#include "ResourceUsage.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include "Watchdog.h"
+#include "LiveOutput.h"
+#include "ToolScheduler.h"
+#include "CapabilityRegistry.h"
+#include "PythonSyntaxChecker.h"
 #include "Utils.h"
 #include "Color.h"
 
 #ifdef _WIN32
 #include <windows.h>
+#else
+#include <pthread.h>
 #endif
 
-// Global pointer for signal handler
-PythonExecutor* g_python_executor = nullptr;
+// Set by the SIGINT handler; the main thread notices it, stops what is running and returns from main_loop
+volatile std::sig_atomic_t g_interrupted = 0;
+#ifndef _WIN32
+pthread_t g_main_thread;
+#endif
 
 void signal_handler(int signum) {
-    std::cout << "\n[INFO] Exiting gracefully." << std::endl;
-    // Ensure Python interpreter is properly closed before exit
-    if (g_python_executor) {
-        delete g_python_executor;
-        g_python_executor = nullptr;
+#ifndef _WIN32
+    if (!pthread_equal(pthread_self(), g_main_thread)) {
+        // Hand it to the main thread, so a blocking read there returns with EINTR
+        pthread_kill(g_main_thread, signum);
+        return;
+    }
+#endif
+    if (g_interrupted) {
+        // A second Ctrl+C while shutting down leaves at once
+        std::_Exit(128 + signum);
+    }
+    g_interrupted = 1;
+}
+
+// Waits for a tool result; returns false if Ctrl+C was pressed first
+bool wait_for_result(std::future<std::string>& result) {
+    while (result.wait_for(std::chrono::milliseconds(100)) != std::future_status::ready) {
+        if (g_interrupted) {
+            return false;
+        }
     }
-    exit(signum);
+    return true;
+}
+
+// Time limits for tool calls, in seconds; 0 means unlimited
+struct ToolTimeouts {
+    double default_seconds = 300;
+    double max_seconds = 3600;                  // upper bound for a per-call "timeout" argument
+    std::map<std::string, double> per_tool;     // overrides default_seconds for a tool name
+
+    explicit ToolTimeouts(const nlohmann::json& config) {
+        if (!config.contains("execution")) {
+            return;
+        }
+        const auto& execution = config["execution"];
+        if (execution.contains("timeout_seconds")) {
+            default_seconds = execution["timeout_seconds"].get<double>();
+        }
+        if (execution.contains("max_timeout_seconds")) {
+            max_seconds = execution["max_timeout_seconds"].get<double>();
+        }
+        if (execution.contains("tool_timeouts") && execution["tool_timeouts"].is_object()) {
+            for (const auto& [name, seconds] : execution["tool_timeouts"].items()) {
+                per_tool[name] = seconds.get<double>();
+            }
+        }
+    }
+
+    // The limit for one call: its own "timeout" argument if given (capped by max_seconds), else the tool's setting
+    std::chrono::milliseconds for_call(const std::string& tool_name, const nlohmann::json& arguments) const {
+        auto it = per_tool.find(tool_name);
+        double seconds = it != per_tool.end() ? it->second : default_seconds;
+        if (arguments.contains("timeout") && arguments["timeout"].is_number() && arguments["timeout"].get<double>() > 0) {
+            seconds = arguments["timeout"].get<double>();
+            if (max_seconds > 0) {
+                seconds = std::min(seconds, max_seconds);
+            }
+        }
+        return std::chrono::milliseconds(static_cast<long long>(std::max(seconds, 0.0) * 1000));
+    }
+};
+
+// Runs a single tool call and returns its JSON result string
+std::string run_tool_call(const ToolCall& tool_call, PythonExecutor& python_executor, BashSessionPool* bash_sessions,
+                          const ToolTimeouts& timeouts, const ResourceLimits& limits,
+                          const OutputCapture::Options& output) {
+    std::string result;
+    std::string tool_name = "unknown";
+    try {
+        tool_name = tool_call.function["name"];
+        auto arguments = nlohmann::json::parse(tool_call.function["arguments"].get<std::string>());
+        std::string code_to_run = arguments["code"];
+        auto timeout = timeouts.for_call(tool_name, arguments);
+        std::string session;
+        if (arguments.contains("session") && arguments["session"].is_string()) {
+            session = arguments["session"].get<std::string>();
+        }
+
+        if (tool_name == "python") {
+            result = python_executor.execute(code_to_run, timeout, session);
+        } else {
+            // Check if the requested shell is supported on this OS (probed once at startup)
+            if (CapabilityRegistry::instance().is_available(tool_name)) {
+                if (tool_name == "bash" && bash_sessions) {
+                    result = execute_shell_session(*bash_sessions, session, code_to_run, timeout);
+                } else {
+                    result = execute_shell_code(tool_name, code_to_run, timeout, limits, output);
+                }
+            } else {
+                nlohmann::json error_json;
+                error_json["status"] = "error";
+                error_json["output"] = "Error: Shell '" + tool_name + "' is not supported on " + os_to_string(detect_operating_system());
+                result = error_json.dump();
+            }
+        }
+
+    } catch (const nlohmann::json::parse_error& e) {
+        nlohmann::json error_json;
+        error_json["status"] = "error";
+        error_json["output"] = "Error: Could not decode arguments: " + tool_call.function["arguments"].get<std::string>() + ". Details: " + e.what();
+        result = error_json.dump();
+    } catch (const std::exception& e) {
+        nlohmann::json error_json;
+        error_json["status"] = "error";
+        error_json["output"] = "Error: " + std::string(e.what());
+        result = error_json.dump();
+    }
+    return result;
+}
+
+// Prints one tool result block; index/count label the block when a turn has several calls
+void display_tool_result(const std::string& result, size_t index, size_t count) {
+    // The tool call header and code are streamed by ApiClient; we just print the output section.
+    if (count > 1) {
+        std::cout << "\n\n--- Output [" << (index + 1) << "/" << count << "] ---\n" << std::endl;
+    } else {
+        std::cout << "\n\n--- Output ---\n" << std::endl;
+    }
+
+    try {
+        nlohmann::json result_json = nlohmann::json::parse(result);
+        if (result_json.contains("status") && result_json["status"] == "success") {
+            std::string success_output = result_json["output"];
+            std::cout << Color::GREEN << format_output_for_display(success_output) << Color::RESET << std::endl;
+        } else {
+            std::cout << Color::RED << format_output_for_display(result) << Color::RESET << std::endl;
+        }
+    } catch (const nlohmann::json::parse_error& e) {
+        // If result is not a valid JSON, print as is in red.
+        std::cout << Color::RED << format_output_for_display(result) << Color::RESET << std::endl;
+    }
+    std::cout << "\n--------------" << std::endl;
 }
 
 void main_loop() {
     // Load configuration
-    auto config = load_config();
+    nlohmann::json config;
+    {
+        TraceSpan span("config.load", "startup");
+        config = load_config();
+    }
 
-    // Initialize API client and Python executor
+    // Probe the available interpreters in the background while the rest of startup runs
+    std::string capability_cache;
+    if (config.contains("execution") && config["execution"].contains("capability_cache") &&
+        config["execution"]["capability_cache"].is_string()) {
+        capability_cache = config["execution"]["capability_cache"].get<std::string>();
+    }
+    CapabilityRegistry::instance().start(capability_cache);
+
+    // Echoes python output to the terminal while a cell runs; declared first so it outlives the executor
+    bool live_output_enabled = !(config.contains("python") && config["python"].contains("live_output") &&
+                                 !config["python"]["live_output"].get<bool>());
+    int live_output_flush_ms = 100;
+    if (config.contains("python") && config["python"].contains("live_output_flush_ms")) {
+        live_output_flush_ms = config["python"]["live_output_flush_ms"].get<int>();
+    }
+    LiveOutput live_output{std::chrono::milliseconds(live_output_flush_ms)};
+
+    // Initialize Python executor and API client; the interpreter starts up in the background,
+    // and the API client waits for the probes to filter the tool list
+    PythonExecutor python_executor(config);
+    if (live_output_enabled) {
+        python_executor.set_live_output(&live_output);
+    }
     ApiClient api_client(config);
-    PythonExecutor python_executor;
-    g_python_executor = &python_executor; // Set global pointer
+    ContextManager context_manager(config);
+    ResourceLimits resource_limits(config);
+    OutputCapture::Options output_options(config);
+    MetricsExporter metrics_exporter(config);
+
+    // bash calls share a long-lived shell per session, so cd/export/source carry over between calls
+    std::unique_ptr<BashSessionPool> bash_sessions;
+    if (!(config.contains("bash") && config["bash"].contains("persistent") && !config["bash"]["persistent"].get<bool>())) {
+        BashSessionPool::Options bash_options;
+        bash_options.limits = resource_limits;
+        bash_options.output = output_options;
+        if (config.contains("bash") && config["bash"].contains("max_sessions")) {
+            bash_options.max_sessions = config["bash"]["max_sessions"].get<size_t>();
+        }
+        try {
+            bash_sessions = std::make_unique<BashSessionPool>(std::move(bash_options));
+        } catch (const std::exception&) {
+            // Not supported on this system: every bash call runs in a fresh process
+        }
+    }
+
+    size_t max_parallel_tools = 4;
+    if (config.contains("execution") && config["execution"].contains("max_parallel_tools")) {
+        max_parallel_tools = config["execution"]["max_parallel_tools"].get<size_t>();
+    }
+    ToolScheduler tool_scheduler(max_parallel_tools);
+
+    // Declared after the executor so it is destroyed while the interpreter is still alive
+    std::unique_ptr<PythonSyntaxChecker> syntax_checker;
+    if (!(config.contains("python") && config["python"].contains("syntax_check") &&
+          !config["python"]["syntax_check"].get<bool>())) {
+        syntax_checker = std::make_unique<PythonSyntaxChecker>(python_executor);
+        api_client.set_syntax_checker(syntax_checker.get());
+    }
+    api_client.set_interrupt_check([]() { return g_interrupted != 0; });
+    bool start_tools_early = !(config.contains("execution") && config["execution"].contains("start_tools_early") &&
+                               !config["execution"]["start_tools_early"].get<bool>());
+    ToolTimeouts tool_timeouts(config);
+    // Timing of the current user turn; tool calls add their execution time from the worker threads
+    std::shared_ptr<TurnBreakdown> turn;
+
+    // Shell calls run concurrently; python calls go through one lane per interpreter, so calls to
+    // different sessions only overlap when those sessions run in their own subinterpreters.
+    // Persistent bash sessions get one lane each, since a session runs one command at a time.
+    auto submit_tool_call = [&tool_scheduler, &python_executor, &bash_sessions, &tool_timeouts,
+                             &resource_limits, &output_options, &turn](const ToolCall& call) {
+        std::string lane;
+        std::string tool_name = call.function.contains("name") && call.function["name"].is_string() ?
+                                call.function["name"].get<std::string>() : "";
+        if (tool_name == "python" || (tool_name == "bash" && bash_sessions)) {
+            lane = tool_name;
+            if (tool_name == "bash" || python_executor.sessions_run_in_parallel()) {
+                auto arguments = nlohmann::json::parse(call.function["arguments"].get<std::string>(), nullptr, false);
+                if (arguments.is_object() && arguments.contains("session") && arguments["session"].is_string()) {
+                    lane += ":" + arguments["session"].get<std::string>();
+                }
+            }
+        }
+        BashSessionPool* bash = bash_sessions.get();
+        return tool_scheduler.submit([call, tool_name, &python_executor, bash, &tool_timeouts, &resource_limits,
+                                      &output_options, turn = turn]() {
+            auto started = std::chrono::steady_clock::now();
+            std::string result = run_tool_call(call, python_executor, bash, tool_timeouts, resource_limits, output_options);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+            std::string label = tool_name.empty() ? "unknown" : tool_name;
+            Metrics::instance().record("tool_seconds", MetricUnit::Seconds, seconds, label);
+            if (turn) {
+                turn->add_tool(label, seconds);
+            }
+            return result;
+        }, lane);
+    };
 
     std::cout << "Code Atlas started" << std::endl;
     std::cout << "Running on: " << os_to_string(detect_operating_system()) << std::endl;
     std::cout << "API server: " << (config.contains("api") && config["api"].contains("base_url") ?
-                  config["api"]["base_url"].get<std::string>() : "Not configured") << std::endl;
+                  config["api"]["base_url"].get<std::string>() : "Not configured");
+    if (config.contains("api") && config["api"].contains("unix_socket") && config["api"]["unix_socket"].is_string() &&
+        !config["api"]["unix_socket"].get<std::string>().empty()) {
+        std::cout << " (via unix socket " << config["api"]["unix_socket"].get<std::string>() << ")";
+    }
+    std::cout << std::endl;
 
     // Display supported shells
-    auto supported_shells = get_supported_shells();
     std::cout << "Supported execution environments: ";
-    for (size_t i = 0; i < supported_shells.size(); ++i) {
-        if (i > 0) std::cout << ", ";
-        std::cout << supported_shells[i];
+    bool first_shell = true;
+    for (const auto& capability : CapabilityRegistry::instance().capabilities()) {
+        if (!capability.available) continue;
+        if (!first_shell) std::cout << ", ";
+        std::cout << capability.name;
+        if (!capability.version.empty()) std::cout << " " << capability.version;
+        first_shell = false;
     }
     std::cout << std::endl << std::endl;
 
     // Prepare message history
-    nlohmann::json messages = nlohmann::json::array();
+    ConversationHistory messages(os_prompt_suffix(detect_operating_system()));
     if (config.contains("system") && config["system"].contains("prompt") && !config["system"]["prompt"].get<std::string>().empty()) {
         messages.push_back({
             {"role", "system"},
@@ -59,25 +308,138 @@ void main_loop() {
         });
     }
 
-    // Main loop
-    while (true) {
+    bool log_timings = config.contains("api") && config["api"].contains("log_timings") &&
+                       config["api"]["log_timings"].get<bool>();
+
+    // Record an assistant turn with these tool calls, then wait for each result and record it in call order.
+    // Returns false if interrupted before every result was in.
+    auto record_tool_calls = [&messages, &live_output, &turn](const std::string& content,
+                                                             const std::vector<ToolCall>& calls,
+                                                             std::vector<std::future<std::string>>& results) {
+        nlohmann::json assistant_message = {{"role", "assistant"}, {"content", content}};
+        if (!calls.empty()) {
+            assistant_message["tool_calls"] = nlohmann::json::array();
+            for (const auto& tc : calls) {
+                assistant_message["tool_calls"].push_back(tc);
+            }
+        }
+        messages.push_back(assistant_message);
+
+        for (size_t i = 0; i < calls.size(); ++i) {
+            std::string result;
+            auto wait_started = std::chrono::steady_clock::now();
+            try {
+                TraceSpan span("tool.wait", "tool");
+                if (!wait_for_result(results[i])) {
+                    return false;
+                }
+                result = results[i].get();
+            } catch (const std::exception& e) {
+                nlohmann::json error_json;
+                error_json["status"] = "error";
+                error_json["output"] = "Error: " + std::string(e.what());
+                result = error_json.dump();
+            }
+            turn->add_tool_wait(std::chrono::duration<double>(std::chrono::steady_clock::now() - wait_started).count());
+
+            live_output.flush();
+            display_tool_result(result, i, calls.size());
+
+            messages.push_back({
+                {"role", "tool"},
+                {"tool_call_id", calls[i].id},
+                {"content", result}
+            });
+        }
+        return true;
+    };
+
+    // Main loop; ends on Ctrl+C or Ctrl+D
+    while (!g_interrupted) {
         // Add two newlines for proper spacing and reset color to prevent bleed
         std::cout << std::endl << std::endl << Color::RESET << "> ";
+        // Keep the API connection warm while the user is typing
+        api_client.start_preconnect();
         std::string input;
         std::getline(std::cin, input);
-        if (std::cin.eof()) { // Handle Ctrl+D or end of file
-             signal_handler(0);
+        if (g_interrupted || std::cin.eof()) { // Handle Ctrl+D or end of file
+            break;
         }
 
         if (input.empty()) {
             continue;
         }
+        if (input == "/resources") {
+            // Per-session totals of what the tool calls have used so far
+            std::cout << ResourceLedger::instance().summary();
+            continue;
+        }
+        if (input == "/stats") {
+            // Latency percentiles of requests, tools and turns, plus a breakdown of the last turn
+            std::cout << Metrics::instance().summary();
+            continue;
+        }
 
         messages.push_back({{"role", "user"}, {"content", input}});
+        turn = std::make_shared<TurnBreakdown>();
 
         // Tool call loop
-        while (true) {
-            ApiResponse response = api_client.send_message(messages);
+        while (!g_interrupted) {
+            CompactionReport compaction = context_manager.enforce(messages);
+            if (compaction.tokens_saved() > 0) {
+                std::cout << Color::YELLOW << "\n[Context] Saved " << compaction.tokens_saved() << " tokens ("
+                          << compaction.tokens_before << " -> " << compaction.tokens_after << "): compacted "
+                          << compaction.compacted_outputs << " tool outputs, dropped " << compaction.dropped_messages
+                          << " old messages" << Color::RESET << std::endl;
+            }
+
+            // Tool calls whose arguments complete mid-stream start executing right away, keyed by call id
+            std::map<std::string, std::future<std::string>> early_results;
+            std::vector<ToolCall> early_calls;
+            ToolCallReadyCallback on_tool_call_ready;
+            if (start_tools_early) {
+                on_tool_call_ready = [&](const ToolCall& call) {
+                    early_results.emplace(call.id, submit_tool_call(call));
+                    early_calls.push_back(call);
+                };
+            }
+
+            // Output of calls started mid-stream waits until the reply has finished printing
+            live_output.hold();
+            ApiResponse response = api_client.send_message(messages, on_tool_call_ready);
+            live_output.release();
+            if (g_interrupted) {
+                break;
+            }
+            turn->add_request(api_client.last_request_timings());
+
+            if (log_timings) {
+                const auto& timings = api_client.last_request_timings();
+                std::cout << "\n[Timing] connect " << timings.connect_ms << " ms, tls " << timings.tls_ms
+                          << " ms, ttfb " << timings.ttfb_ms << " ms, ttft " << timings.ttft_ms << " ms, total "
+                          << timings.total_ms << " ms, " << timings.output_tokens << " tokens at "
+                          << timings.tokens_per_second << " tok/s"
+                          << (timings.reused_connection ? " (reused connection)" : "") << std::endl;
+            }
+
+            // Calls started early can't be taken back. If the reply didn't end in tool calls, still record them
+            // and their results, so the model knows they already ran instead of running them again on the next try.
+            if (response.type != ApiResponse::Type::TOOL_CALL && !early_calls.empty()) {
+                live_output.flush();
+                std::cout << Color::YELLOW << "\n[Tool] Recording results of " << early_calls.size()
+                          << " tool call(s) started before the response ended" << Color::RESET << std::endl;
+                std::vector<std::future<std::string>> results;
+                results.reserve(early_calls.size());
+                for (const auto& call : early_calls) {
+                    results.push_back(std::move(early_results[call.id]));
+                }
+                if (!record_tool_calls(response.content, early_calls, results)) {
+                    break;
+                }
+                if (response.type == ApiResponse::Type::MESSAGE) {
+                    break; // The reply text is part of the assistant turn recorded above
+                }
+            }
 
             if (response.type == ApiResponse::Type::API_ERROR) {
                 std::cerr << Color::RED << "\nAPI Error: " << response.error_message << Color::RESET << std::endl;
@@ -90,79 +452,32 @@ void main_loop() {
             }
 
             if (response.type == ApiResponse::Type::TOOL_CALL) {
-                nlohmann::json assistant_message = {{"role", "assistant"}, {"content", response.content}};
-                if (!response.tool_calls.empty()) {
-                    assistant_message["tool_calls"] = nlohmann::json::array();
-                    for(const auto& tc : response.tool_calls){
-                        assistant_message["tool_calls"].push_back(tc);
-                    }
-                }
-                messages.push_back(assistant_message);
-                
+                // Reuse calls already started during the stream; submit the rest now
+                std::vector<std::future<std::string>> pending_results;
+                pending_results.reserve(response.tool_calls.size());
                 for (const auto& tool_call : response.tool_calls) {
-                    std::string result;
-                    std::string tool_name = "unknown";
-                    try {
-                        tool_name = tool_call.function["name"];
-                        auto arguments = nlohmann::json::parse(tool_call.function["arguments"].get<std::string>());
-                        std::string code_to_run = arguments["code"];
-
-                        // The tool call header and code are now streamed by ApiClient.
-                        // We just print the output section header.
-                        std::cout << "\n\n--- Output ---\n" << std::endl;
-
-                        if (tool_name == "python") {
-                            result = python_executor.execute(code_to_run);
-                        } else {
-                            // Check if the requested shell is supported on this OS
-                            auto supported_shells = get_supported_shells();
-                            bool is_supported = std::find(supported_shells.begin(), supported_shells.end(), tool_name) != supported_shells.end();
-
-                            if (is_supported) {
-                                result = execute_shell_code(tool_name, code_to_run);
-                            } else {
-                                nlohmann::json error_json;
-                                error_json["status"] = "error";
-                                error_json["output"] = "Error: Shell '" + tool_name + "' is not supported on " + os_to_string(detect_operating_system());
-                                result = error_json.dump();
-                            }
-                        }
-
-                    } catch (const nlohmann::json::parse_error& e) {
-                        nlohmann::json error_json;
-                        error_json["status"] = "error";
-                        error_json["output"] = "Error: Could not decode arguments: " + tool_call.function["arguments"].get<std::string>() + ". Details: " + e.what();
-                        result = error_json.dump();
-                    } catch (const std::exception& e) {
-                        nlohmann::json error_json;
-                        error_json["status"] = "error";
-                        error_json["output"] = "Error: " + std::string(e.what());
-                        result = error_json.dump();
-                    }
-
-                    try {
-                        nlohmann::json result_json = nlohmann::json::parse(result);
-                        if (result_json.contains("status") && result_json["status"] == "success") {
-                            std::string success_output = result_json["output"];
-                            std::cout << Color::GREEN << format_output_for_display(success_output) << Color::RESET << std::endl;
-                        } else {
-                            std::cout << Color::RED << format_output_for_display(result) << Color::RESET << std::endl;
-                        }
-                    } catch (const nlohmann::json::parse_error& e) {
-                        // If result is not a valid JSON, print as is in red.
-                        std::cout << Color::RED << format_output_for_display(result) << Color::RESET << std::endl;
+                    auto precomputed = response.tool_results.find(tool_call.id);
+                    auto early = early_results.find(tool_call.id);
+                    if (precomputed != response.tool_results.end()) {
+                        // e.g. a python call cut off by the syntax checker
+                        std::promise<std::string> ready;
+                        ready.set_value(precomputed->second);
+                        pending_results.push_back(ready.get_future());
+                    } else if (early != early_results.end()) {
+                        pending_results.push_back(std::move(early->second));
+                        early_results.erase(early);
+                    } else {
+                        pending_results.push_back(submit_tool_call(tool_call));
                     }
-                    std::cout << "\n--------------" << std::endl;
+                }
 
-                    messages.push_back({
-                        {"role", "tool"},
-                        {"tool_call_id", tool_call.id},
-                        {"content", result}
-                    });
+                // Display and record results in the original call order
+                if (!record_tool_calls(response.content, response.tool_calls, pending_results)) {
+                    break;
                 }
                 
                 // Continue tool call loop to get the next assistant message
-                continue; 
+                continue;
 
             } else if (response.type == ApiResponse::Type::MESSAGE) {
                 // Newline is handled by ApiClient prepending one
@@ -170,7 +485,21 @@ void main_loop() {
                 break; // End tool call loop, wait for user input
             }
         }
+        if (!g_interrupted) {
+            turn->finish();
+        }
+        turn.reset();
     }
+
+    // Stop the tool calls still running: their time limits expire now, bash sessions get SIGHUP,
+    // and the destructors below wait for them
+    std::cout << "\n[INFO] Exiting gracefully." << std::endl;
+    Watchdog::instance().expire_all();
+    if (bash_sessions) {
+        bash_sessions->shutdown();
+    }
+    // Keep the last metrics in the exported files even if a second Ctrl+C cuts the wait short
+    metrics_exporter.export_now();
 }
 
 void enable_virtual_terminal_processing() {
@@ -188,13 +517,52 @@ void enable_virtual_terminal_processing() {
 #endif
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    // --trace out.json records a timeline of the session, written when the program exits
+    std::string trace_path;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        std::string value;
+        if (arg == "--trace" && i + 1 < argc) {
+            value = argv[++i];
+        } else if (arg.rfind("--trace=", 0) == 0) {
+            value = arg.substr(8);
+        }
+        if (value.empty()) {
+            std::cerr << "Unknown option: " << arg << "\nUsage: " << argv[0] << " [--trace out.json]" << std::endl;
+            return 1;
+        }
+        // Only one trace file per session
+        if (!trace_path.empty()) {
+            std::cerr << "--trace given more than once\nUsage: " << argv[0] << " [--trace out.json]" << std::endl;
+            return 1;
+        }
+        trace_path = value;
+    }
+    if (!trace_path.empty()) {
+        if (!Trace::start(trace_path)) {
+            std::cerr << "Cannot write trace file: " << trace_path << std::endl;
+            return 1;
+        }
+        Trace::set_thread_name("main");
+        std::atexit([]() { Trace::finish(); });
+    }
+
 #ifdef _WIN32
     SetConsoleOutputCP(CP_UTF8);
     SetConsoleCP(CP_UTF8);
 #endif
     enable_virtual_terminal_processing();
+#ifdef _WIN32
     signal(SIGINT, signal_handler);
+#else
+    // No SA_RESTART: Ctrl+C has to interrupt the read of the prompt line
+    g_main_thread = pthread_self();
+    struct sigaction action {};
+    action.sa_handler = signal_handler;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, nullptr);
+#endif
 
     try {
         main_loop();
@@ -205,13 +573,8 @@ int main() {
         std::cerr << Color::RED << "• Missing dependencies or incompatible versions" << Color::RESET << std::endl;
         std::cerr << Color::RED << "• Insufficient system resources" << Color::RESET << std::endl;
         std::cerr << Color::RED << "• API server configuration issues" << Color::RESET << std::endl;
-        
-        if(g_python_executor) {
-            delete g_python_executor; // Cleanup
-            g_python_executor = nullptr;
-        }
         return 1;
     }
 
-    return 0;
+    return g_interrupted ? SIGINT : 0;
 }